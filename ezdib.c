@@ -59,12 +59,29 @@
 */
 // #define EZD_NO_FILES
 
+/// If you do not have POSIX file descriptors and mmap()
+/**
+	ezd_save_fd() will not work, and ezd_load() will read the whole
+	file instead of mapping it.  This is always defined on Windows.
+*/
+// #define EZD_NO_POSIX
+
 /// If you do not have math.h.  Sorry, you won't get circles
 /**
 	ezd_circle() and ezd_arc() will not work
 */
 // #define EZD_NO_MATH
 
+/// If you do not have pthreads, or want everything on the calling thread
+/**
+	Large operations such as ezd_calc_range() will not be split
+	across threads.  This is always defined on Windows.
+*/
+// #define EZD_NO_THREADS
+
+/// Maximum number of threads used by a single operation
+// #define EZD_MAX_THREADS 4
+
 // Debugging
 #if defined( _DEBUG )
 #	define EZD_DEBUG
@@ -78,6 +95,19 @@
 #	include <stdio.h>
 #endif
 
+// writev(), mmap()
+#if ( defined( _WIN32 ) || defined( EZD_NO_FILES ) ) && !defined( EZD_NO_POSIX )
+#	define EZD_NO_POSIX
+#endif
+#if !defined( EZD_NO_POSIX )
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/uio.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
 // malloc, calloc, free
 #if !defined( EZD_NO_ALLOCATION )
 #	if !defined( EZD_NO_STDLIB )
@@ -107,14 +137,38 @@
 #	include <math.h>
 #endif
 
+// pthread_create(), pthread_join(), pthread_mutex_lock()
+#if defined( _WIN32 ) && !defined( EZD_NO_THREADS )
+#	define EZD_NO_THREADS
+#endif
+#if !defined( EZD_NO_THREADS )
+#	include <pthread.h>
+#endif
+#if !defined( EZD_MAX_THREADS )
+#	define EZD_MAX_THREADS 4
+#endif
+
+/// Minimum number of elements per thread
+#if !defined( EZD_THREAD_MIN_ELEMENTS )
+#	define EZD_THREAD_MIN_ELEMENTS ( 256 * 1024 )
+#endif
+
 // memcpy() and memset() substitutes
 #if defined( EZD_NO_MEMCPY )
 #	define EZD_MEMCPY ezd_memcpy
+#	define EZD_MEMMOVE ezd_memmove
 #	define EZD_MEMSET ezd_memset
 static void ezd_memcpy( char *pDst, const char *pSrc, int sz )
 {	while ( 0 < sz-- )
 		*(char*)pDst++ = *(char*)pSrc++;
 }
+static void ezd_memmove( char *pDst, const char *pSrc, int sz )
+{	if ( pDst <= pSrc )
+		ezd_memcpy( pDst, pSrc, sz );
+	else
+		while ( 0 < sz-- )
+			pDst[ sz ] = pSrc[ sz ];
+}
 static void ezd_memset( char *pDst, int v, int sz )
 {	while ( 0 < sz-- )
 		*(char*)pDst++ = (char)v;
@@ -122,6 +176,7 @@ static void ezd_memset( char *pDst, int v, int sz )
 #else
 #	include <string.h>
 #	define EZD_MEMCPY memcpy
+#	define EZD_MEMMOVE memmove
 #	define EZD_MEMSET memset
 #endif
 
@@ -208,6 +263,9 @@ typedef struct _SBitmapInfoHeader
 
 #	define EZD_FLAG_FREE_BUFFER		0x00010000
 
+// The file mapping is shared with the file, see ezd_create_mapped()
+#	define EZD_FLAG_SHARED_MAP		0x00020000
+
 // Returns non-zero if any color components are greater than the threshold
 #	define EZD_COMPARE_THRESHOLD( c, t ) ( ( c & 0xff ) > t \
 										 || ( ( c >> 8 ) & 0xff ) > t \
@@ -234,6 +292,33 @@ typedef struct _SImageData
 	/// User data passed to set pixel callback function
 	void					*pSetPixelUser;
 
+	/// Pen width set by ezd_set_pen()
+	int						nPenWidth;
+
+	/// Pen join and cap style
+	int						nPenStyle;
+
+	/// Dash pattern, bit zero is the first pixel
+	unsigned int			uDash;
+
+	/// Dash pattern length, zero for solid lines
+	int						nDashLen;
+
+	/// Position in the dash pattern
+	int						nDashPos;
+
+	/// File mapping the image data points into, unmapped on destroy
+	void					*pMap;
+
+	/// Size of the file mapping in bytes
+	unsigned long			nMap;
+
+	/// Number of rectangles in rcDirty
+	int						nDirty;
+
+	/// Areas of the image buffer drawn on since ezd_clear_dirty()
+	SEZDRect				rcDirty[ EZD_MAX_DIRTY ];
+
 	/// User image pointer
 	unsigned char			*pImage;
 
@@ -242,6 +327,9 @@ typedef struct _SImageData
 
 } SImageData;
 
+/// Fails to compile if EZD_HEADER_SIZE can't hold the image header
+typedef char SImageDataSizeCheck[ ( sizeof( SImageData ) <= EZD_HEADER_SIZE ) ? 1 : -1 ];
+
 #if !defined( EZD_STATIC_FONTS )
 
 // This structure contains the memory image
@@ -264,11 +352,99 @@ typedef struct _SFontData
 #	pragma pack( pop )
 #endif
 
+#if !defined( EZD_NO_THREADS )
+
+/// Work item for a worker thread
+typedef struct _SThreadTask
+{
+	/// Task function
+	void					(*pf)( void*, int );
+
+	/// User data passed to pf
+	void					*pUser;
+
+	/// Task index passed to pf
+	int						i;
+
+} SThreadTask;
+
+static void* ezd_thread_proc( void *x_pTask )
+{
+	SThreadTask *t = (SThreadTask*)x_pTask;
+	t->pf( t->pUser, t->i );
+	return 0;
+}
+
+#endif
+
+/// Calls pf( pUser, i ) for each i in [ 0, n ), n must not exceed EZD_MAX_THREADS
+/**
+	Tasks run on worker threads when available, the caller runs
+	task zero and waits for the others to finish.
+*/
+static void ezd_run_tasks( void (*pf)( void*, int ), void *pUser, int n )
+{
+	int i;
+
+#if !defined( EZD_NO_THREADS )
+
+	pthread_t th[ EZD_MAX_THREADS ];
+	int started[ EZD_MAX_THREADS ];
+	SThreadTask task[ EZD_MAX_THREADS ];
+
+	// Start the worker threads, run the task here if that fails
+	for ( i = 1; i < n; i++ )
+	{	task[ i ].pf = pf, task[ i ].pUser = pUser, task[ i ].i = i;
+		started[ i ] = !pthread_create( &th[ i ], 0, ezd_thread_proc, &task[ i ] );
+		if ( !started[ i ] )
+			pf( pUser, i );
+	} // end for
+
+	// Our share
+	if ( 0 < n )
+		pf( pUser, 0 );
+
+	// Wait for the others
+	for ( i = 1; i < n; i++ )
+		if ( started[ i ] )
+			pthread_join( th[ i ], 0 );
+
+#else
+
+	for ( i = 0; i < n; i++ )
+		pf( pUser, i );
+
+#endif
+}
+
+/// Returns the number of tasks to split n elements into
+static int ezd_task_count( long long n )
+{
+#if !defined( EZD_NO_THREADS )
+	long long t = n / EZD_THREAD_MIN_ELEMENTS;
+	return ( 1 > t ) ? 1 : ( EZD_MAX_THREADS < t ) ? EZD_MAX_THREADS : (int)t;
+#else
+	return 1;
+#endif
+}
+
+#if !defined( EZD_NO_POSIX )
+static void ezd_map_headers( SImageData *p );
+#endif
+
 void ezd_destroy( HEZDIMAGE x_hDib )
 {
 #if !defined( EZD_NO_ALLOCATION )
 	if ( x_hDib )
 	{	SImageData *p = (SImageData*)x_hDib;
+#if !defined( EZD_NO_POSIX )
+		// Release the file mapping
+		if ( p->pMap )
+		{	if ( EZD_FLAG_SHARED_MAP & p->uFlags )
+				ezd_map_headers( p );
+			munmap( p->pMap, p->nMap );
+		} // end if
+#endif
 		if ( EZD_FLAG_FREE_BUFFER & p->uFlags )
 			EZD_free( (SImageData*)x_hDib );
 	} // end if
@@ -363,6 +539,69 @@ HEZDIMAGE ezd_create( int x_lWidth, int x_lHeight, int x_lBpp, unsigned int x_uF
 #endif
 }
 
+/// Adds an area to the dirty list, x2 and y2 are exclusive
+static void ezd_mark_dirty( SImageData *p, int x1, int y1, int x2, int y2 )
+{
+	int i, best;
+	long long a, grow;
+	SEZDRect *r = p->rcDirty;
+	int w = EZD_ABS( p->bih.biWidth ), h = EZD_ABS( p->bih.biHeight );
+
+	// Callbacks don't touch the buffer
+	if ( p->pfSetPixel )
+		return;
+
+	if ( 0 > x1 ) x1 = 0;
+	if ( 0 > y1 ) y1 = 0;
+	if ( w < x2 ) x2 = w;
+	if ( h < y2 ) y2 = h;
+	if ( x1 >= x2 || y1 >= y2 )
+		return;
+
+	// Usually already covered while a shape is being drawn
+	for ( i = 0; i < p->nDirty; i++ )
+		if ( r[ i ].x1 <= x1 && r[ i ].y1 <= y1 && x2 <= r[ i ].x2 && y2 <= r[ i ].y2 )
+			return;
+
+	for ( i = 0; i < p->nDirty; )
+	{
+		// Absorb anything this overlaps or touches, then look again
+		if ( x1 <= r[ i ].x2 && r[ i ].x1 <= x2 && y1 <= r[ i ].y2 && r[ i ].y1 <= y2 )
+		{	if ( r[ i ].x1 < x1 ) x1 = r[ i ].x1;
+			if ( r[ i ].y1 < y1 ) y1 = r[ i ].y1;
+			if ( r[ i ].x2 > x2 ) x2 = r[ i ].x2;
+			if ( r[ i ].y2 > y2 ) y2 = r[ i ].y2;
+			r[ i ] = r[ --p->nDirty ];
+			i = 0;
+		} // end if
+
+		else
+			i++;
+
+	} // end for
+
+	// List is full, merge with the rectangle that grows the least
+	if ( EZD_MAX_DIRTY <= p->nDirty )
+	{
+		for ( i = 0, best = 0, grow = -1; i < p->nDirty; i++ )
+		{	a = (long long)( ( r[ i ].x2 > x2 ? r[ i ].x2 : x2 ) - ( r[ i ].x1 < x1 ? r[ i ].x1 : x1 ) )
+				* ( ( r[ i ].y2 > y2 ? r[ i ].y2 : y2 ) - ( r[ i ].y1 < y1 ? r[ i ].y1 : y1 ) )
+				- (long long)( r[ i ].x2 - r[ i ].x1 ) * ( r[ i ].y2 - r[ i ].y1 );
+			if ( 0 > grow || a < grow )
+				grow = a, best = i;
+		} // end for
+
+		ezd_mark_dirty( p, r[ best ].x1 < x1 ? r[ best ].x1 : x1, r[ best ].y1 < y1 ? r[ best ].y1 : y1,
+						   r[ best ].x2 > x2 ? r[ best ].x2 : x2, r[ best ].y2 > y2 ? r[ best ].y2 : y2 );
+		return;
+
+	} // end if
+
+	r[ p->nDirty ].x1 = x1, r[ p->nDirty ].y1 = y1;
+	r[ p->nDirty ].x2 = x2, r[ p->nDirty ].y2 = y2;
+	p->nDirty++;
+}
+
 int ezd_set_image_buffer( HEZDIMAGE x_hDib, void *x_pImg, int x_nImg )
 {
 	SImageData *p = (SImageData*)x_hDib;
@@ -376,6 +615,10 @@ int ezd_set_image_buffer( HEZDIMAGE x_hDib, void *x_pImg, int x_nImg )
 	// Save user image pointer
 	p->pImage = ( !x_pImg && !( EZD_FLAG_USER_IMAGE_BUFFER & p->uFlags ) )
 				? p->pBuffer : x_pImg;
+
+	// Every pixel may have changed
+	ezd_mark_dirty( p, 0, 0, EZD_ABS( p->bih.biWidth ), EZD_ABS( p->bih.biHeight ) );
+
 	return 1;
 }
 
@@ -405,6 +648,53 @@ int ezd_set_palette_color( HEZDIMAGE x_hDib, int x_idx, int x_col )
 	// Set this palette color
 	p->colPalette[ x_idx ] = x_col;
 
+	// Changes how every pixel looks
+	if ( 1 == p->bih.biBitCount )
+		ezd_mark_dirty( p, 0, 0, EZD_ABS( p->bih.biWidth ), EZD_ABS( p->bih.biHeight ) );
+
+	return 1;
+}
+
+int ezd_set_pen( HEZDIMAGE x_hDib, int x_nWidth, int x_nStyle )
+{
+	SImageData *p = (SImageData*)x_hDib;
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || 0 > x_nWidth )
+		return _ERR( 0, "Invalid parameters" );
+
+#if defined( EZD_NO_ALLOCATION )
+	if ( 1 < x_nWidth )
+		return _ERR( 0, "Wide lines require memory allocation" );
+#endif
+
+	p->nPenWidth = x_nWidth;
+	p->nPenStyle = x_nStyle;
+
+	return 1;
+}
+
+int ezd_set_dash( HEZDIMAGE x_hDib, unsigned int x_uPattern, int x_nLen, int x_nPhase )
+{
+	SImageData *p = (SImageData*)x_hDib;
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || 0 > x_nLen || 32 < x_nLen || 0 > x_nPhase )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Drop bits past the pattern length before rotating them in
+	if ( 32 > x_nLen )
+		x_uPattern &= ( 1u << x_nLen ) - 1;
+
+	// Rotate the pattern so every line starts at position zero
+	if ( x_nLen && x_nPhase % x_nLen )
+	{	x_nPhase %= x_nLen;
+		x_uPattern = ( x_uPattern >> x_nPhase ) | ( x_uPattern << ( x_nLen - x_nPhase ) );
+		if ( 32 > x_nLen )
+			x_uPattern &= ( 1u << x_nLen ) - 1;
+	} // end if
+
+	p->uDash = x_uPattern;
+	p->nDashLen = x_nLen;
+	p->nDashPos = 0;
+
 	return 1;
 }
 
@@ -510,1622 +800,7545 @@ void* ezd_get_image_ptr( HEZDIMAGE x_hDib )
 }
 
 
-int ezd_save( HEZDIMAGE x_hDib, const char *x_pFile )
+/// Fills in the file header, returns the palette size or -1 if the image can't be saved
+static int ezd_file_header( SImageData *p, SDIBFileHeader *pDfh )
 {
-#if defined( EZD_NO_FILES )
-	return 0;
-#else
-	FILE *fh;
 	int palette_size = 0;
-	SDIBFileHeader dfh;
-	SImageData *p = (SImageData*)x_hDib;
 
 	// Sanity checks
-	if ( !x_pFile || !*x_pFile || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
-		return _ERR( 0, "Invalid parameters" );
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
+		return _ERR( -1, "Invalid parameters" );
 
 	// Ensure packing is ok
 	if ( sizeof( SDIBFileHeader ) != 14 )
-		return _ERR( 0, "Structure packing for DIB header is incorrect" );
+		return _ERR( -1, "Structure packing for DIB header is incorrect" );
 
 	// Ensure packing is ok
 	if ( sizeof( SBitmapInfoHeader ) != 40 )
-		return _ERR( 0, "Structure packing for BITMAP header is incorrect" );
+		return _ERR( -1, "Structure packing for BITMAP header is incorrect" );
 
 	// Add palettte size
 	if ( 1 == p->bih.biBitCount )
 		palette_size = sizeof( p->colPalette[ 0 ] ) * 2;
 
-	// Attempt to open the output file
-	fh = fopen ( x_pFile, "wb" );
-	if ( !fh )
-		return _ERR( 0, "Failed to open DIB file for writing" );
-
 	// Fill in header info
-	dfh.uMagicNumber = EZD_MAGIC_NUMBER;
-	dfh.uSize = sizeof( SDIBFileHeader ) + p->bih.biSize + p->bih.biSizeImage;
-	dfh.uReserved1 = 0;
-	dfh.uReserved2 = 0;
-	dfh.uOffset = sizeof( SDIBFileHeader ) + p->bih.biSize + palette_size;
+	pDfh->uMagicNumber = EZD_MAGIC_NUMBER;
+	pDfh->uSize = sizeof( SDIBFileHeader ) + p->bih.biSize + palette_size + p->bih.biSizeImage;
+	pDfh->uReserved1 = 0;
+	pDfh->uReserved2 = 0;
+	pDfh->uOffset = sizeof( SDIBFileHeader ) + p->bih.biSize + palette_size;
+
+	return palette_size;
+}
+
+int ezd_save_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser )
+{
+	SDIBFileHeader dfh;
+	SImageData *p = (SImageData*)x_hDib;
+	int palette_size = ezd_file_header( p, &dfh );
+
+	if ( 0 > palette_size || !x_pf )
+		return _ERR( 0, "Invalid parameters" );
 
 	// Write the header
-	if ( sizeof( dfh ) != fwrite( &dfh, 1, sizeof( dfh ), fh ) )
-	{	fclose( fh ); return _ERR( 0, "Error writing DIB header" ); }
+	if ( !x_pf( x_pUser, &dfh, sizeof( dfh ) ) )
+		return _ERR( 0, "Error writing DIB header" );
 
 	// Write the Bitmap header
-	if ( p->bih.biSize != fwrite( &p->bih, 1, p->bih.biSize, fh ) )
-	{	fclose( fh ); return _ERR( 0, "Error writing bitmap header" ); }
+	if ( !x_pf( x_pUser, &p->bih, p->bih.biSize ) )
+		return _ERR( 0, "Error writing bitmap header" );
 
 	// Write the color palette if needed
 	if ( 0 < palette_size )
-		if ( sizeof( p->colPalette ) != fwrite( p->colPalette, 1, palette_size, fh ) )
-		{	fclose( fh ); return _ERR( 0, "Error writing palette" ); }
+		if ( !x_pf( x_pUser, p->colPalette, palette_size ) )
+			return _ERR( 0, "Error writing palette" );
 
 	// Write the Image data
-	if ( p->bih.biSizeImage != fwrite( p->pImage, 1, p->bih.biSizeImage, fh ) )
-	{	fclose( fh ); return _ERR( 0, "Error writing image data" ); }
-
-	// Close the file handle
-	fclose( fh );
+	if ( !x_pf( x_pUser, p->pImage, p->bih.biSizeImage ) )
+		return _ERR( 0, "Error writing image data" );
 
-	return 1;
-#endif
+	return dfh.uSize;
 }
 
-int ezd_fill( HEZDIMAGE x_hDib, int x_col )
+int ezd_save_mem( HEZDIMAGE x_hDib, void *x_pBuf, int x_nBuf )
 {
-	int w, h, sw, pw, x, y;
+	SDIBFileHeader dfh;
 	SImageData *p = (SImageData*)x_hDib;
+	unsigned char *pBuf = (unsigned char*)x_pBuf;
+	int palette_size = ezd_file_header( p, &dfh );
 
-	if ( !p || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
+	if ( 0 > palette_size )
 		return _ERR( 0, "Invalid parameters" );
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	// Just return the size required
+	if ( !pBuf )
+		return dfh.uSize;
 
-	// Check for user callback function
-	if ( p->pfSetPixel )
-	{
-		// Fill each pixel
-		for ( y = 0; y < h; y++ )
-			for( x = 0; x < w; x++ )
-				if ( !p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 ) )
-					return 0;
+	if ( (int)dfh.uSize > x_nBuf )
+		return _ERR( 0, "Buffer is too small" );
 
-		return 1;
+	// Copy the headers, palette and image data
+	EZD_MEMCPY( (char*)pBuf, (const char*)&dfh, sizeof( dfh ) );
+	pBuf += sizeof( dfh );
 
-	} // end if
+	EZD_MEMCPY( (char*)pBuf, (const char*)&p->bih, p->bih.biSize );
+	pBuf += p->bih.biSize;
 
-	// Pixel and scan widths
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	if ( 0 < palette_size )
+		EZD_MEMCPY( (char*)pBuf, (const char*)p->colPalette, palette_size ),
+		pBuf += palette_size;
 
-	// Set the first line
-	switch( p->bih.biBitCount )
-	{
-		case 1 :
-			EZD_MEMSET( p->pImage, EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) ? 0xff : 0, sw );
-			break;
+	EZD_MEMCPY( (char*)pBuf, (const char*)p->pImage, p->bih.biSizeImage );
 
-		case 24 :
-		{
-			// Color values
-			unsigned char r = x_col & 0xff;
-			unsigned char g = ( x_col >> 8 ) & 0xff;
-			unsigned char b = ( x_col >> 16 ) & 0xff;
-			unsigned char *pImg = p->pImage;
+	return dfh.uSize;
+}
 
-			// Set the first line
-			for( x = 0; x < w; x++, pImg += pw )
-				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+#if !defined( EZD_NO_FILES )
 
-		} break;
+/// ezd_save_sink() write function for stdio files
+static int ezd_fwrite( void *pUser, const void *pData, int nData )
+{
+	return nData == (int)fwrite( pData, 1, nData, (FILE*)pUser );
+}
 
-		case 32 :
-		{
-			// Set the first line
-			int *pImg = (int*)p->pImage;
-			for( x = 0; x < w; x++, pImg++ )
-				*pImg = x_col;
+#endif
 
-		} break;
+int ezd_save( HEZDIMAGE x_hDib, const char *x_pFile )
+{
+#if defined( EZD_NO_FILES )
+	return 0;
+#else
+	FILE *fh;
+	int ok;
+	SDIBFileHeader dfh;
 
-		default :
-			return 0;
+	// Sanity checks
+	if ( !x_pFile || !*x_pFile || 0 > ezd_file_header( (SImageData*)x_hDib, &dfh ) )
+		return _ERR( 0, "Invalid parameters" );
 
-	} // end switch
+	// Attempt to open the output file
+	fh = fopen ( x_pFile, "wb" );
+	if ( !fh )
+		return _ERR( 0, "Failed to open DIB file for writing" );
 
-	// Copy remaining lines
-	for( y = 1; y < h; y++ )
-		EZD_MEMCPY( &p->pImage[ y * sw ], p->pImage, sw );
+	// Write the file
+	ok = ezd_save_sink( x_hDib, ezd_fwrite, fh );
 
-	return 1;
+	// Close the file handle
+	if ( fclose( fh ) )
+		return _ERR( 0, "Error closing DIB file" );
+
+	return ok ? 1 : 0;
+#endif
 }
 
-int ezd_set_pixel( HEZDIMAGE x_hDib, int x, int y, int x_col )
+int ezd_save_fd( HEZDIMAGE x_hDib, int x_fd )
 {
-	int w, h, sw, pw;
+#if defined( EZD_NO_POSIX )
+	return 0;
+#else
+	int i = 0, n = 0;
+	struct iovec iov[ 4 ];
+	SDIBFileHeader dfh;
 	SImageData *p = (SImageData*)x_hDib;
+	int palette_size = ezd_file_header( p, &dfh );
 
-	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
+	if ( 0 > palette_size || 0 > x_fd )
 		return _ERR( 0, "Invalid parameters" );
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	// Gather the pieces of the file
+	iov[ n ].iov_base = &dfh, iov[ n++ ].iov_len = sizeof( dfh );
+	iov[ n ].iov_base = &p->bih, iov[ n++ ].iov_len = p->bih.biSize;
+	if ( 0 < palette_size )
+		iov[ n ].iov_base = p->colPalette, iov[ n++ ].iov_len = palette_size;
+	iov[ n ].iov_base = p->pImage, iov[ n++ ].iov_len = p->bih.biSizeImage;
 
-	// Ensure pixel is within the image
-	if ( 0 > x || x >= w || 0 > y || y >= h )
-	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
-		return 0;
-	} // en dif
+	// Pipes and sockets may take less than everything
+	while ( i < n )
+	{
+		ssize_t w = writev( x_fd, &iov[ i ], n - i );
 
-	// Set the specified pixel
-	if ( p->pfSetPixel )
-		return p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 );
+		// Nothing written means no progress will be made
+		if ( 0 >= w )
+		{	if ( 0 > w && EINTR == errno )
+				continue;
+			return _ERR( 0, "Error writing DIB file" );
+		} // end if
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+		// Skip what was written
+		while ( i < n && (size_t)w >= iov[ i ].iov_len )
+			w -= iov[ i++ ].iov_len;
 
-	// Set the first line
-	switch( p->bih.biBitCount )
-	{
-		case 1 :
-			p->pImage[ y * sw + ( x >> 3 ) ] |= 0x80 >> ( x & 7 );
-			break;
+		if ( i < n )
+			iov[ i ].iov_base = (char*)iov[ i ].iov_base + w,
+			iov[ i ].iov_len -= w;
 
-		case 24 :
-		{
-			// Color values
-			unsigned char r = x_col & 0xff;
-			unsigned char g = ( x_col >> 8 ) & 0xff;
-			unsigned char b = ( x_col >> 16 ) & 0xff;
-			unsigned char *pImg = &p->pImage[ y * sw + x * pw ];
+	} // end while
 
-			// Set the pixel color
-			pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+	return 1;
+#endif
+}
 
-		} break;
+#if !defined( EZD_NO_FILES ) && !defined( EZD_NO_ALLOCATION )
 
-		case 32 :
-			*(unsigned int*)&p->pImage[ y * sw + x * pw ] = x_col;
-			break;
+/// State for a background save
+typedef struct _SSaveData
+{
+	/// Encoded file followed by the filename
+	unsigned char			*pBuf;
 
-		default :
-			return 0;
+	/// Size of pBuf
+	int						nBuf;
 
-	} // end switch
+	/// Bytes of file data in pBuf
+	int						nData;
 
-	return 1;
-}
+	/// Filename, points into pBuf
+	const char				*pFile;
 
-int ezd_get_pixel( HEZDIMAGE x_hDib, int x, int y )
-{
-	int w, h, sw, pw;
-	SImageData *p = (SImageData*)x_hDib;
+	/// Non zero if the file was written
+	int						nResult;
 
-	if ( !p || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
-		return _ERR( 0, "Invalid parameters" );
+	/// Non zero once the save has finished
+	int						bDone;
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+#if !defined( EZD_NO_THREADS )
 
-	// Ensure pixel is within the image
-	if ( 0 > x || x >= w || 0 > y || y >= h )
-	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
-		return 0;
-	} // en dif
+	/// Writer thread
+	pthread_t				th;
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	/// Non zero until th is joined
+	int						bThread;
 
-	// Set the first line
-	switch( p->bih.biBitCount )
-	{
-		case 1 :
-			return p->colPalette[ ( p->pImage[ y * sw + ( x >> 3 ) ] & ( 0x80 >> ( x & 7 ) ) ) ? 1 : 0 ];
+	/// Guards bDone and nResult
+	pthread_mutex_t			mtx;
 
-		case 24 :
-		{
-			// Return the color of the specified pixel
-			unsigned char *pImg = &p->pImage[ y * sw + x * pw ];
-			return pImg[ 0 ] | ( pImg[ 1 ] << 8 ) | ( pImg[ 2 ] << 16 );
+#endif
 
-		} break;
+} SSaveData;
 
-		case 32 :
-			return *(unsigned int*)&p->pImage[ y * sw + x * pw ];
+#if !defined( EZD_NO_THREADS )
 
-	} // end switch
+/// Writes the buffered file of a background save
+static void* ezd_save_proc( void *x_pSave )
+{
+	int ok = 0;
+	SSaveData *s = (SSaveData*)x_pSave;
+	FILE *fh = fopen( s->pFile, "wb" );
+
+	if ( !fh )
+		_MSG( "Failed to open DIB file for writing" );
+
+	else
+	{	ok = ( s->nData == (int)fwrite( s->pBuf, 1, s->nData, fh ) );
+		if ( fclose( fh ) )
+			ok = _ERR( 0, "Error closing DIB file" );
+	} // end else
+
+	pthread_mutex_lock( &s->mtx );
+	s->nResult = ok;
+	s->bDone = 1;
+	pthread_mutex_unlock( &s->mtx );
 
 	return 0;
 }
 
-int ezd_line( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
+#endif
+
+#endif
+
+HEZDSAVE ezd_save_async( HEZDIMAGE x_hDib, const char *x_pFile, HEZDSAVE x_hReuse )
 {
-	int w, h, sw, pw, xd, yd, xl, yl, done = 0;
-	SImageData *p = (SImageData*)x_hDib;
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int n, nName;
+	SSaveData *s = (SSaveData*)x_hReuse;
 
-	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
-		return _ERR( 0, "Invalid parameters" );
+	// The buffer can't be reused until its last save is written
+	if ( s )
+		ezd_save_wait( x_hReuse );
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	n = ezd_save_mem( x_hDib, 0, 0 );
+	for ( nName = 0; x_pFile && x_pFile[ nName ]; nName++ )
+		;
 
-	// Determine direction and distance
-	xd = ( x1 < x2 ) ? 1 : -1;
-	yd = ( y1 < y2 ) ? 1 : -1;
-	xl = ( x1 < x2 ) ? ( x2 - x1 ) : ( x1 - x2 );
-	yl = ( y1 < y2 ) ? ( y2 - y1 ) : ( y1 - y2 );
+	if ( !n || !nName )
+	{	if ( s )
+			ezd_save_release( x_hReuse );
+		return _ERR( (HEZDSAVE)0, "Invalid parameters" );
+	} // end if
 
-	// Check for user callback function
-	if ( p->pfSetPixel )
+	if ( !s )
 	{
-		int mx = 0, my = 0;
+		s = (SSaveData*)EZD_calloc( 1, sizeof( SSaveData ) );
+		if ( !s )
+			return 0;
 
-		// Draw the line
-		while ( !done )
-		{
-			if ( x1 == x2 && y1 == y2 )
-				done = 1;
+#if !defined( EZD_NO_THREADS )
+		if ( pthread_mutex_init( &s->mtx, 0 ) )
+		{	EZD_free( s ); return _ERR( (HEZDSAVE)0, "Failed to create mutex" ); }
+#endif
 
-			// Plot pixel
-			if ( 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
-				if ( !p->pfSetPixel( p->pSetPixelUser, x1, y1, x_col, 0 ) )
-					return 0;
+	} // end if
 
-			mx += xl;
-			if ( x1 != x2 && mx > yl )
-				x1 += xd, mx -= yl;
+	s->nResult = 0;
+	s->bDone = 0;
 
-			my += yl;
-			if ( y1 != y2 && my > xl )
-				y1 += yd, my -= xl;
+#if defined( EZD_NO_THREADS )
 
-		} // end while
+	// Nowhere to send it, save it now
+	s->nResult = ezd_save( x_hDib, x_pFile );
+	s->bDone = 1;
 
-		return 1;
+#else
+
+	// Grow the buffer for a larger image
+	if ( s->nBuf < n + nName + 1 )
+	{
+		if ( s->pBuf )
+			EZD_free( s->pBuf );
+
+		s->pBuf = (unsigned char*)EZD_malloc( n + nName + 1 );
+		s->nBuf = s->pBuf ? n + nName + 1 : 0;
+		if ( !s->pBuf )
+		{	ezd_save_release( (HEZDSAVE)s ); return _ERR( (HEZDSAVE)0, "Out of memory" ); }
 
 	} // end if
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	// Snapshot the file, drawing can go on once this is done
+	s->nData = ezd_save_mem( x_hDib, s->pBuf, n );
+	EZD_MEMCPY( (char*)&s->pBuf[ n ], x_pFile, nName + 1 );
+	s->pFile = (const char*)&s->pBuf[ n ];
 
-	// Set the first line
-	switch( p->bih.biBitCount )
-	{
-		case 1 :
-		{
-			int mx = 0, my = 0, c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
-			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	// Write it here if there's no thread
+	s->bThread = !pthread_create( &s->th, 0, ezd_save_proc, s );
+	if ( !s->bThread )
+		ezd_save_proc( s );
 
-			// Draw the line
-			while ( !done )
-			{
-				if ( x1 == x2 && y1 == y2 )
-					done = 1;
+#endif
 
-				// Plot pixel
-				if ( 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
-				{
-					if ( c )
-						p->pImage[ y1 * sw + ( x1 >> 3 ) ] |= xm[ x1 & 7 ];
-					else
-						p->pImage[ y1 * sw + ( x1 >> 3 ) ] &= ~xm[ x1 & 7 ];
+	return (HEZDSAVE)s;
+#endif
+}
 
-				} // end if
+int ezd_save_done( HEZDSAVE x_hSave )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int bDone;
+	SSaveData *s = (SSaveData*)x_hSave;
+	if ( !s )
+		return _ERR( 0, "Invalid parameters" );
 
-				mx += xl;
-				if ( x1 != x2 && mx > yl )
-					x1 += xd, mx -= yl;
+#if !defined( EZD_NO_THREADS )
+	pthread_mutex_lock( &s->mtx );
+	bDone = s->bDone;
+	pthread_mutex_unlock( &s->mtx );
+#else
+	bDone = s->bDone;
+#endif
 
-				my += yl;
-				if ( y1 != y2 && my > xl )
-					y1 += yd, my -= xl;
+	return bDone;
+#endif
+}
 
-			} // end while
+int ezd_save_wait( HEZDSAVE x_hSave )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	SSaveData *s = (SSaveData*)x_hSave;
+	if ( !s )
+		return _ERR( 0, "Invalid parameters" );
 
-		} break;
+#if !defined( EZD_NO_THREADS )
+	if ( s->bThread )
+	{	pthread_join( s->th, 0 );
+		s->bThread = 0;
+	} // end if
+#endif
 
-		case 24 :
-		{
-			// Color values
-			unsigned char r = x_col & 0xff;
-			unsigned char g = ( x_col >> 8 ) & 0xff;
-			unsigned char b = ( x_col >> 16 ) & 0xff;
-			unsigned char *pImg;
-			int mx = 0, my = 0;
+	return s->nResult;
+#endif
+}
 
-			while ( !done )
-			{
-				if ( x1 == x2 && y1 == y2 )
-					done = 1;
+int ezd_save_release( HEZDSAVE x_hSave )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int ok;
+	SSaveData *s = (SSaveData*)x_hSave;
+	if ( !s )
+		return _ERR( 0, "Invalid parameters" );
 
-				// Plot pixel
-				if ( 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
-				{	pImg = &p->pImage[ y1 * sw + x1 * pw ];
-					pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
-				} // end if
+	ok = ezd_save_wait( x_hSave );
 
-				mx += xl;
-				if ( x1 != x2 && mx > yl )
-					x1 += xd, mx -= yl;
+#if !defined( EZD_NO_THREADS )
+	pthread_mutex_destroy( &s->mtx );
+#endif
 
-				my += yl;
-				if ( y1 != y2 && my > xl )
-					y1 += yd, my -= xl;
+	if ( s->pBuf )
+		EZD_free( s->pBuf );
+	EZD_free( s );
 
-			} // end while
+	return ok;
+#endif
+}
 
-		} break;
+int ezd_get_dirty( HEZDIMAGE x_hDib, SEZDRect *x_pRects, int x_nMax )
+{
+	int i;
+	SImageData *p = (SImageData*)x_hDib;
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize )
+		return _ERR( 0, "Invalid parameters" );
 
-		case 32 :
-		{
-			// Color values
-			int mx = 0, my = 0;
+	for ( i = 0; x_pRects && i < x_nMax && i < p->nDirty; i++ )
+		x_pRects[ i ] = p->rcDirty[ i ];
 
-			// Draw the line
-			while ( !done )
-			{
-				if ( x1 == x2 && y1 == y2 )
-					done = 1;
+	return p->nDirty;
+}
 
-				// Plot pixel
-				if ( 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
-					*(unsigned int*)&p->pImage[ y1 * sw + x1 * pw ] = x_col;
+int ezd_clear_dirty( HEZDIMAGE x_hDib )
+{
+	SImageData *p = (SImageData*)x_hDib;
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize )
+		return _ERR( 0, "Invalid parameters" );
 
-				mx += xl;
-				if ( x1 != x2 && mx > yl )
-					x1 += xd, mx -= yl;
+	p->nDirty = 0;
 
-				my += yl;
-				if ( y1 != y2 && my > xl )
-					y1 += yd, my -= xl;
+	return 1;
+}
 
-			} // end while
+#if !defined( EZD_NO_POSIX )
 
-		} break;
+/// Writes n bytes at offset nOff, retrying partial writes
+static int ezd_pwrite( int fd, const void *pData, long n, long nOff )
+{
+	const char *pPos = (const char*)pData;
 
-		default :
+	while ( 0 < n )
+	{
+		ssize_t w = pwrite( fd, pPos, n, nOff );
+
+		// Nothing written means no progress will be made
+		if ( 0 >= w )
+		{	if ( 0 > w && EINTR == errno )
+				continue;
 			return 0;
+		} // end if
 
-	} // end switch
+		pPos += w, nOff += w, n -= w;
 
-	return 1;
-}
+	} // end while
 
-int ezd_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
-{
-	// Draw rectangle
-	return 		ezd_line( x_hDib, x1, y1, x2, y1, x_col )
-		   && 	ezd_line( x_hDib, x2, y1, x2, y2, x_col )
-		   &&	ezd_line( x_hDib, x2, y2, x1, y2, x_col )
-		   &&	ezd_line( x_hDib, x1, y2, x1, y1, x_col );
+	return 1;
 }
 
-#define EZD_PI		( (double)3.141592654 )
-#define EZD_PI2		( EZD_PI * (double)2 )
-#define EZD_PI4		( EZD_PI * (double)4 )
+#endif
 
-int ezd_arc( HEZDIMAGE x_hDib, int x, int y, int x_rad, double x_dStart, double x_dEnd, int x_col )
+int ezd_save_incremental( HEZDIMAGE x_hDib, const char *x_pFile )
 {
-#if defined( EZD_NO_MATH )
+#if defined( EZD_NO_FILES )
 	return 0;
+#elif defined( EZD_NO_POSIX )
+	// No positioned writes, save it all
+	return ezd_save( x_hDib, x_pFile ) && ezd_clear_dirty( x_hDib );
 #else
-	double arc;
-	int i, w, h, sw, pw, px, py;
-	int res = (int)( (double)x_rad * EZD_PI4 ), resdraw;
-	unsigned char *pImg;
+	int fd, i, j, n, sw, ok = 1, y1[ EZD_MAX_DIRTY ], y2[ EZD_MAX_DIRTY ];
+	struct stat st;
+	SDIBFileHeader dfh, fdfh;
+	SBitmapInfoHeader fbih;
 	SImageData *p = (SImageData*)x_hDib;
+	int palette_size = ezd_file_header( p, &dfh );
 
-	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
+	if ( 0 > palette_size || !x_pFile || !*x_pFile )
 		return _ERR( 0, "Invalid parameters" );
 
-	// Dont' draw null arc
-	if ( x_dStart == x_dEnd )
-		return 1;
-
-	// Ensure correct order
-	else if ( x_dStart > x_dEnd )
-	{	double t = x_dStart;
-		x_dStart = x_dEnd;
-		x_dEnd = t;
+	// Only a file laid out exactly like this image can be patched
+	fd = open( x_pFile, O_RDWR );
+	if ( 0 > fd || fstat( fd, &st ) || (long)dfh.uSize != (long)st.st_size
+		 || (ssize_t)sizeof( fdfh ) != pread( fd, &fdfh, sizeof( fdfh ), 0 )
+		 || (ssize_t)sizeof( fbih ) != pread( fd, &fbih, sizeof( fbih ), sizeof( fdfh ) )
+		 || fdfh.uMagicNumber != dfh.uMagicNumber || fdfh.uSize != dfh.uSize || fdfh.uOffset != dfh.uOffset
+		 || fbih.biSize != p->bih.biSize || fbih.biWidth != p->bih.biWidth
+		 || fbih.biHeight != p->bih.biHeight || fbih.biBitCount != p->bih.biBitCount
+		 || fbih.biCompression != p->bih.biCompression || fbih.biSizeImage != p->bih.biSizeImage )
+	{	if ( 0 <= fd )
+			close( fd );
+		return ezd_save( x_hDib, x_pFile ) && ezd_clear_dirty( x_hDib );
 	} // end if
 
-	// Get arc size
-	arc = x_dEnd - x_dStart;
-
-	// How many points to draw
-	resdraw = ( EZD_PI2 <= arc ) ? res : (int)( arc * (double)res / EZD_PI2 );
+	// Row ranges sorted by their first row
+	for ( i = 0; i < p->nDirty; i++ )
+	{	for ( j = i; 0 < j && y1[ j - 1 ] > p->rcDirty[ i ].y1; j-- )
+			y1[ j ] = y1[ j - 1 ], y2[ j ] = y2[ j - 1 ];
+		y1[ j ] = p->rcDirty[ i ].y1, y2[ j ] = p->rcDirty[ i ].y2;
+	} // end for
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	sw = EZD_SCANWIDTH( p->bih.biWidth, p->bih.biBitCount, 4 );
 
-	// Ensure pixel is within the image
-	if ( 0 > x || x >= w || 0 > y || y >= h )
-	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
-		return 0;
-	} // en dif
+	// Palette may have changed
+	if ( 0 < palette_size )
+		ok = ezd_pwrite( fd, p->colPalette, palette_size, dfh.uOffset - palette_size );
 
-	// Check for user callback function
-	if ( p->pfSetPixel )
+	// Overlapping ranges are written once
+	for ( i = 0; ok && i < p->nDirty; i = j )
 	{
-		// Draw the circle
-		for ( i = 0; i < resdraw; i++ )
-		{
-			// Offset for this pixel
-			px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
-			py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+		for ( n = y2[ i ], j = i + 1; j < p->nDirty && y1[ j ] <= n; j++ )
+			if ( y2[ j ] > n )
+				n = y2[ j ];
 
-			// Plot pixel
-			if ( 0 <= px && px < w && 0 <= py && py < h )
-				if ( !p->pfSetPixel( p->pSetPixelUser, px, py, x_col, 0 ) )
-					return 0;
+		ok = ezd_pwrite( fd, &p->pImage[ (long)y1[ i ] * sw ], (long)( n - y1[ i ] ) * sw,
+						 dfh.uOffset + (long)y1[ i ] * sw );
 
-		} // end while
+	} // end for
 
-		return 1;
+	if ( close( fd ) || !ok )
+		return _ERR( 0, "Error writing DIB file" );
 
-	} // end if
+	p->nDirty = 0;
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	return 1;
+#endif
+}
 
-	switch( p->bih.biBitCount )
-	{
-		case 1:
-		{
-			int c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
-			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+/// Creates an image from a DIB file in memory, aliases the pixel data if bAlias is set
+static HEZDIMAGE ezd_load_dib( const unsigned char *pBuf, unsigned long nBuf, int bAlias )
+{
+	int nImageSize;
+	SDIBFileHeader dfh;
+	SBitmapInfoHeader bih;
+	SImageData *p;
 
-			// Draw the circle
-			for ( i = 0; i < resdraw; i++ )
-			{
-				// Offset for this pixel
-				px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
-				py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+	// Ensure packing is ok
+	if ( sizeof( SDIBFileHeader ) != 14 || sizeof( SBitmapInfoHeader ) != 40 )
+		return _ERR( (HEZDIMAGE)0, "Structure packing is incorrect" );
 
-				// Plot pixel
-				if ( 0 <= px && px < w && 0 <= py && py < h )
-				{
-					if ( c )
-						p->pImage[ py * sw + ( px >> 3 ) ] |= xm[ px & 7 ];
-					else
-						p->pImage[ py * sw + ( px >> 3 ) ] &= ~xm[ px & 7 ];
+	if ( !pBuf || sizeof( dfh ) + sizeof( bih ) > nBuf )
+		return _ERR( (HEZDIMAGE)0, "Invalid parameters" );
 
-				} // end if
+	// The buffer may not be aligned
+	EZD_MEMCPY( (char*)&dfh, (const char*)pBuf, sizeof( dfh ) );
+	EZD_MEMCPY( (char*)&bih, (const char*)&pBuf[ sizeof( dfh ) ], sizeof( bih ) );
 
-			} // end while
+	if ( EZD_MAGIC_NUMBER != dfh.uMagicNumber )
+		return _ERR( (HEZDIMAGE)0, "Not a DIB file" );
 
-		} break;
+	// Later header versions start with the same fields
+	if ( sizeof( bih ) > bih.biSize || 1 != bih.biPlanes || bih.biCompression
+		 || 0 >= bih.biWidth || !bih.biHeight )
+		return _ERR( (HEZDIMAGE)0, "Unsupported DIB format" );
 
-		case 24 :
-		{
-			// Color values
-			unsigned char r = x_col & 0xff;
-			unsigned char g = ( x_col >> 8 ) & 0xff;
-			unsigned char b = ( x_col >> 16 ) & 0xff;
-			for ( i = 0; i < resdraw; i++ )
-			{
-				// Offset for this pixel
-				px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
-				py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+	if ( 1 != bih.biBitCount && 24 != bih.biBitCount && 32 != bih.biBitCount )
+		return _ERR( (HEZDIMAGE)0, "Unsupported bits per pixel" );
 
-				// If it falls on the image
-				if ( 0 <= px && px < w && 0 <= py && py < h )
-				{	pImg = &p->pImage[ py * sw + px * pw ];
-					pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
-				} // end if
+	// The image size must fit in an int
+	if ( 0x7fffffff / bih.biBitCount - 32 < bih.biWidth || -0x7fffffff > bih.biHeight
+		 || 0x7fffffff / EZD_SCANWIDTH( bih.biWidth, bih.biBitCount, 4 ) < EZD_ABS( bih.biHeight ) )
+		return _ERR( (HEZDIMAGE)0, "DIB image is too large" );
 
-			} // end for
+	// Ensure the pixel data is all there
+	nImageSize = EZD_IMAGE_SIZE( bih.biWidth, bih.biHeight, bih.biBitCount, 4 );
+	if ( 0 >= nImageSize || dfh.uOffset < sizeof( dfh ) + bih.biSize
+		 || nBuf < dfh.uOffset || nBuf - dfh.uOffset < (unsigned long)nImageSize )
+		return _ERR( (HEZDIMAGE)0, "DIB file is truncated" );
 
-		} break;
+	// 32 bit pixels are accessed as integers
+	if ( bAlias && 32 == bih.biBitCount && ( (unsigned long)&pBuf[ dfh.uOffset ] & 3 ) )
+		bAlias = 0;
 
-		case 32 :
-			for ( i = 0; i < resdraw; i++ )
-			{
-				// Offset for this pixel
-				px = x + (int)( (double)x_rad * sin( (double)i * EZD_PI2 / (double)res ) );
-				py = y + (int)( (double)x_rad * cos( (double)i * EZD_PI2 / (double)res ) );
+	p = (SImageData*)ezd_create( bih.biWidth, bih.biHeight, bih.biBitCount,
+								 bAlias ? EZD_FLAG_USER_IMAGE_BUFFER : 0 );
+	if ( !p )
+		return 0;
 
-				// If it falls on the image
-				if ( 0 <= px && px < w && 0 <= py && py < h )
-					*(unsigned int*)&p->pImage[ py * sw + px * pw ] = x_col;
+	p->bih.biXPelsPerMeter = bih.biXPelsPerMeter;
+	p->bih.biYPelsPerMeter = bih.biYPelsPerMeter;
 
-			} // end for
+	// Read the color palette
+	if ( 1 == bih.biBitCount && sizeof( dfh ) + bih.biSize + sizeof( p->colPalette ) <= dfh.uOffset )
+		EZD_MEMCPY( (char*)p->colPalette, (const char*)&pBuf[ sizeof( dfh ) + bih.biSize ],
+					sizeof( p->colPalette ) );
 
-			break;
+	// Point at or copy the pixels
+	if ( bAlias )
+		p->pImage = (unsigned char*)&pBuf[ dfh.uOffset ];
+	else
+		EZD_MEMCPY( (char*)p->pImage, (const char*)&pBuf[ dfh.uOffset ], nImageSize );
 
-		default :
-			return 0;
+	return (HEZDIMAGE)p;
+}
 
-	} // end switch
+HEZDIMAGE ezd_load_mem( const void *x_pBuf, int x_nBuf, unsigned int x_uFlags )
+{
+	if ( !x_pBuf || 0 >= x_nBuf || ( ~EZD_FLAG_USER_IMAGE_BUFFER & x_uFlags ) )
+		return _ERR( (HEZDIMAGE)0, "Invalid parameters" );
 
-	return 1;
-#endif
+	return ezd_load_dib( (const unsigned char*)x_pBuf, x_nBuf,
+						 ( EZD_FLAG_USER_IMAGE_BUFFER & x_uFlags ) ? 1 : 0 );
 }
 
+#if !defined( EZD_NO_FILES ) && !defined( EZD_NO_ALLOCATION )
 
-int ezd_circle( HEZDIMAGE x_hDib, int x, int y, int x_rad, int x_col )
+/// Reads a whole file into a new buffer, the caller frees it with EZD_free()
+static unsigned char* ezd_read_file( const char *pFile, long *pSize )
 {
-	return ezd_arc( x_hDib, x, y, x_rad, 0, EZD_PI2, x_col );
-}
+	FILE *fh;
+	long nSize;
+	unsigned char *pBuf;
 
-int ezd_fill_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
-{
-	int w, h, x, y, sw, pw, fw, fh;
-	unsigned char *pStart, *pPos;
-	SImageData *p = (SImageData*)x_hDib;
+	if ( !pFile || !*pFile )
+		return _ERR( (unsigned char*)0, "Invalid parameters" );
 
-	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
-		return _ERR( 0, "Invalid parameters" );
+	fh = fopen( pFile, "rb" );
+	if ( !fh )
+		return _ERR( (unsigned char*)0, "Failed to open file for reading" );
+
+	fseek( fh, 0, SEEK_END );
+	nSize = ftell( fh );
+	fseek( fh, 0, SEEK_SET );
+	pBuf = ( 0 < nSize ) ? (unsigned char*)EZD_malloc( nSize ) : 0;
+	if ( pBuf && nSize != (long)fread( pBuf, 1, nSize, fh ) )
+		EZD_free( pBuf ), pBuf = 0;
+	fclose( fh );
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	if ( !pBuf )
+		return _ERR( (unsigned char*)0, "Failed to read file" );
 
-	// Swap coords if needed
-	if ( x1 > x2 ) { int t = x1; x1 = x2; x2 = t; }
-	if ( y1 > y2 ) { int t = y1; y1 = y2; y2 = t; }
+	*pSize = nSize;
+	return pBuf;
+}
 
-	// Clip
-	if ( 0 > x1 ) x1 = 0; else if ( x1 >= w ) x1 = w - 1;
-	if ( 0 > y1 ) y1 = 0; else if ( y1 >= h ) y1 = h - 1;
-	if ( 0 > x2 ) x2 = 0; else if ( x2 >= w ) x2 = w - 1;
-	if ( 0 > y2 ) y2 = 0; else if ( y2 >= h ) y2 = h - 1;
+#endif
 
-	// Fill width and height
-	fw = x2 - x1;
-	fh = y2 - y1;
+HEZDIMAGE ezd_load( const char *x_pFile )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#elif !defined( EZD_NO_POSIX )
+	int fd;
+	void *pMap;
+	struct stat st;
+	SImageData *p;
 
-	// Are we left with a valid region
-	if ( 0 > fw || 0 > fh )
-	{	_SHOW( "Invalid fill rect : %d,%d -> %d,%d : %dx%d ",
-			   x1, y1, x2, y2, w, h );
-		return 0;
-	} // en dif
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( (HEZDIMAGE)0, "Invalid parameters" );
 
-	// Check for user callback function
-	if ( p->pfSetPixel )
-	{
-		// Fill each pixel
-		for ( y = y1; y < y2; y++ )
-			for( x = x1; x < x2; x++ )
-				if ( 0 <= x && x < w && 0 <= y && y < h )
-					if ( !p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 ) )
-						return 0;
+	fd = open( x_pFile, O_RDONLY );
+	if ( 0 > fd )
+		return _ERR( (HEZDIMAGE)0, "Failed to open DIB file for reading" );
 
-		return 1;
+	if ( fstat( fd, &st ) || 0 >= st.st_size )
+	{	close( fd ); return _ERR( (HEZDIMAGE)0, "Invalid DIB file" ); }
 
-	} // end if
+	// Private mapping, drawing on the image never touches the file
+	pMap = mmap( 0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( MAP_FAILED == pMap )
+		return _ERR( (HEZDIMAGE)0, "Failed to map DIB file" );
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 1 );
+	p = (SImageData*)ezd_load_dib( (const unsigned char*)pMap, st.st_size, 1 );
 
-	// Set the first line
-	switch( p->bih.biBitCount )
-	{
-		case 1 :
-		{
-			int c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
-			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	// Keep the mapping if the pixels point into it
+	if ( p && p->pImage != p->pBuffer )
+		p->pMap = pMap, p->nMap = st.st_size;
+	else
+		munmap( pMap, st.st_size );
 
-			// Just fill it in pixel by pixel for 1 bit images
-			for ( y = y1; y < y2; y++ )
-				for( x = x1; x < x2; x++ )
-					if ( 0 <= x && x < w && 0 <= y && y < h )
-					{
-						if ( c )
-							p->pImage[ y * sw + ( x >> 3 ) ] |= xm[ x & 7 ];
-						else
-							p->pImage[ y * sw + ( x >> 3 ) ] &= ~xm[ x & 7 ];
+	return (HEZDIMAGE)p;
+#else
+	long nSize;
+	unsigned char *pBuf;
+	HEZDIMAGE hDib = 0;
 
-					} // end if
+	pBuf = ezd_read_file( x_pFile, &nSize );
+	if ( !pBuf )
+		return 0;
 
-			return 1;
+	hDib = ezd_load_dib( pBuf, nSize, 0 );
 
-		} break;
+	EZD_free( pBuf );
 
-		case 24 :
-		{
-			// Color values
-			unsigned char r = x_col & 0xff;
-			unsigned char g = ( x_col >> 8 ) & 0xff;
-			unsigned char b = ( x_col >> 16 ) & 0xff;
-			pStart = pPos = &p->pImage[ y1 * sw + x1 * pw ];
+	return hDib;
+#endif
+}
 
-			// Set the first line
-			for( x = 0; x < fw; x++, pPos += pw )
-				pPos[ 0 ] = r, pPos[ 1 ] = g, pPos[ 2 ] = b;
+#if !defined( EZD_NO_POSIX )
 
-		} break;
+/// Writes the headers and palette into the start of a shared file mapping
+static void ezd_map_headers( SImageData *p )
+{
+	SDIBFileHeader dfh;
+	unsigned char *pMap = (unsigned char*)p->pMap;
+	int palette_size = ezd_file_header( p, &dfh );
 
-		case 32 :
-		{
-			// Set the first line
-			pStart = pPos = &p->pImage[ y1 * sw + x1 * pw ];
-			for( x = 0; x < fw; x++, pPos += pw )
-				*(unsigned int*)pPos = x_col;
+	// Skip if the image no longer points into the file
+	if ( 0 > palette_size || p->pImage < pMap || p->pImage >= pMap + p->nMap )
+		return;
 
-		} break;
+	dfh.uSize = p->nMap;
+	dfh.uOffset = p->pImage - pMap;
 
-		default :
-			return 0;
+	EZD_MEMCPY( (char*)pMap, (const char*)&dfh, sizeof( dfh ) );
+	EZD_MEMCPY( (char*)&pMap[ sizeof( dfh ) ], (const char*)&p->bih, p->bih.biSize );
+	if ( 0 < palette_size )
+		EZD_MEMCPY( (char*)&pMap[ sizeof( dfh ) + p->bih.biSize ], (const char*)p->colPalette, palette_size );
+}
 
-	} // end switch
+#endif
 
-	// Copy remaining lines
-	pPos = pStart;
-	for( y = 1; y < fh; y++ )
-	{
-		// Skip to next line
-		pPos += sw;
-		EZD_MEMCPY( pPos, pStart, fw * pw );
+HEZDIMAGE ezd_create_mapped( const char *x_pFile, int x_lWidth, int x_lHeight, int x_lBpp )
+{
+#if defined( EZD_NO_POSIX ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int fd, nOffset, bKeep;
+	unsigned long nMap;
+	void *pMap;
+	struct stat st;
+	SDIBFileHeader fdfh;
+	SBitmapInfoHeader fbih;
+	SImageData *p;
 
-	} // end for
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( (HEZDIMAGE)0, "Invalid parameters" );
 
-	return 1;
+	p = (SImageData*)ezd_create( x_lWidth, x_lHeight, x_lBpp, EZD_FLAG_USER_IMAGE_BUFFER );
+	if ( !p )
+		return 0;
+
+	// Align the pixel data so 32 bit pixels can be accessed as integers
+	nOffset = EZD_ALIGN( sizeof( SDIBFileHeader ) + p->bih.biSize
+						 + ( ( 1 == x_lBpp ) ? sizeof( p->colPalette ) : 0 ), 4 );
+	nMap = nOffset + (unsigned long)p->bih.biSizeImage;
+
+	fd = open( x_pFile, O_RDWR | O_CREAT, 0666 );
+	if ( 0 > fd )
+	{	ezd_destroy( (HEZDIMAGE)p ); return _ERR( (HEZDIMAGE)0, "Failed to open DIB file for writing" ); }
+
+	// Keep the pixels only if the file already holds an image with this layout
+	bKeep = !fstat( fd, &st ) && (unsigned long)st.st_size == nMap
+			&& (ssize_t)sizeof( fdfh ) == pread( fd, &fdfh, sizeof( fdfh ), 0 )
+			&& (ssize_t)sizeof( fbih ) == pread( fd, &fbih, sizeof( fbih ), sizeof( fdfh ) )
+			&& EZD_MAGIC_NUMBER == fdfh.uMagicNumber && (unsigned long)fdfh.uSize == nMap
+			&& (int)fdfh.uOffset == nOffset && fbih.biSize == p->bih.biSize
+			&& fbih.biWidth == p->bih.biWidth && fbih.biHeight == p->bih.biHeight
+			&& fbih.biBitCount == p->bih.biBitCount && !fbih.biCompression;
+
+	// Size the file, clearing anything else, and map it
+	pMap = MAP_FAILED;
+	if ( ( bKeep || !ftruncate( fd, 0 ) ) && !ftruncate( fd, nMap ) )
+		pMap = mmap( 0, nMap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( MAP_FAILED == pMap )
+	{	ezd_destroy( (HEZDIMAGE)p ); return _ERR( (HEZDIMAGE)0, "Failed to map DIB file" ); }
+
+	p->pMap = pMap;
+	p->nMap = nMap;
+	p->pImage = (unsigned char*)pMap + nOffset;
+	p->uFlags |= EZD_FLAG_SHARED_MAP;
+
+	ezd_map_headers( p );
+
+	return (HEZDIMAGE)p;
+#endif
 }
 
-int ezd_flood_fill( HEZDIMAGE x_hDib, int x, int y, int x_bcol, int x_col )
+int ezd_sync( HEZDIMAGE x_hDib, int x_bWait )
 {
-#if defined( EZD_NO_ALLOCATION )
+#if defined( EZD_NO_POSIX )
 	return 0;
 #else
-	int ok, n, i, ii, w, h, sw, pw, bc;
-	unsigned char r, g, b, br, bg, bb;
-	unsigned char *pImg, *map;
 	SImageData *p = (SImageData*)x_hDib;
-
-	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize )
 		return _ERR( 0, "Invalid parameters" );
 
-	// +++ Fix ezd_flood_fill() for 1 bpp
-	if ( 1 == p->bih.biBitCount )
-		return 0; // _ERR( 0, "Invalid pixel depth" );
+	if ( !p->pMap || !( EZD_FLAG_SHARED_MAP & p->uFlags ) )
+		return _ERR( 0, "Image is not mapped to a file" );
 
-	// Calculate image metrics
-	w = EZD_ABS( p->bih.biWidth );
-	h = EZD_ABS( p->bih.biHeight );
+	// Palette may have changed
+	ezd_map_headers( p );
 
-	// Ensure pixel is within the image
-	if ( 0 > x || x >= w || 0 > y || y >= h )
-	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
-		return 0;
-	} // en dif
+	if ( msync( p->pMap, p->nMap, x_bWait ? MS_SYNC : MS_ASYNC ) )
+		return _ERR( 0, "Error writing DIB file" );
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	return 1;
+#endif
+}
 
-	// Set the image pointer
-	pImg = p->pImage;
+/// State for a streaming DIB writer
+typedef struct _SStreamData
+{
+	/// Image metrics for the whole file
+	SBitmapInfoHeader		bih;
 
-	// Allocate space for fill map
-	map = (unsigned char*)EZD_calloc( w * h, 1 );
-	if ( !map )
-		return 0;
+	/// Sink for sequential streams
+	t_ezd_write				pf;
 
-	// Prepare 24 bit color components
-	r = x_col & 0xff; g = ( x_col >> 8 ) & 0xff; b = ( x_col >> 16 ) & 0xff;
-	br = x_bcol & 0xff; bg = ( x_bcol >> 8 ) & 0xff; bb = ( x_bcol >> 16 ) & 0xff;
+	/// User data passed to pf
+	void					*pUser;
 
-	// Initialize indexes
-	i = y * w + x;
-	ii = y * sw + x * pw;
+#if !defined( EZD_NO_FILES )
+	/// Output file for seekable streams
+	FILE					*fh;
+#endif
 
-	// Save away bit count
-	bc = p->bih.biBitCount;
+	/// Offset to the pixel data in the file
+	long					nOffset;
 
-	// Crawl the map
-	while ( ( map[ i ] & 0x0f ) <= 3 )
-	{
+	/// Next row expected by a sequential stream, in file order
+	int						nNext;
 
-		if ( ( map[ i ] & 0x0f ) == 0 )
-		{
-			// In the name of simplicity
-			switch( bc )
-			{
-				case 24 :
-					pImg[ ii ] = r;
-					pImg[ ii + 1 ] = g;
-					pImg[ ii + 2 ] = b;
-					break;
+	/// Non zero if a write has failed
+	int						nError;
 
-				case 32 :
-					*(unsigned int*)&p->pImage[ ii ] = x_col;
-					break;
+} SStreamData;
 
-			} // end switch
+#if !defined( EZD_NO_ALLOCATION )
 
-			// Point to next direction
-			map[ i ] &= 0xf0, map[ i ] |= 1;
+/// Opens a stream for images shaped like hBand, writes the headers
+static SStreamData* ezd_stream_init( SStreamData *s, HEZDIMAGE hBand, int lHeight )
+{
+	SDIBFileHeader dfh;
+	SImageData *p = (SImageData*)hBand;
+	int nImageSize, palette_size = ezd_file_header( p, &dfh );
 
-			// Can we go up?
-			if ( y < ( h - 1 ) )
-			{
-				n = ( y + 1 ) * sw + x * pw;
-				switch( bc )
-				{	case 24 :
-						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
-						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
-						break;
-					case 32 :
-						ok = *(unsigned int*)&pImg[ n ] != x_col;
-						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
-						break;
-				} // end switch
+	if ( 0 > palette_size || !lHeight )
+		return _ERR( (SStreamData*)0, "Invalid parameters" );
 
-				if ( ok )
-				{	y++;
-					i = y * w + x;
-					map[ i ] = 0x10;
-					ii = n;
-				} // end if
+	nImageSize = EZD_IMAGE_SIZE( p->bih.biWidth, lHeight, p->bih.biBitCount, 4 );
+	if ( 0 >= nImageSize )
+		return _ERR( (SStreamData*)0, "Invalid image size" );
 
-			} // end if
+	// Same format as the band, only taller
+	s->bih = p->bih;
+	s->bih.biHeight = lHeight;
+	s->bih.biSizeImage = nImageSize;
+	s->nOffset = dfh.uOffset;
+	dfh.uSize = dfh.uOffset + nImageSize;
 
-		} // end if
+	if ( !s->pf( s->pUser, &dfh, sizeof( dfh ) )
+		 || !s->pf( s->pUser, &s->bih, s->bih.biSize )
+		 || ( 0 < palette_size && !s->pf( s->pUser, p->colPalette, palette_size ) ) )
+		return _ERR( (SStreamData*)0, "Error writing DIB header" );
 
-		if ( ( map[ i ] & 0x0f ) == 1 )
-		{
-			// Point to next direction
-			map[ i ] &= 0xf0, map[ i ] |= 2;
+	return s;
+}
 
-			// Can we go right?
-			if ( x < ( w - 1 ) )
-			{
-				n = y * sw + ( x + 1 ) * pw;
-				switch( bc )
-				{	case 24 :
-						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
-						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
-						break;
-					case 32 :
-						ok = *(unsigned int*)&pImg[ n ] != x_col;
-						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
-						break;
-				} // end switch
+#endif
 
-				if ( ok )
-				{	x++;
-					i = y * w + x;
-					map[ i ] = 0x20;
-					ii = n;
-				} // end if
+HEZDSTREAM ezd_stream_open( const char *x_pFile, HEZDIMAGE x_hBand, int x_lHeight )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	SStreamData *s;
 
-			} // end if
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( (HEZDSTREAM)0, "Invalid parameters" );
 
-		} // end if
+	s = (SStreamData*)EZD_calloc( 1, sizeof( SStreamData ) );
+	if ( !s )
+		return 0;
 
-		if ( ( map[ i ] & 0x0f ) == 2 )
-		{
-			// Point to next direction
-			map[ i ] &= 0xf0, map[ i ] |= 3;
+	s->fh = fopen( x_pFile, "wb" );
+	if ( !s->fh )
+	{	EZD_free( s ); return _ERR( (HEZDSTREAM)0, "Failed to open DIB file for writing" ); }
 
-			// Can we go down?
-			if ( y > 0 )
-			{
-				n = ( y - 1 ) * sw + x * pw;
-				switch( bc )
-				{	case 24 :
-						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
-						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
-						break;
-					case 32 :
-						ok = *(unsigned int*)&pImg[ n ] != x_col;
-						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
-						break;
-				} // end switch
+	s->pf = ezd_fwrite;
+	s->pUser = s->fh;
 
-				if ( ok )
-				{	y--;
-					i = y * w + x;
-					map[ i ] = 0x30;
-					ii = n;
-				} // end if
+	// Write the header and size the file, rows are written in place
+	if ( !ezd_stream_init( s, x_hBand, x_lHeight )
+		 || fseek( s->fh, s->nOffset + s->bih.biSizeImage - 1, SEEK_SET )
+		 || 1 != fwrite( "", 1, 1, s->fh ) )
+	{	fclose( s->fh ); EZD_free( s ); return _ERR( (HEZDSTREAM)0, "Error writing DIB file" ); }
 
-			} // end if
+	return (HEZDSTREAM)s;
+#endif
+}
 
-		} // end if
+HEZDSTREAM ezd_stream_open_sink( t_ezd_write x_pf, void *x_pUser, HEZDIMAGE x_hBand, int x_lHeight )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	SStreamData *s;
 
-		if ( ( map[ i ] & 0x0f ) == 3 )
-		{
-			// Point to next
-			map[ i ] &= 0xf0, map[ i ] |= 4;
+	if ( !x_pf )
+		return _ERR( (HEZDSTREAM)0, "Invalid parameters" );
 
-			// Can we go left
-			if ( x > 0 )
-			{
-				n = y * sw + ( x - 1 ) * pw;
-				switch( bc )
-				{	case 24 :
-						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
-						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
-						break;
-					case 32 :
-						ok = *(unsigned int*)&pImg[ n ] != x_col;
-						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
-						break;
-				} // end switch
+	s = (SStreamData*)EZD_calloc( 1, sizeof( SStreamData ) );
+	if ( !s )
+		return 0;
 
-				if ( ok )
-				{	x--;
-					i = y * w + x;
-					map[ i ] = 0x40;
-					ii = n;
-				} // end if
+	s->pf = x_pf;
+	s->pUser = x_pUser;
 
-			} // end if
+	if ( !ezd_stream_init( s, x_hBand, x_lHeight ) )
+	{	EZD_free( s ); return 0; }
 
-		} // end if
+	return (HEZDSTREAM)s;
+#endif
+}
 
-		// Time to backup?
-		while ( ( map[ i ] & 0xf0 ) > 0 && ( map[ i ] & 0x0f ) > 3 )
-		{
-			// Go back
-			if ( ( map[ i ] & 0xf0 ) == 0x10 ) y--;
-			else if ( ( map[ i ] & 0xf0 ) == 0x20 ) x--;
-			else if ( ( map[ i ] & 0xf0 ) == 0x30 ) y++;
-			else if ( ( map[ i ] & 0xf0 ) == 0x40 ) x++;
+int ezd_stream_write( HEZDSTREAM x_hStream, HEZDIMAGE x_hBand, int x_y )
+{
+	int n, h, bh, sw, fy, by, r0, r1, step;
+	SStreamData *s = (SStreamData*)x_hStream;
+	SImageData *p = (SImageData*)x_hBand;
 
-			// Set indexes
-			i = y * w + x;
-			ii = y * sw + x * pw;
+	if ( !s || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage
+		 || p->bih.biWidth != s->bih.biWidth || p->bih.biBitCount != s->bih.biBitCount )
+		return _ERR( 0, "Invalid parameters" );
 
-		} // end while
+	if ( s->nError )
+		return _ERR( 0, "A previous write failed" );
+
+	h = EZD_ABS( s->bih.biHeight );
+	bh = EZD_ABS( p->bih.biHeight );
+	sw = EZD_SCANWIDTH( s->bih.biWidth, s->bih.biBitCount, 4 );
+
+	// Clip the band to the image
+	r0 = ( 0 > x_y ) ? 0 : x_y;
+	r1 = ( x_y + bh > h ) ? h : x_y + bh;
+	n = r1 - r0;
+	if ( 0 >= n )
+		return 1;
+
+	// First row in file order, and where it is in the band
+	fy = ( 0 > s->bih.biHeight ) ? r0 : h - r1;
+	by = ( 0 > s->bih.biHeight ) ? r0 - x_y : r1 - 1 - x_y;
+	if ( 0 < p->bih.biHeight )
+		by = bh - 1 - by;
+
+	// Band rows run the same way as the file if the orientation matches
+	step = ( ( 0 > p->bih.biHeight ) == ( 0 > s->bih.biHeight ) ) ? 1 : -1;
+
+#if !defined( EZD_NO_FILES )
+	if ( s->fh )
+	{	if ( fseek( s->fh, s->nOffset + (long)fy * sw, SEEK_SET ) )
+		{	s->nError = 1; return _ERR( 0, "Error seeking in DIB file" ); }
+	} else
+#endif
+	if ( fy != s->nNext )
+		return _ERR( 0, "Rows must be written in file order" );
 
+	// Contiguous rows go out in one write
+	if ( 0 < step )
+	{	if ( !s->pf( s->pUser, &p->pImage[ by * sw ], n * sw ) )
+		{	s->nError = 1; return _ERR( 0, "Error writing image data" ); }
 	} // end if
 
-	EZD_free( map );
+	else
+		for ( r0 = 0; r0 < n; r0++, by-- )
+			if ( !s->pf( s->pUser, &p->pImage[ by * sw ], sw ) )
+			{	s->nError = 1; return _ERR( 0, "Error writing image data" ); }
+
+	s->nNext = fy + n;
 
 	return 1;
-#endif
 }
 
-// A small font map
-static const char font_map_small [] =
+int ezd_stream_close( HEZDSTREAM x_hStream )
 {
-	// Default glyph
-	'.', 1, 6,	0x08,
-
-	// Tab width
-	'\t', 8, 0,
+	int ok;
+	SStreamData *s = (SStreamData*)x_hStream;
+	if ( !s )
+		return _ERR( 0, "Invalid parameters" );
 
-	// Space
-	' ', 3, 0,
+	ok = !s->nError;
 
-	'!', 1, 6,	0xea,
-	'+', 3, 6,	0x0b, 0xa0, 0x00,
-	'-', 3, 6,	0x03, 0x80, 0x00,
-	'/', 3, 6,	0x25, 0x48, 0x00,
-	'*', 3, 6,	0xab, 0xaa, 0x00,
-	'@', 4, 6,	0x69, 0xbb, 0x87,
-	':', 1, 6,	0x52,
-	'=', 3, 6,	0x1c, 0x70, 0x00,
-	'?', 4, 6,	0x69, 0x24, 0x04,
-	'%', 3, 6,	0x85, 0x28, 0x40,
-	'^', 3, 6,	0x54, 0x00, 0x00,
-	'#', 5, 6,	0x57, 0xd5, 0xf5, 0x00,
-	'$', 5, 6,	0x23, 0xe8, 0xe2, 0xf8,
-	'~', 4, 6,	0x05, 0xa0, 0x00,
+#if !defined( EZD_NO_FILES )
+	if ( s->fh )
+	{	if ( fclose( s->fh ) )
+			ok = _ERR( 0, "Error closing DIB file" );
+	} else
+#endif
+	if ( s->nNext != EZD_ABS( s->bih.biHeight ) )
+		ok = _ERR( 0, "Not all rows were written" );
 
-	'0', 3, 6,	0x56, 0xd4, 0x31,
-	'1', 2, 6,	0xd5, 0x42,
-	'2', 4, 6,	0xe1, 0x68, 0xf0,
-	'3', 4, 6,	0xe1, 0x61, 0xe0,
-	'4', 4, 6,	0x89, 0xf1, 0x10,
-	'5', 4, 6,	0xf8, 0xe1, 0xe0,
-	'6', 4, 6,	0x78, 0xe9, 0x60,
-	'7', 4, 6,	0xf1, 0x24, 0x40,
-	'8', 4, 6,	0x69, 0x69, 0x60,
-	'9', 4, 6,	0x69, 0x71, 0x60,
+#if !defined( EZD_NO_ALLOCATION )
+	EZD_free( s );
+#endif
 
-	'A', 4, 6,	0x69, 0xf9, 0x90,
-	'B', 4, 6,	0xe9, 0xe9, 0xe0,
-	'C', 4, 6,	0x78, 0x88, 0x70,
-	'D', 4, 6,	0xe9, 0x99, 0xe0,
-	'E', 4, 6,	0xf8, 0xe8, 0xf0,
-	'F', 4, 6,	0xf8, 0xe8, 0x80,
-	'G', 4, 6,	0x78, 0xb9, 0x70,
-	'H', 4, 6,	0x99, 0xf9, 0x90,
-	'I', 3, 6,	0xe9, 0x2e, 0x00,
-	'J', 4, 6,	0xf2, 0x2a, 0x40,
-	'K', 4, 6,	0x9a, 0xca, 0x90,
-	'L', 3, 6,	0x92, 0x4e, 0x00,
-	'M', 5, 6,	0x8e, 0xeb, 0x18, 0x80,
-	'N', 4, 6,	0x9d, 0xb9, 0x90,
-	'O', 4, 6,	0x69, 0x99, 0x60,
-	'P', 4, 6,	0xe9, 0xe8, 0x80,
-	'Q', 4, 6,	0x69, 0x9b, 0x70,
-	'R', 4, 6,	0xe9, 0xea, 0x90,
-	'S', 4, 6,	0x78, 0x61, 0xe0,
-	'T', 3, 6,	0xe9, 0x24, 0x00,
-	'U', 4, 6,	0x99, 0x99, 0x60,
-	'V', 4, 6,	0x99, 0x96, 0x60,
-	'W', 5, 6,	0x8c, 0x6b, 0x55, 0x00,
-	'X', 4, 6,	0x99, 0x69, 0x90,
-	'Y', 3, 6,	0xb5, 0x24, 0x00,
-	'Z', 4, 6,	0xf2, 0x48, 0xf0,
+	return ok;
+}
 
-	'a', 4, 6,	0x69, 0xf9, 0x90,
-	'b', 4, 6,	0xe9, 0xe9, 0xe0,
-	'c', 4, 6,	0x78, 0x88, 0x70,
-	'd', 4, 6,	0xe9, 0x99, 0xe0,
-	'e', 4, 6,	0xf8, 0xe8, 0xf0,
-	'f', 4, 6,	0xf8, 0xe8, 0x80,
-	'g', 4, 6,	0x78, 0xb9, 0x70,
-	'h', 4, 6,	0x99, 0xf9, 0x90,
-	'i', 3, 6,	0xe9, 0x2e, 0x00,
-	'j', 4, 6,	0xf2, 0x2a, 0x40,
-	'k', 4, 6,	0x9a, 0xca, 0x90,
-	'l', 3, 6,	0x92, 0x4e, 0x00,
-	'm', 5, 6,	0x8e, 0xeb, 0x18, 0x80,
-	'n', 4, 6,	0x9d, 0xb9, 0x90,
-	'o', 4, 6,	0x69, 0x99, 0x60,
-	'p', 4, 6,	0xe9, 0xe8, 0x80,
-	'q', 4, 6,	0x69, 0x9b, 0x70,
-	'r', 4, 6,	0xe9, 0xea, 0x90,
-	's', 4, 6,	0x78, 0x61, 0xe0,
-	't', 3, 6,	0xe9, 0x24, 0x00,
-	'u', 4, 6,	0x99, 0x99, 0x60,
-	'v', 4, 6,	0x99, 0x96, 0x60,
-	'w', 5, 6,	0x8c, 0x6b, 0x55, 0x00,
-	'x', 4, 6,	0x99, 0x69, 0x90,
-	'y', 3, 6,	0xb5, 0x24, 0x00,
-	'z', 4, 6,	0xf2, 0x48, 0xf0,
+#if !defined( EZD_NO_ALLOCATION )
 
-	0,
-};
+/// Palette lookup table size, must be a power of two
+#define EZD_PALETTE_HASH	1024
 
-// A medium font map
-static const char font_map_medium [] =
+/// Exact color to palette index lookup for palettized output
+typedef struct _SPaletteMap
 {
-	// Default glyph
-	'.', 2, 10,	0x00, 0x3c, 0x00,
+	/// Color plus one for each slot, zero if empty
+	unsigned int			uKey[ EZD_PALETTE_HASH ];
 
-	// Tab width
+	/// Palette index for each slot
+	unsigned char			uIdx[ EZD_PALETTE_HASH ];
+
+	/// Palette colors
+	int						pal[ 256 ];
+
+	/// Number of palette colors
+	int						nCols;
+
+} SPaletteMap;
+
+/// Returns the palette index for a color, adding it if needed, -1 if the palette is full
+static int ezd_palette_index( SPaletteMap *m, int col )
+{
+	unsigned int k = ( (unsigned int)col & 0xffffff ) + 1;
+	unsigned int i = ( k * 0x9e3779b1u ) >> 22;
+
+	// Linear probe
+	for ( i &= EZD_PALETTE_HASH - 1; m->uKey[ i ]; i = ( i + 1 ) & ( EZD_PALETTE_HASH - 1 ) )
+		if ( m->uKey[ i ] == k )
+			return m->uIdx[ i ];
+
+	if ( 256 <= m->nCols )
+		return -1;
+
+	m->uKey[ i ] = k;
+	m->uIdx[ i ] = (unsigned char)m->nCols;
+	m->pal[ m->nCols ] = k - 1;
+
+	return m->nCols++;
+}
+
+/// Converts image row y to palette indices, returns zero if the palette overflows
+static int ezd_palette_row( SImageData *p, int y, SPaletteMap *m, unsigned char *pIdx )
+{
+	int x, i, col, last = -1, w = EZD_ABS( p->bih.biWidth );
+	int pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	unsigned char *pImg = &p->pImage[ y * EZD_SCANWIDTH( w, p->bih.biBitCount, 4 ) ];
+
+	for ( x = 0, i = 0; x < w; x++ )
+	{
+		switch( p->bih.biBitCount )
+		{
+			case 1 :
+				col = p->colPalette[ ( pImg[ x >> 3 ] >> ( 7 - ( x & 7 ) ) ) & 1 ] & 0xffffff;
+				break;
+
+			case 24 :
+				col = pImg[ x * pw ] | ( pImg[ x * pw + 1 ] << 8 ) | ( pImg[ x * pw + 2 ] << 16 );
+				break;
+
+			default :
+				col = *(unsigned int*)&pImg[ x * pw ] & 0xffffff;
+				break;
+
+		} // end switch
+
+		// Flat areas repeat the last color
+		if ( col != last )
+		{	i = ezd_palette_index( m, col );
+			if ( 0 > i )
+				return 0;
+			last = col;
+		} // end if
+
+		pIdx[ x ] = (unsigned char)i;
+
+	} // end for
+
+	return 1;
+}
+
+/// Returns the length of the run starting at p, up to n, comparing eight indices at a time
+static int ezd_run_length( const unsigned char *p, int n )
+{
+	int i = 1;
+	unsigned long long v, r = (unsigned long long)p[ 0 ] * 0x0101010101010101ull;
+
+	while ( i + 8 <= n )
+	{	EZD_MEMCPY( (char*)&v, (const char*)&p[ i ], 8 );
+		if ( v != r )
+			break;
+		i += 8;
+	} // end while
+
+	while ( i < n && p[ i ] == p[ 0 ] )
+		i++;
+
+	return i;
+}
+
+/// RLE encodes a row of palette indices, returns the number of bytes written to pOut
+static int ezd_rle_row( const unsigned char *pIdx, int w, int bRle4, unsigned char *pOut )
+{
+	int i = 0, j, k, r, n = 0;
+
+	while ( i < w )
+	{
+		// Encoded mode for runs
+		r = ezd_run_length( &pIdx[ i ], ( 255 < w - i ) ? 255 : w - i );
+		if ( 1 < r )
+		{	pOut[ n++ ] = (unsigned char)r;
+			pOut[ n++ ] = bRle4 ? (unsigned char)( pIdx[ i ] * 0x11 ) : pIdx[ i ];
+			i += r;
+			continue;
+		} // end if
+
+		// Gather single pixels until the next run
+		for ( j = i + 1; j < w && j - i < 255; j++ )
+			if ( j + 1 < w && pIdx[ j ] == pIdx[ j + 1 ] )
+				break;
+
+		// Some decoders drop the last pixel of an odd RLE4 absolute run
+		if ( bRle4 && 1 < j - i && ( ( j - i ) & 1 ) )
+			j--;
+
+		// Absolute mode needs at least three pixels
+		if ( 3 > j - i )
+		{	for ( ; i < j; i++ )
+				pOut[ n++ ] = 1,
+				pOut[ n++ ] = bRle4 ? (unsigned char)( pIdx[ i ] << 4 ) : pIdx[ i ];
+			continue;
+		} // end if
+
+		pOut[ n++ ] = 0;
+		pOut[ n++ ] = (unsigned char)( j - i );
+
+		if ( bRle4 )
+		{	for ( k = i; k < j; k += 2 )
+				pOut[ n++ ] = (unsigned char)( ( pIdx[ k ] << 4 ) | ( ( k + 1 < j ) ? pIdx[ k + 1 ] : 0 ) );
+			k = ( j - i + 1 ) / 2;
+		} // end if
+		else
+			for ( k = i; k < j; k++ )
+				pOut[ n++ ] = pIdx[ k ];
+
+		// Absolute runs are padded to a word boundary
+		if ( ( bRle4 ? k : j - i ) & 1 )
+			pOut[ n++ ] = 0;
+
+		i = j;
+
+	} // end while
+
+	return n;
+}
+
+/// Builds the palette and writes the RLE file, returns the file size or zero
+static int ezd_rle_write( SImageData *p, SPaletteMap *m, unsigned char *pIdx, unsigned char *pOut,
+						  t_ezd_write pf, void *pUser )
+{
+	int y, bRle4, nOut = 0;
+	int w = EZD_ABS( p->bih.biWidth ), h = EZD_ABS( p->bih.biHeight );
+	SDIBFileHeader dfh;
+	SBitmapInfoHeader bih;
+
+	// Build the palette
+	for ( y = 0; y < h; y++ )
+		if ( !ezd_palette_row( p, y, m, pIdx ) )
+			return _ERR( 0, "Image has more than 256 colors" );
+
+	bRle4 = 16 >= m->nCols;
+
+	// Compressed DIBs are always stored bottom-up
+	for ( y = 0; y < h; y++ )
+	{	ezd_palette_row( p, ( 0 > p->bih.biHeight ) ? h - 1 - y : y, m, pIdx );
+		nOut += ezd_rle_row( pIdx, w, bRle4, &pOut[ nOut ] );
+		pOut[ nOut++ ] = 0;
+		pOut[ nOut++ ] = ( y + 1 < h ) ? 0 : 1;
+	} // end for
+
+	bih = p->bih;
+	bih.biHeight = h;
+	bih.biBitCount = bRle4 ? 4 : 8;
+	bih.biCompression = bRle4 ? 2 : 1;
+	bih.biSizeImage = nOut;
+	bih.biClrUsed = m->nCols;
+	bih.biClrImportant = 0;
+
+	dfh.uMagicNumber = EZD_MAGIC_NUMBER;
+	dfh.uReserved1 = 0;
+	dfh.uReserved2 = 0;
+	dfh.uOffset = sizeof( dfh ) + sizeof( bih ) + m->nCols * sizeof( int );
+	dfh.uSize = dfh.uOffset + nOut;
+
+	if ( !pf( pUser, &dfh, sizeof( dfh ) )
+		 || !pf( pUser, &bih, sizeof( bih ) )
+		 || !pf( pUser, m->pal, m->nCols * sizeof( int ) )
+		 || !pf( pUser, pOut, nOut ) )
+		return _ERR( 0, "Error writing DIB file" );
+
+	return dfh.uSize;
+}
+
+#endif
+
+int ezd_save_rle_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int w, h, ok = 0;
+	SDIBFileHeader dfh;
+	SPaletteMap *m;
+	unsigned char *pIdx, *pOut;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( 0 > ezd_file_header( p, &dfh ) || !x_pf )
+		return _ERR( 0, "Invalid parameters" );
+
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Worst case is two bytes per pixel, plus the end of line codes
+	m = (SPaletteMap*)EZD_calloc( 1, sizeof( SPaletteMap ) );
+	pIdx = (unsigned char*)EZD_malloc( w + 8 );
+	pOut = (unsigned char*)EZD_malloc( (long)h * ( w * 2 + 2 ) + 2 );
+
+	if ( m && pIdx && pOut )
+		ok = ezd_rle_write( p, m, pIdx, pOut, x_pf, x_pUser );
+	else
+		ok = _ERR( 0, "Out of memory" );
+
+	if ( m )
+		EZD_free( m );
+	if ( pIdx )
+		EZD_free( pIdx );
+	if ( pOut )
+		EZD_free( pOut );
+
+	return ok;
+#endif
+}
+
+int ezd_save_rle( HEZDIMAGE x_hDib, const char *x_pFile )
+{
+#if defined( EZD_NO_FILES )
+	return 0;
+#else
+	FILE *fh;
+	int ok;
+
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( 0, "Invalid parameters" );
+
+	fh = fopen ( x_pFile, "wb" );
+	if ( !fh )
+		return _ERR( 0, "Failed to open DIB file for writing" );
+
+	ok = ezd_save_rle_sink( x_hDib, ezd_fwrite, fh );
+
+	if ( fclose( fh ) )
+		return _ERR( 0, "Error closing DIB file" );
+
+	return ok ? 1 : 0;
+#endif
+}
+
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Deflate window size
+#define EZD_DEFLATE_WINDOW		32768
+
+/// Deflate hash table size
+#define EZD_DEFLATE_HASH		32768
+
+/// Longest hash chain searched for a match
+#define EZD_DEFLATE_CHAIN		8
+
+/// Symbols collected before a block is written
+#define EZD_DEFLATE_BLOCK		16384
+
+static const unsigned short ezd_len_base[ 29 ] =
+{	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+static const unsigned char ezd_len_extra[ 29 ] =
+{	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+static const unsigned short ezd_dist_base[ 30 ] =
+{	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+static const unsigned char ezd_dist_extra[ 30 ] =
+{	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/// Order code length code lengths are sent in
+static const unsigned char ezd_cl_order[ 19 ] =
+{	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/// Compresses one piece of a deflate stream
+typedef struct _SDeflate
+{
+	/// Data to compress
+	const unsigned char		*pIn;
+
+	/// Bytes in pIn
+	long					nIn;
+
+	/// Non zero if this piece ends the stream
+	int						bFinal;
+
+	/// Output buffer
+	unsigned char			*pOut;
+
+	/// Bytes written to pOut
+	long					nOut;
+
+	/// Bit buffer
+	unsigned int			uBits;
+
+	/// Number of bits in uBits
+	int						nBits;
+
+	/// Literal or length for each symbol
+	unsigned short			*pSym;
+
+	/// Distance for each symbol, zero for literals
+	unsigned short			*pDist;
+
+	/// Number of symbols in the current block
+	int						nSym;
+
+	/// Input offset where the current block starts
+	long					nBlock;
+
+} SDeflate;
+
+/// Writes n bits of v, least significant first
+static void ezd_put_bits( SDeflate *d, unsigned int v, int n )
+{
+	d->uBits |= v << d->nBits;
+	d->nBits += n;
+	while ( 8 <= d->nBits )
+		d->pOut[ d->nOut++ ] = (unsigned char)d->uBits,
+		d->uBits >>= 8, d->nBits -= 8;
+}
+
+/// Pads the bit stream to a byte boundary
+static void ezd_align_bits( SDeflate *d )
+{
+	if ( d->nBits )
+		ezd_put_bits( d, 0, 8 - d->nBits );
+}
+
+/// Returns the length code, 257 to 285, for a match length
+static int ezd_len_code( int len )
+{
+	int c = 0;
+	while ( c < 28 && ezd_len_base[ c + 1 ] <= len )
+		c++;
+	return c;
+}
+
+/// Returns the distance code for a match distance
+static int ezd_dist_code( int dist )
+{
+	int c = 0, d = dist - 1;
+
+	if ( 4 > d )
+		return d;
+
+	// Two codes for each power of two
+	while ( ( 2 << c ) <= d )
+		c++;
+
+	return 2 * c + ( ( d >> ( c - 1 ) ) & 1 );
+}
+
+/// Calculates Huffman code lengths no longer than nMax bits
+static void ezd_huff_lengths( const unsigned int *pFreq, int n, int nMax, unsigned char *pLen )
+{
+	int i, j, a, b, nUsed, nNodes, bFit = 0;
+	unsigned int f[ 2 * 288 ];
+	int parent[ 2 * 288 ], node[ 288 ];
+
+	for ( i = 0; i < n; i++ )
+		f[ i ] = pFreq[ i ];
+
+	while ( !bFit )
+	{
+		// Leaves
+		for ( i = 0, nUsed = 0; i < n; i++ )
+		{	pLen[ i ] = 0;
+			if ( f[ i ] )
+				node[ nUsed++ ] = i, parent[ i ] = -1;
+		} // end for
+
+		// A code needs at least two symbols
+		for ( i = 0; 2 > nUsed && i < n; i++ )
+			if ( !f[ i ] )
+				f[ i ] = 1, node[ nUsed++ ] = i, parent[ i ] = -1;
+
+		// Merge the two lightest nodes until one is left
+		for ( nNodes = n; 1 < nUsed; nNodes++ )
+		{
+			for ( a = 0, j = 1; j < nUsed; j++ )
+				if ( f[ node[ j ] ] < f[ node[ a ] ] )
+					a = j;
+			for ( b = a ? 0 : 1, j = 0; j < nUsed; j++ )
+				if ( j != a && f[ node[ j ] ] < f[ node[ b ] ] )
+					b = j;
+
+			f[ nNodes ] = f[ node[ a ] ] + f[ node[ b ] ];
+			parent[ node[ a ] ] = parent[ node[ b ] ] = nNodes;
+			parent[ nNodes ] = -1;
+
+			// Replace a with the new node, remove b
+			node[ a ] = nNodes;
+			node[ b ] = node[ --nUsed ];
+
+		} // end for
+
+		// Depth of each leaf
+		for ( i = 0, bFit = 1; i < n; i++ )
+			if ( f[ i ] )
+			{	for ( j = parent[ i ], a = 0; 0 <= j; j = parent[ j ] )
+					a++;
+				pLen[ i ] = (unsigned char)a;
+				if ( a > nMax )
+					bFit = 0;
+			} // end if
+
+		// Flatten the frequencies and try again
+		if ( !bFit )
+			for ( i = 0; i < n; i++ )
+				if ( f[ i ] )
+					f[ i ] = ( f[ i ] >> 1 ) | 1;
+
+	} // end while
+}
+
+/// Calculates bit reversed canonical Huffman codes from code lengths
+static void ezd_huff_codes( const unsigned char *pLen, int n, unsigned short *pCode )
+{
+	int i, b, next[ 16 ], count[ 16 ];
+
+	for ( i = 0; i < 16; i++ )
+		count[ i ] = 0;
+	for ( i = 0; i < n; i++ )
+		count[ pLen[ i ] ]++;
+
+	count[ 0 ] = 0;
+	for ( next[ 0 ] = 0, i = 1; i < 16; i++ )
+		next[ i ] = ( next[ i - 1 ] + count[ i - 1 ] ) << 1;
+
+	for ( i = 0; i < n; i++ )
+		if ( pLen[ i ] )
+		{	unsigned int c = next[ pLen[ i ] ]++, r = 0;
+			for ( b = 0; b < pLen[ i ]; b++ )
+				r = ( r << 1 ) | ( ( c >> b ) & 1 );
+			pCode[ i ] = (unsigned short)r;
+		} // end if
+}
+
+/// Writes the symbols of a block with the given codes
+static void ezd_deflate_symbols( SDeflate *d, const unsigned char *pLitLen, const unsigned short *pLitCode,
+								 const unsigned char *pDistLen, const unsigned short *pDistCode )
+{
+	int i, c;
+
+	for ( i = 0; i < d->nSym; i++ )
+	{
+		if ( !d->pDist[ i ] )
+		{	ezd_put_bits( d, pLitCode[ d->pSym[ i ] ], pLitLen[ d->pSym[ i ] ] );
+			continue;
+		} // end if
+
+		c = ezd_len_code( d->pSym[ i ] );
+		ezd_put_bits( d, pLitCode[ 257 + c ], pLitLen[ 257 + c ] );
+		ezd_put_bits( d, d->pSym[ i ] - ezd_len_base[ c ], ezd_len_extra[ c ] );
+
+		c = ezd_dist_code( d->pDist[ i ] );
+		ezd_put_bits( d, pDistCode[ c ], pDistLen[ c ] );
+		ezd_put_bits( d, d->pDist[ i ] - ezd_dist_base[ c ], ezd_dist_extra[ c ] );
+
+	} // end for
+
+	ezd_put_bits( d, pLitCode[ 256 ], pLitLen[ 256 ] );
+}
+
+/// Writes the current block using whichever of stored, fixed or dynamic codes is smallest
+static void ezd_deflate_block( SDeflate *d, long nEnd, int bFinal )
+{
+	int i, j, n, c, nLit, nDist, nCl, nRle;
+	unsigned int fLit[ 286 ], fDist[ 30 ], fCl[ 19 ];
+	unsigned char lLit[ 288 ], lDist[ 30 ], lCl[ 19 ], lAll[ 286 + 30 ], rle[ 286 + 30 ], rleExtra[ 286 + 30 ];
+	unsigned short cLit[ 288 ], cDist[ 30 ], cCl[ 19 ];
+	long nExtra = 0, nFixed, nDyn, nStored, nBytes = nEnd - d->nBlock;
+
+	for ( i = 0; i < 286; i++ )
+		fLit[ i ] = 0;
+	for ( i = 0; i < 30; i++ )
+		fDist[ i ] = 0;
+	for ( i = 0; i < 19; i++ )
+		fCl[ i ] = 0;
+
+	// Symbol frequencies
+	for ( i = 0; i < d->nSym; i++ )
+		if ( !d->pDist[ i ] )
+			fLit[ d->pSym[ i ] ]++;
+		else
+		{	c = ezd_len_code( d->pSym[ i ] );
+			fLit[ 257 + c ]++, nExtra += ezd_len_extra[ c ];
+			c = ezd_dist_code( d->pDist[ i ] );
+			fDist[ c ]++, nExtra += ezd_dist_extra[ c ];
+		} // end else
+	fLit[ 256 ] = 1;
+
+	ezd_huff_lengths( fLit, 286, 15, lLit );
+	ezd_huff_lengths( fDist, 30, 15, lDist );
+
+	for ( nLit = 286; 257 < nLit && !lLit[ nLit - 1 ]; nLit-- )
+		;
+	for ( nDist = 30; 1 < nDist && !lDist[ nDist - 1 ]; nDist-- )
+		;
+
+	// Run length encode the code lengths
+	for ( i = 0; i < nLit; i++ )
+		lAll[ i ] = lLit[ i ];
+	for ( i = 0; i < nDist; i++ )
+		lAll[ nLit + i ] = lDist[ i ];
+
+	for ( i = 0, nRle = 0, n = nLit + nDist; i < n; i += j )
+	{
+		for ( j = 1; i + j < n && lAll[ i + j ] == lAll[ i ]; j++ )
+			;
+
+		if ( !lAll[ i ] && 11 <= j )
+			j = ( 138 < j ) ? 138 : j, rle[ nRle ] = 18, rleExtra[ nRle++ ] = (unsigned char)( j - 11 );
+		else if ( !lAll[ i ] && 3 <= j )
+			rle[ nRle ] = 17, rleExtra[ nRle++ ] = (unsigned char)( j - 3 );
+		else if ( lAll[ i ] && 4 <= j )
+		{	j = ( 7 < j ) ? 7 : j;
+			rle[ nRle ] = lAll[ i ], rleExtra[ nRle++ ] = 0;
+			rle[ nRle ] = 16, rleExtra[ nRle++ ] = (unsigned char)( j - 4 );
+		} // end else if
+		else
+			j = 1, rle[ nRle ] = lAll[ i ], rleExtra[ nRle++ ] = 0;
+
+	} // end for
+
+	for ( i = 0; i < nRle; i++ )
+		fCl[ rle[ i ] ]++;
+
+	ezd_huff_lengths( fCl, 19, 7, lCl );
+
+	for ( nCl = 19; 4 < nCl && !lCl[ ezd_cl_order[ nCl - 1 ] ]; nCl-- )
+		;
+
+	// Size of each block type in bits
+	nDyn = 3 + 14 + 3 * nCl + nExtra;
+	for ( i = 0; i < nRle; i++ )
+		nDyn += lCl[ rle[ i ] ] + ( ( 16 == rle[ i ] ) ? 2 : ( 17 == rle[ i ] ) ? 3 : ( 18 == rle[ i ] ) ? 7 : 0 );
+	for ( i = 0; i < 286; i++ )
+		nDyn += (long)fLit[ i ] * lLit[ i ];
+	for ( i = 0; i < 30; i++ )
+		nDyn += (long)fDist[ i ] * lDist[ i ];
+
+	nFixed = 3 + nExtra;
+	for ( i = 0; i < 286; i++ )
+		nFixed += (long)fLit[ i ] * ( ( 144 > i ) ? 8 : ( 256 > i ) ? 9 : ( 280 > i ) ? 7 : 8 );
+	for ( i = 0; i < 30; i++ )
+		nFixed += (long)fDist[ i ] * 5;
+
+	nStored = ( nBytes / 65535 + 1 ) * 40 + nBytes * 8;
+
+	if ( nStored <= nFixed && nStored <= nDyn )
+	{
+		// Stored blocks hold up to 65535 bytes each
+		do
+		{	n = ( 65535 < nBytes ) ? 65535 : (int)nBytes;
+			ezd_put_bits( d, ( bFinal && n == nBytes ) ? 1 : 0, 3 );
+			ezd_align_bits( d );
+			ezd_put_bits( d, n, 16 );
+			ezd_put_bits( d, n ^ 0xffff, 16 );
+			EZD_MEMCPY( (char*)&d->pOut[ d->nOut ], (const char*)&d->pIn[ d->nBlock ], n );
+			d->nOut += n, d->nBlock += n, nBytes -= n;
+		} while ( 0 < nBytes );
+
+	} // end if
+
+	else if ( nFixed <= nDyn )
+	{
+		for ( i = 0; i < 288; i++ )
+			lLit[ i ] = ( 144 > i ) ? 8 : ( 256 > i ) ? 9 : ( 280 > i ) ? 7 : 8;
+		for ( i = 0; i < 30; i++ )
+			lDist[ i ] = 5;
+		ezd_huff_codes( lLit, 288, cLit );
+		ezd_huff_codes( lDist, 30, cDist );
+
+		ezd_put_bits( d, bFinal ? 3 : 2, 3 );
+		ezd_deflate_symbols( d, lLit, cLit, lDist, cDist );
+
+	} // end else if
+
+	else
+	{
+		ezd_huff_codes( lLit, nLit, cLit );
+		ezd_huff_codes( lDist, nDist, cDist );
+		ezd_huff_codes( lCl, 19, cCl );
+
+		ezd_put_bits( d, bFinal ? 5 : 4, 3 );
+		ezd_put_bits( d, nLit - 257, 5 );
+		ezd_put_bits( d, nDist - 1, 5 );
+		ezd_put_bits( d, nCl - 4, 4 );
+		for ( i = 0; i < nCl; i++ )
+			ezd_put_bits( d, lCl[ ezd_cl_order[ i ] ], 3 );
+
+		for ( i = 0; i < nRle; i++ )
+		{	ezd_put_bits( d, cCl[ rle[ i ] ], lCl[ rle[ i ] ] );
+			if ( 16 <= rle[ i ] )
+				ezd_put_bits( d, rleExtra[ i ], ( 16 == rle[ i ] ) ? 2 : ( 17 == rle[ i ] ) ? 3 : 7 );
+		} // end for
+
+		ezd_deflate_symbols( d, lLit, cLit, lDist, cDist );
+
+	} // end else
+
+	d->nBlock = nEnd;
+	d->nSym = 0;
+}
+
+/// Compresses d->pIn with hash chain LZ77, returns zero if out of memory
+static int ezd_deflate( SDeflate *d )
+{
+	long i, j, m, n = d->nIn, nLen, nDist;
+	int *pHead = (int*)EZD_malloc( ( EZD_DEFLATE_HASH + EZD_DEFLATE_WINDOW ) * sizeof( int ) );
+	int *pPrev = pHead + EZD_DEFLATE_HASH;
+	unsigned short *pSym = (unsigned short*)EZD_malloc( EZD_DEFLATE_BLOCK * 2 * sizeof( unsigned short ) );
+	const unsigned char *s = d->pIn;
+
+	if ( !pHead || !pSym )
+	{	if ( pHead )
+			EZD_free( pHead );
+		if ( pSym )
+			EZD_free( pSym );
+		return _ERR( 0, "Out of memory" );
+	} // end if
+
+	for ( i = 0; i < EZD_DEFLATE_HASH; i++ )
+		pHead[ i ] = -1;
+
+	d->pSym = pSym;
+	d->pDist = pSym + EZD_DEFLATE_BLOCK;
+	d->nSym = 0;
+	d->nBlock = 0;
+
+#	define EZD_DEFLATE_HASH3( p ) ( ( ( (unsigned int)(p)[ 0 ] << 10 ) ^ ( (unsigned int)(p)[ 1 ] << 5 ) ^ (p)[ 2 ] ) & ( EZD_DEFLATE_HASH - 1 ) )
+
+	for ( i = 0; i < n; )
+	{
+		nLen = 0, nDist = 0;
+
+		if ( i + 3 <= n )
+		{
+			unsigned int h = EZD_DEFLATE_HASH3( &s[ i ] );
+			long nMax = ( 258 < n - i ) ? 258 : n - i;
+			int nChain = EZD_DEFLATE_CHAIN;
+
+			// Search the chain for the longest match
+			for ( j = pHead[ h ]; 0 <= j && i - j <= EZD_DEFLATE_WINDOW && nChain--; j = pPrev[ j & ( EZD_DEFLATE_WINDOW - 1 ) ] )
+			{
+				if ( s[ j + nLen ] != s[ i + nLen ] || s[ j ] != s[ i ] )
+					continue;
+
+				for ( m = 0; m < nMax && s[ j + m ] == s[ i + m ]; m++ )
+					;
+
+				if ( m > nLen )
+				{	nLen = m, nDist = i - j;
+					if ( m >= nMax )
+						break;
+				} // end if
+
+			} // end for
+
+			// Insert this position
+			pPrev[ i & ( EZD_DEFLATE_WINDOW - 1 ) ] = pHead[ h ];
+			pHead[ h ] = (int)i;
+
+		} // end if
+
+		if ( 3 <= nLen )
+		{
+			d->pSym[ d->nSym ] = (unsigned short)nLen;
+			d->pDist[ d->nSym++ ] = (unsigned short)nDist;
+
+			// Insert the positions inside the match
+			for ( j = i + 1, i += nLen; j < i && j + 3 <= n; j++ )
+			{	unsigned int h = EZD_DEFLATE_HASH3( &s[ j ] );
+				pPrev[ j & ( EZD_DEFLATE_WINDOW - 1 ) ] = pHead[ h ];
+				pHead[ h ] = (int)j;
+			} // end for
+
+		} // end if
+
+		else
+			d->pSym[ d->nSym ] = s[ i++ ],
+			d->pDist[ d->nSym++ ] = 0;
+
+		if ( EZD_DEFLATE_BLOCK <= d->nSym )
+			ezd_deflate_block( d, i, 0 );
+
+	} // end for
+
+#	undef EZD_DEFLATE_HASH3
+
+	// Last block
+	if ( d->nSym || d->bFinal )
+		ezd_deflate_block( d, n, d->bFinal );
+
+	// Empty stored block to byte align so pieces can be joined
+	if ( !d->bFinal )
+	{	ezd_put_bits( d, 0, 3 );
+		ezd_align_bits( d );
+		ezd_put_bits( d, 0, 16 );
+		ezd_put_bits( d, 0xffff, 16 );
+	} // end if
+
+	ezd_align_bits( d );
+
+	EZD_free( pHead );
+	EZD_free( pSym );
+
+	return 1;
+}
+
+/// State shared by the PNG compression tasks
+typedef struct _SPngTask
+{
+	/// One deflate piece for each task
+	SDeflate				d[ EZD_MAX_THREADS ];
+
+	/// Non zero if any task failed
+	int						nError;
+
+} SPngTask;
+
+/// Compresses one piece of the filtered image
+static void ezd_png_task( void *x_pUser, int i )
+{
+	SPngTask *pt = (SPngTask*)x_pUser;
+	if ( !ezd_deflate( &pt->d[ i ] ) )
+		pt->nError = 1;
+}
+
+/// Paeth predictor
+static int ezd_paeth( int a, int b, int c )
+{
+	int p = a + b - c, pa = EZD_ABS( p - a ), pb = EZD_ABS( p - b ), pc = EZD_ABS( p - c );
+	return ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ) ? b : c;
+}
+
+/// Size of a filtered byte when judging filters
+#define EZD_PNG_COST( v ) ( ( 128 > ( (v) & 0xff ) ) ? ( (v) & 0xff ) : 256 - ( (v) & 0xff ) )
+
+/// Filters a row of n bytes, bpp bytes per pixel, with the filter that gives the smallest sum
+static void ezd_png_filter( const unsigned char *pRow, const unsigned char *pPrev, int n, int bpp, unsigned char *pOut )
+{
+	int f, x, a, b, c, v;
+	long sum[ 5 ] = { 0, 0, 0, 0, 0 };
+
+	// Score every filter in one pass, the first pixel has no left neighbour
+	for ( x = 0; x < n; x++ )
+	{
+		a = ( x >= bpp ) ? pRow[ x - bpp ] : 0;
+		c = ( x >= bpp ) ? pPrev[ x - bpp ] : 0;
+		b = pPrev[ x ];
+		v = pRow[ x ];
+
+		sum[ 0 ] += EZD_PNG_COST( v );
+		sum[ 1 ] += EZD_PNG_COST( v - a );
+		sum[ 2 ] += EZD_PNG_COST( v - b );
+		sum[ 3 ] += EZD_PNG_COST( v - ( ( a + b ) >> 1 ) );
+		sum[ 4 ] += EZD_PNG_COST( v - ezd_paeth( a, b, c ) );
+
+	} // end for
+
+	for ( f = 0, x = 1; x < 5; x++ )
+		if ( sum[ x ] < sum[ f ] )
+			f = x;
+
+	*pOut++ = (unsigned char)f;
+
+	switch( f )
+	{
+		case 0 :
+			EZD_MEMCPY( (char*)pOut, (const char*)pRow, n );
+			break;
+
+		case 1 :
+			for ( x = 0; x < n; x++ )
+				pOut[ x ] = (unsigned char)( pRow[ x ] - ( ( x >= bpp ) ? pRow[ x - bpp ] : 0 ) );
+			break;
+
+		case 2 :
+			for ( x = 0; x < n; x++ )
+				pOut[ x ] = (unsigned char)( pRow[ x ] - pPrev[ x ] );
+			break;
+
+		case 3 :
+			for ( x = 0; x < n; x++ )
+				pOut[ x ] = (unsigned char)( pRow[ x ] - ( ( ( ( x >= bpp ) ? pRow[ x - bpp ] : 0 ) + pPrev[ x ] ) >> 1 ) );
+			break;
+
+		default :
+			for ( x = 0; x < n; x++ )
+				pOut[ x ] = (unsigned char)( pRow[ x ] - ( ( x >= bpp )
+								? ezd_paeth( pRow[ x - bpp ], pPrev[ x ], pPrev[ x - bpp ] ) : pPrev[ x ] ) );
+			break;
+
+	} // end switch
+}
+
+/// CRC-32 as used by PNG chunks
+static unsigned int ezd_crc32( const unsigned int *pTable, unsigned int crc, const void *pData, long n )
+{
+	const unsigned char *p = (const unsigned char*)pData;
+	crc = ~crc;
+	while ( 0 < n-- )
+		crc = pTable[ ( crc ^ *p++ ) & 0xff ] ^ ( crc >> 8 );
+	return ~crc;
+}
+
+/// Stores v big endian
+static void ezd_put_be32( unsigned char *p, unsigned int v )
+{
+	p[ 0 ] = (unsigned char)( v >> 24 ), p[ 1 ] = (unsigned char)( v >> 16 );
+	p[ 2 ] = (unsigned char)( v >> 8 ), p[ 3 ] = (unsigned char)v;
+}
+
+/// Writes a complete PNG chunk
+static int ezd_png_chunk( const unsigned int *pCrc, const char *pType, const void *pData, int nData,
+						  t_ezd_write pf, void *pUser )
+{
+	unsigned char hdr[ 8 ], crc[ 4 ];
+	unsigned int c = ezd_crc32( pCrc, 0, pType, 4 );
+
+	ezd_put_be32( hdr, nData );
+	EZD_MEMCPY( (char*)&hdr[ 4 ], pType, 4 );
+	ezd_put_be32( crc, ezd_crc32( pCrc, c, pData, nData ) );
+
+	return pf( pUser, hdr, 8 ) && ( !nData || pf( pUser, pData, nData ) ) && pf( pUser, crc, 4 );
+}
+
+/// Filters the image into pRaw, returns the PNG color type
+static int ezd_png_rows( SImageData *p, SPaletteMap *m, unsigned char *pRaw, int *pDepth, int *pRowBytes )
+{
+	int x, y, i, w = EZD_ABS( p->bih.biWidth ), h = EZD_ABS( p->bih.biHeight );
+	int sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 ), pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	int rb, depth, bPalette = 1;
+	unsigned char *pRow, *pIdx;
+
+	// Palette if the colors fit
+	if ( 1 == p->bih.biBitCount )
+		m->pal[ 0 ] = p->colPalette[ 0 ] & 0xffffff, m->pal[ 1 ] = p->colPalette[ 1 ] & 0xffffff, m->nCols = 2;
+	else
+		for ( y = 0; bPalette && y < h; y++ )
+			bPalette = ezd_palette_row( p, y, m, pRaw );
+
+	if ( bPalette )
+	{
+		depth = ( 2 >= m->nCols ) ? 1 : ( 4 >= m->nCols ) ? 2 : ( 16 >= m->nCols ) ? 4 : 8;
+		rb = EZD_FITTO( w * depth, 8 );
+		pIdx = pRaw + ( 1 + rb ) * h;
+
+		// Palette images are not filtered, indices are packed high bits first
+		for ( y = 0; y < h; y++ )
+		{
+			pRow = &p->pImage[ ( ( 0 > p->bih.biHeight ) ? y : h - 1 - y ) * sw ];
+			*pRaw++ = 0;
+
+			if ( 1 == p->bih.biBitCount )
+			{	EZD_MEMCPY( (char*)pRaw, (const char*)pRow, rb );
+				pRaw += rb;
+				continue;
+			} // end if
+
+			ezd_palette_row( p, ( 0 > p->bih.biHeight ) ? y : h - 1 - y, m, pIdx );
+			EZD_MEMSET( (char*)pRaw, 0, rb );
+			for ( x = 0; x < w; x++ )
+				pRaw[ ( x * depth ) >> 3 ] |= pIdx[ x ] << ( 8 - depth - ( ( x * depth ) & 7 ) );
+			pRaw += rb;
+
+		} // end for
+
+		*pDepth = depth;
+		*pRowBytes = rb;
+		return 3;
+
+	} // end if
+
+	// True color, pixels are stored blue first
+	rb = w * 3;
+	pRow = pRaw + ( 1 + rb ) * h;
+
+	for ( y = 0; y < h; y++ )
+	{
+		unsigned char *pSrc = &p->pImage[ ( ( 0 > p->bih.biHeight ) ? y : h - 1 - y ) * sw ];
+		unsigned char *pCur = pRow + ( y & 1 ) * rb, *pLast = pRow + ( ~y & 1 ) * rb;
+
+		for ( x = 0, i = 0; x < w; x++, i += 3, pSrc += pw )
+			pCur[ i ] = pSrc[ 2 ], pCur[ i + 1 ] = pSrc[ 1 ], pCur[ i + 2 ] = pSrc[ 0 ];
+
+		// The row above the first is all zeros
+		if ( !y )
+			EZD_MEMSET( (char*)pLast, 0, rb );
+
+		ezd_png_filter( pCur, pLast, rb, 3, pRaw );
+		pRaw += 1 + rb;
+
+	} // end for
+
+	*pDepth = 8;
+	*pRowBytes = rb;
+	return 2;
+}
+
+/// Writes the PNG file, returns the file size or zero
+static int ezd_png_write( SImageData *p, SPaletteMap *m, unsigned char *pRaw, t_ezd_write pf, void *pUser )
+{
+	int i, n, type, depth, rb, ok = 1;
+	long nRaw, nPos, nOut = 0;
+	unsigned int a = 1, b = 0, crc, crcTable[ 256 ];
+	unsigned char hdr[ 16 ], pal[ 256 * 3 ];
+	int w = EZD_ABS( p->bih.biWidth ), h = EZD_ABS( p->bih.biHeight );
+	SPngTask pt;
+
+	for ( i = 0; i < 256; i++ )
+	{	crc = i;
+		for ( n = 0; n < 8; n++ )
+			crc = ( crc & 1 ) ? 0xedb88320u ^ ( crc >> 1 ) : crc >> 1;
+		crcTable[ i ] = crc;
+	} // end for
+
+	type = ezd_png_rows( p, m, pRaw, &depth, &rb );
+	nRaw = (long)( 1 + rb ) * h;
+
+	// Adler-32 of the uncompressed data
+	for ( nPos = 0; nPos < nRaw; )
+	{	long nEnd = ( nPos + 5552 < nRaw ) ? nPos + 5552 : nRaw;
+		for ( ; nPos < nEnd; nPos++ )
+			a += pRaw[ nPos ], b += a;
+		a %= 65521, b %= 65521;
+	} // end for
+
+	// Split the data into pieces that compress independently
+	EZD_MEMSET( (char*)&pt, 0, sizeof( pt ) );
+	n = ezd_task_count( nRaw );
+	for ( i = 0; i < n; i++ )
+	{	SDeflate *d = &pt.d[ i ];
+		d->pIn = pRaw + nRaw * i / n;
+		d->nIn = nRaw * ( i + 1 ) / n - nRaw * i / n;
+		d->bFinal = ( i + 1 == n );
+		d->pOut = (unsigned char*)EZD_malloc( d->nIn + d->nIn / 8 + 1024 );
+		if ( !d->pOut )
+			pt.nError = 1;
+	} // end for
+
+	if ( !pt.nError )
+		ezd_run_tasks( &ezd_png_task, &pt, n );
+
+	if ( !pt.nError )
+	{
+		for ( i = 0; i < n; i++ )
+			nOut += pt.d[ i ].nOut;
+
+		EZD_MEMCPY( (char*)hdr, "\x89PNG\r\n\x1a\n", 8 );
+		ok = pf( pUser, hdr, 8 );
+
+		ezd_put_be32( hdr, w );
+		ezd_put_be32( &hdr[ 4 ], h );
+		hdr[ 8 ] = (unsigned char)depth, hdr[ 9 ] = (unsigned char)type;
+		hdr[ 10 ] = hdr[ 11 ] = hdr[ 12 ] = 0;
+		ok = ok && ezd_png_chunk( crcTable, "IHDR", hdr, 13, pf, pUser );
+
+		if ( 3 == type )
+		{	for ( i = 0; i < m->nCols; i++ )
+				pal[ i * 3 ] = (unsigned char)( m->pal[ i ] >> 16 ),
+				pal[ i * 3 + 1 ] = (unsigned char)( m->pal[ i ] >> 8 ),
+				pal[ i * 3 + 2 ] = (unsigned char)m->pal[ i ];
+			ok = ok && ezd_png_chunk( crcTable, "PLTE", pal, m->nCols * 3, pf, pUser );
+		} // end if
+
+		// One IDAT holding the zlib header, the pieces and the checksum
+		ezd_put_be32( hdr, nOut + 6 );
+		EZD_MEMCPY( (char*)&hdr[ 4 ], "IDAT\x78\x01", 6 );
+		crc = ezd_crc32( crcTable, 0, &hdr[ 4 ], 6 );
+		ok = ok && pf( pUser, hdr, 10 );
+
+		for ( i = 0; ok && i < n; i++ )
+			crc = ezd_crc32( crcTable, crc, pt.d[ i ].pOut, pt.d[ i ].nOut ),
+			ok = pf( pUser, pt.d[ i ].pOut, pt.d[ i ].nOut );
+
+		ezd_put_be32( hdr, ( b << 16 ) | a );
+		ezd_put_be32( &hdr[ 4 ], ezd_crc32( crcTable, crc, hdr, 4 ) );
+		ok = ok && pf( pUser, hdr, 8 );
+
+		ok = ok && ezd_png_chunk( crcTable, "IEND", hdr, 0, pf, pUser );
+
+	} // end if
+
+	for ( i = 0; i < n; i++ )
+		if ( pt.d[ i ].pOut )
+			EZD_free( pt.d[ i ].pOut );
+
+	if ( pt.nError )
+		return _ERR( 0, "Out of memory" );
+
+	if ( !ok )
+		return _ERR( 0, "Error writing PNG file" );
+
+	// Signature, IHDR, PLTE, IDAT and IEND
+	return 8 + 25 + ( ( 3 == type ) ? 12 + m->nCols * 3 : 0 ) + 12 + 6 + nOut + 12;
+}
+
+#endif
+
+int ezd_save_png_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int w, h, ok = 0;
+	SDIBFileHeader dfh;
+	SPaletteMap *m;
+	unsigned char *pRaw;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( 0 > ezd_file_header( p, &dfh ) || !x_pf )
+		return _ERR( 0, "Invalid parameters" );
+
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Filtered rows, followed by room for two unfiltered rows
+	m = (SPaletteMap*)EZD_calloc( 1, sizeof( SPaletteMap ) );
+	pRaw = (unsigned char*)EZD_malloc( (long)( 1 + w * 3 ) * h + w * 6 + 8 );
+
+	if ( m && pRaw )
+		ok = ezd_png_write( p, m, pRaw, x_pf, x_pUser );
+	else
+		ok = _ERR( 0, "Out of memory" );
+
+	if ( m )
+		EZD_free( m );
+	if ( pRaw )
+		EZD_free( pRaw );
+
+	return ok;
+#endif
+}
+
+/// Destination for ezd_save_png_mem()
+typedef struct _SMemWriter
+{
+	/// Output buffer, NULL to only count bytes
+	unsigned char			*pBuf;
+
+	/// Size of pBuf
+	int						nBuf;
+
+	/// Bytes written so far
+	int						nPos;
+
+} SMemWriter;
+
+/// ezd_save_sink() write function for memory buffers
+static int ezd_mem_write( void *pUser, const void *pData, int nData )
+{
+	SMemWriter *mw = (SMemWriter*)pUser;
+
+	if ( mw->pBuf )
+	{	if ( nData > mw->nBuf - mw->nPos )
+			return 0;
+		EZD_MEMCPY( (char*)&mw->pBuf[ mw->nPos ], (const char*)pData, nData );
+	} // end if
+
+	mw->nPos += nData;
+
+	return 1;
+}
+
+int ezd_save_png_mem( HEZDIMAGE x_hDib, void *x_pBuf, int x_nBuf )
+{
+	SMemWriter mw;
+
+	mw.pBuf = (unsigned char*)x_pBuf;
+	mw.nBuf = x_nBuf;
+	mw.nPos = 0;
+
+	if ( x_pBuf && 0 >= x_nBuf )
+		return _ERR( 0, "Invalid parameters" );
+
+	return ezd_save_png_sink( x_hDib, ezd_mem_write, &mw ) ? mw.nPos : 0;
+}
+
+int ezd_save_png( HEZDIMAGE x_hDib, const char *x_pFile )
+{
+#if defined( EZD_NO_FILES )
+	return 0;
+#else
+	FILE *fh;
+	int ok;
+
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( 0, "Invalid parameters" );
+
+	fh = fopen ( x_pFile, "wb" );
+	if ( !fh )
+		return _ERR( 0, "Failed to open PNG file for writing" );
+
+	ok = ezd_save_png_sink( x_hDib, ezd_fwrite, fh );
+
+	if ( fclose( fh ) )
+		return _ERR( 0, "Error closing PNG file" );
+
+	return ok ? 1 : 0;
+#endif
+}
+
+/// Bytes buffered by the QOI encoder between writes
+#define EZD_QOI_BUFFER		4096
+
+/// Position of a pixel stored as 0xAARRGGBB in the QOI color index
+#define EZD_QOI_HASH( px )	( ( ( ( px >> 16 ) & 0xff ) * 3 + ( ( px >> 8 ) & 0xff ) * 5 \
+							  + ( px & 0xff ) * 7 + ( px >> 24 ) * 11 ) & 63 )
+
+/// Reads a 24 or 32 bit pixel as 0xAARRGGBB
+static unsigned int ezd_qoi_pixel( const unsigned char *p, int pw )
+{
+	return (unsigned int)p[ 0 ] | ( (unsigned int)p[ 1 ] << 8 ) | ( (unsigned int)p[ 2 ] << 16 )
+		   | ( (unsigned int)( ( 4 == pw ) ? 255 - p[ 3 ] : 255 ) << 24 );
+}
+
+/// Returns how many of the n pixels at p repeat the pixel before p, comparing eight bytes at a time
+static int ezd_qoi_run( const unsigned char *p, int n, int pw )
+{
+	int i = 0, nBytes = n * pw;
+	unsigned long long a, b;
+
+	while ( i + 8 <= nBytes )
+	{	EZD_MEMCPY( (char*)&a, (const char*)&p[ i ], 8 );
+		EZD_MEMCPY( (char*)&b, (const char*)&p[ i - pw ], 8 );
+		if ( a != b )
+			break;
+		i += 8;
+	} // end while
+
+	while ( i < nBytes && p[ i ] == p[ i - pw ] )
+		i++;
+
+	return i / pw;
+}
+
+int ezd_save_qoi_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser )
+{
+	int x, y, w, h, sw, pw, i, n, run = 0, nTotal = 0;
+	unsigned int px, prev = 0xff000000, index[ 64 ];
+	unsigned char out[ EZD_QOI_BUFFER ], *pSrc;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage || !x_pf )
+		return _ERR( 0, "Invalid parameters" );
+
+	if ( 24 != p->bih.biBitCount && 32 != p->bih.biBitCount )
+		return _ERR( 0, "QOI files need a 24 or 32 bit image" );
+
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+
+	EZD_MEMSET( (char*)index, 0, sizeof( index ) );
+
+	// Header, sizes are big endian
+	out[ 0 ] = 'q', out[ 1 ] = 'o', out[ 2 ] = 'i', out[ 3 ] = 'f';
+	for ( i = 0; i < 4; i++ )
+		out[ 4 + i ] = (unsigned char)( w >> ( 24 - i * 8 ) ),
+		out[ 8 + i ] = (unsigned char)( h >> ( 24 - i * 8 ) );
+	out[ 12 ] = (unsigned char)pw;
+	out[ 13 ] = 0;
+	n = 14;
+
+	for ( y = 0; y < h; y++ )
+	{
+		pSrc = &p->pImage[ ( ( 0 > p->bih.biHeight ) ? y : h - 1 - y ) * sw ];
+
+		for ( x = 0; x < w; )
+		{
+			// Room for a run byte plus the longest chunk
+			if ( EZD_QOI_BUFFER - 6 < n )
+			{	if ( !x_pf( x_pUser, out, n ) )
+					return _ERR( 0, "Error writing QOI data" );
+				nTotal += n, n = 0;
+			} // end if
+
+			px = ezd_qoi_pixel( pSrc, pw );
+
+			// Runs carry over into the next row
+			if ( px == prev )
+			{	i = ( w - x - 1 < 61 - run ) ? w - x - 1 : 61 - run;
+				i = 1 + ezd_qoi_run( pSrc + pw, i, pw );
+				x += i, pSrc += i * pw, run += i;
+				if ( 62 == run )
+					out[ n++ ] = 0xc0 | 61, run = 0;
+				continue;
+			} // end if
+
+			if ( run )
+				out[ n++ ] = (unsigned char)( 0xc0 | ( run - 1 ) ), run = 0;
+
+			i = EZD_QOI_HASH( px );
+			if ( index[ i ] == px )
+				out[ n++ ] = (unsigned char)i;
+
+			else
+			{
+				index[ i ] = px;
+
+				if ( ( px >> 24 ) == ( prev >> 24 ) )
+				{
+					int dr = (signed char)( ( px >> 16 ) - ( prev >> 16 ) );
+					int dg = (signed char)( ( px >> 8 ) - ( prev >> 8 ) );
+					int db = (signed char)( px - prev );
+
+					if ( -3 < dr && 2 > dr && -3 < dg && 2 > dg && -3 < db && 2 > db )
+						out[ n++ ] = (unsigned char)( 0x40 | ( ( dr + 2 ) << 4 ) | ( ( dg + 2 ) << 2 ) | ( db + 2 ) );
+
+					else if ( -33 < dg && 32 > dg && -9 < dr - dg && 8 > dr - dg && -9 < db - dg && 8 > db - dg )
+						out[ n++ ] = (unsigned char)( 0x80 | ( dg + 32 ) ),
+						out[ n++ ] = (unsigned char)( ( ( dr - dg + 8 ) << 4 ) | ( db - dg + 8 ) );
+
+					else
+						out[ n++ ] = 0xfe, out[ n++ ] = (unsigned char)( px >> 16 ),
+						out[ n++ ] = (unsigned char)( px >> 8 ), out[ n++ ] = (unsigned char)px;
+
+				} // end if
+
+				else
+					out[ n++ ] = 0xff, out[ n++ ] = (unsigned char)( px >> 16 ),
+					out[ n++ ] = (unsigned char)( px >> 8 ), out[ n++ ] = (unsigned char)px,
+					out[ n++ ] = (unsigned char)( px >> 24 );
+
+			} // end else
+
+			prev = px;
+			x++, pSrc += pw;
+
+		} // end for
+
+	} // end for
+
+	// Room for the last run and the end marker
+	if ( EZD_QOI_BUFFER - 9 < n )
+	{	if ( !x_pf( x_pUser, out, n ) )
+			return _ERR( 0, "Error writing QOI data" );
+		nTotal += n, n = 0;
+	} // end if
+
+	if ( run )
+		out[ n++ ] = (unsigned char)( 0xc0 | ( run - 1 ) );
+
+	// End marker
+	for ( i = 0; i < 7; i++ )
+		out[ n++ ] = 0;
+	out[ n++ ] = 1;
+
+	if ( !x_pf( x_pUser, out, n ) )
+		return _ERR( 0, "Error writing QOI data" );
+
+	return nTotal + n;
+}
+
+int ezd_save_qoi( HEZDIMAGE x_hDib, const char *x_pFile )
+{
+#if defined( EZD_NO_FILES )
+	return 0;
+#else
+	FILE *fh;
+	int ok;
+
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( 0, "Invalid parameters" );
+
+	fh = fopen ( x_pFile, "wb" );
+	if ( !fh )
+		return _ERR( 0, "Failed to open QOI file for writing" );
+
+	ok = ezd_save_qoi_sink( x_hDib, ezd_fwrite, fh );
+
+	if ( fclose( fh ) )
+		return _ERR( 0, "Error closing QOI file" );
+
+	return ok ? 1 : 0;
+#endif
+}
+
+HEZDIMAGE ezd_load_qoi_mem( const void *x_pBuf, int x_nBuf )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int x, y, w, h, sw, pw, op, run = 0, ok = 1;
+	unsigned int px = 0xff000000, index[ 64 ];
+	const unsigned char *s = (const unsigned char*)x_pBuf, *pEnd;
+	unsigned char *pDst;
+	SImageData *p;
+
+	if ( !s || 22 > x_nBuf )
+		return _ERR( (HEZDIMAGE)0, "Invalid parameters" );
+
+	w = (int)( ( (unsigned int)s[ 4 ] << 24 ) | ( s[ 5 ] << 16 ) | ( s[ 6 ] << 8 ) | s[ 7 ] );
+	h = (int)( ( (unsigned int)s[ 8 ] << 24 ) | ( s[ 9 ] << 16 ) | ( s[ 10 ] << 8 ) | s[ 11 ] );
+	pw = s[ 12 ];
+
+	if ( 'q' != s[ 0 ] || 'o' != s[ 1 ] || 'i' != s[ 2 ] || 'f' != s[ 3 ]
+		 || 0 >= w || 0 >= h || ( 3 != pw && 4 != pw ) || 0x7fffffff / 4 / w < h )
+		return _ERR( (HEZDIMAGE)0, "Invalid QOI file" );
+
+	p = (SImageData*)ezd_create( w, -h, 8 * pw, 0 );
+	if ( !p )
+		return 0;
+
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	EZD_MEMSET( (char*)index, 0, sizeof( index ) );
+
+	// Chunks are at most five bytes, so checking the start against the
+	// end marker keeps every read inside the buffer
+	pEnd = s + x_nBuf - 8;
+	s += 14;
+
+	for ( y = 0; ok && y < h; y++ )
+	{
+		pDst = &p->pImage[ y * sw ];
+
+		for ( x = 0; x < w; x++, pDst += pw )
+		{
+			if ( run )
+				run--;
+
+			else if ( s >= pEnd )
+			{	ok = 0;
+				break;
+			} // end else if
+
+			else
+			{
+				op = *s++;
+
+				if ( 0xfe == op )
+					px = ( px & 0xff000000 ) | ( s[ 0 ] << 16 ) | ( s[ 1 ] << 8 ) | s[ 2 ], s += 3;
+
+				else if ( 0xff == op )
+					px = ( (unsigned int)s[ 3 ] << 24 ) | ( s[ 0 ] << 16 ) | ( s[ 1 ] << 8 ) | s[ 2 ], s += 4;
+
+				else switch ( op & 0xc0 )
+				{
+					case 0x00 :
+						px = index[ op ];
+						break;
+
+					case 0x40 :
+						px = ( px & 0xff000000 )
+							 | ( ( ( px >> 16 ) + ( ( op >> 4 ) & 3 ) - 2 ) & 0xff ) << 16
+							 | ( ( ( px >> 8 ) + ( ( op >> 2 ) & 3 ) - 2 ) & 0xff ) << 8
+							 | ( ( px + ( op & 3 ) - 2 ) & 0xff );
+						break;
+
+					case 0x80 :
+					{
+						int dg = ( op & 0x3f ) - 32, dr = dg + ( *s >> 4 ) - 8, db = dg + ( *s & 0x0f ) - 8;
+
+						px = ( px & 0xff000000 )
+							 | ( ( ( px >> 16 ) + dr ) & 0xff ) << 16
+							 | ( ( ( px >> 8 ) + dg ) & 0xff ) << 8
+							 | ( ( px + db ) & 0xff );
+						s++;
+
+					} break;
+
+					default :
+						run = op & 0x3f;
+						break;
+
+				} // end switch
+
+				index[ EZD_QOI_HASH( px ) ] = px;
+
+			} // end else
+
+			pDst[ 0 ] = (unsigned char)px;
+			pDst[ 1 ] = (unsigned char)( px >> 8 );
+			pDst[ 2 ] = (unsigned char)( px >> 16 );
+			if ( 4 == pw )
+				pDst[ 3 ] = (unsigned char)( 255 - ( px >> 24 ) );
+
+		} // end for
+
+	} // end for
+
+	if ( !ok )
+	{	ezd_destroy( (HEZDIMAGE)p );
+		return _ERR( (HEZDIMAGE)0, "Truncated QOI file" );
+	} // end if
+
+	return (HEZDIMAGE)p;
+#endif
+}
+
+HEZDIMAGE ezd_load_qoi( const char *x_pFile )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	long nSize;
+	unsigned char *pBuf;
+	HEZDIMAGE hDib;
+
+	pBuf = ezd_read_file( x_pFile, &nSize );
+	if ( !pBuf )
+		return 0;
+
+	hDib = ( 0x7fffffff >= nSize ) ? ezd_load_qoi_mem( pBuf, (int)nSize ) : 0;
+
+	EZD_free( pBuf );
+
+	return hDib;
+#endif
+}
+
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Slots in the LZW string table hash
+#define EZD_GIF_HASH		8192
+
+/// State for a GIF writer
+typedef struct _SGifData
+{
+	/// Output sink
+	t_ezd_write				pf;
+
+	/// User data passed to pf
+	void					*pUser;
+
+#if !defined( EZD_NO_FILES )
+	/// Output file, if the writer owns one
+	FILE					*fh;
+#endif
+
+	/// Repeat count for the looping extension, negative for none
+	int						nLoops;
+
+	/// Size set by the first frame
+	int						w, h;
+
+	/// Frames written so far
+	int						nFrames;
+
+	/// Frame buffers, pCur and pPrev point into pBuf
+	void					*pBuf;
+
+	/// Colors of the current and previous frames, top row first
+	int						*pCur, *pPrev;
+
+	/// Palette indices for the changed box
+	unsigned char			*pIdx;
+
+	/// Palette of the current frame
+	SPaletteMap				m;
+
+	/// LZW string table, prefix code and next index plus one for each slot
+	unsigned int			uKey[ EZD_GIF_HASH ];
+
+	/// LZW code for each slot
+	unsigned short			uCode[ EZD_GIF_HASH ];
+
+	/// Pending LZW bits
+	unsigned int			uBits;
+
+	/// Number of bits in uBits
+	int						nBits;
+
+	/// Data sub-block being filled, the first byte is its length
+	unsigned char			blk[ 256 ];
+
+	/// Bytes in blk
+	int						nBlk;
+
+	/// Output waiting to be written
+	unsigned char			out[ 4096 ];
+
+	/// Bytes in out
+	int						nOut;
+
+	/// Bytes passed to pf
+	int						nTotal;
+
+	/// Non zero if a write has failed
+	int						nError;
+
+} SGifData;
+
+/// Passes buffered output to the sink
+static void ezd_gif_flush( SGifData *g )
+{
+	if ( g->nOut && !g->nError && !g->pf( g->pUser, g->out, g->nOut ) )
+		g->nError = 1;
+
+	g->nTotal += g->nOut;
+	g->nOut = 0;
+}
+
+/// Appends bytes to the output, n must not be more than the size of the buffer
+static void ezd_gif_put( SGifData *g, const void *pData, int n )
+{
+	if ( g->nOut + n > (int)sizeof( g->out ) )
+		ezd_gif_flush( g );
+
+	EZD_MEMCPY( (char*)&g->out[ g->nOut ], (const char*)pData, n );
+	g->nOut += n;
+}
+
+/// Stores a 16 bit little endian value
+static void ezd_put_le16( unsigned char *p, int v )
+{
+	p[ 0 ] = (unsigned char)v;
+	p[ 1 ] = (unsigned char)( v >> 8 );
+}
+
+/// Adds an LZW code to the data sub-blocks, least significant bit first
+static void ezd_gif_code( SGifData *g, int code, int bits )
+{
+	g->uBits |= (unsigned int)code << g->nBits;
+
+	for ( g->nBits += bits; 8 <= g->nBits; g->nBits -= 8, g->uBits >>= 8 )
+	{
+		g->blk[ ++g->nBlk ] = (unsigned char)g->uBits;
+
+		if ( 255 == g->nBlk )
+		{	g->blk[ 0 ] = 255;
+			ezd_gif_put( g, g->blk, 256 );
+			g->nBlk = 0;
+		} // end if
+
+	} // end for
+}
+
+/// LZW compresses n palette indices, writing the data sub-blocks and their terminator
+static void ezd_gif_lzw( SGifData *g, const unsigned char *pIdx, long n, int mcs )
+{
+	long j;
+	unsigned int i, key;
+	int clear = 1 << mcs, next = clear + 2, cs = mcs + 1, prefix = pIdx[ 0 ];
+
+	EZD_MEMSET( (char*)g->uKey, 0, sizeof( g->uKey ) );
+	ezd_gif_code( g, clear, cs );
+
+	for ( j = 1; j < n; j++ )
+	{
+		// Extend the current string if it is in the table
+		key = ( ( (unsigned int)prefix << 8 ) | pIdx[ j ] ) + 1;
+		for ( i = ( key * 0x9e3779b1u ) >> 19; g->uKey[ i ] && g->uKey[ i ] != key; )
+			i = ( i + 1 ) & ( EZD_GIF_HASH - 1 );
+
+		if ( g->uKey[ i ] )
+		{	prefix = g->uCode[ i ];
+			continue;
+		} // end if
+
+		ezd_gif_code( g, prefix, cs );
+
+		g->uKey[ i ] = key;
+		g->uCode[ i ] = (unsigned short)next++;
+
+		// Start over when the table is full, the decoder widens its
+		// codes one code later than the encoder adds them
+		if ( 4096 == next )
+		{	ezd_gif_code( g, clear, cs );
+			EZD_MEMSET( (char*)g->uKey, 0, sizeof( g->uKey ) );
+			next = clear + 2, cs = mcs + 1;
+		} // end if
+
+		else if ( next > ( 1 << cs ) )
+			cs++;
+
+		prefix = pIdx[ j ];
+
+	} // end for
+
+	ezd_gif_code( g, prefix, cs );
+	ezd_gif_code( g, clear + 1, cs );
+
+	// Last partial byte and block
+	if ( g->nBits )
+		ezd_gif_code( g, 0, 8 - g->nBits );
+	g->uBits = 0, g->nBits = 0;
+
+	g->blk[ 0 ] = (unsigned char)g->nBlk;
+	ezd_gif_put( g, g->blk, g->nBlk + 1 );
+	if ( g->nBlk )
+		ezd_gif_put( g, "", 1 );
+	g->nBlk = 0;
+}
+
+/// Sets up the frame buffers and writes the GIF header for the first frame
+static int ezd_gif_start( SGifData *g, int w, int h )
+{
+	unsigned char hdr[ 32 ];
+
+	if ( 65535 < w || 65535 < h )
+		return _ERR( 0, "Image too large for a GIF" );
+
+	g->pBuf = EZD_malloc( (long)w * h * ( 2 * sizeof( int ) + 1 ) );
+	if ( !g->pBuf )
+		return _ERR( 0, "Out of memory" );
+
+	g->pCur = (int*)g->pBuf;
+	g->pPrev = g->pCur + (long)w * h;
+	g->pIdx = (unsigned char*)( g->pPrev + (long)w * h );
+	g->w = w, g->h = h;
+
+	// No global color table, every frame has its own
+	EZD_MEMCPY( (char*)hdr, "GIF89a", 6 );
+	ezd_put_le16( &hdr[ 6 ], w );
+	ezd_put_le16( &hdr[ 8 ], h );
+	hdr[ 10 ] = 0, hdr[ 11 ] = 0, hdr[ 12 ] = 0;
+	ezd_gif_put( g, hdr, 13 );
+
+	if ( 0 <= g->nLoops )
+	{	EZD_MEMCPY( (char*)hdr, "\x21\xff\x0bNETSCAPE2.0\x03\x01", 16 );
+		ezd_put_le16( &hdr[ 16 ], ( 65535 < g->nLoops ) ? 65535 : g->nLoops );
+		hdr[ 18 ] = 0;
+		ezd_gif_put( g, hdr, 19 );
+	} // end if
+
+	return 1;
+}
+
+/// Finds the box around the pixels that differ between pCur and pPrev, returns zero if none do
+static int ezd_gif_changes( SGifData *g, int *x0, int *y0, int *x1, int *y1 )
+{
+	int x, y, i, w = g->w;
+
+	*x0 = w, *y0 = g->h, *x1 = 0, *y1 = 0;
+
+	for ( y = 0; y < g->h; y++ )
+	{
+		const int *a = &g->pCur[ (long)y * w ], *b = &g->pPrev[ (long)y * w ];
+
+		for ( x = 0; x < w && a[ x ] == b[ x ]; x++ )
+			;
+		if ( x == w )
+			continue;
+
+		// Stops at x at the latest
+		for ( i = w - 1; a[ i ] == b[ i ]; i-- )
+			;
+
+		if ( x < *x0 )
+			*x0 = x;
+		if ( i >= *x1 )
+			*x1 = i + 1;
+		if ( y < *y0 )
+			*y0 = y;
+		*y1 = y + 1;
+
+	} // end for
+
+	return *x0 < *x1;
+}
+
+/// Converts the box to palette indices, returns the bits per index
+static int ezd_gif_palette( SGifData *g, int x0, int y0, int x1, int y1 )
+{
+	int x, y, i = 0, col, last = -1, depth;
+	unsigned char *pIdx = g->pIdx;
+
+	EZD_MEMSET( (char*)&g->m, 0, sizeof( g->m ) );
+
+	for ( y = y0; pIdx && y < y1; y++ )
+		for ( x = x0; x < x1; x++ )
+		{
+			col = g->pCur[ (long)y * g->w + x ];
+			if ( col != last )
+			{	i = ezd_palette_index( &g->m, col );
+				if ( 0 > i )
+				{	pIdx = 0;
+					break;
+				} // end if
+				last = col;
+			} // end if
+
+			*pIdx++ = (unsigned char)i;
+
+		} // end for
+
+	// Too many colors, map them to a 6x7x6 color cube
+	if ( !pIdx )
+	{
+		for ( i = 0; i < 252; i++ )
+			g->m.pal[ i ] = ( ( i / 42 * 255 / 5 ) << 16 ) | ( ( i / 6 % 7 * 255 / 6 ) << 8 ) | ( i % 6 * 255 / 5 );
+		g->m.nCols = 252;
+
+		for ( pIdx = g->pIdx, y = y0; y < y1; y++ )
+			for ( x = x0; x < x1; x++ )
+			{	col = g->pCur[ (long)y * g->w + x ];
+				*pIdx++ = (unsigned char)( ( ( ( col >> 16 ) & 0xff ) * 5 + 127 ) / 255 * 42
+										   + ( ( ( col >> 8 ) & 0xff ) * 6 + 127 ) / 255 * 6
+										   + ( ( col & 0xff ) * 5 + 127 ) / 255 );
+			} // end for
+
+	} // end if
+
+	for ( depth = 1; ( 1 << depth ) < g->m.nCols; depth++ )
+		;
+
+	return depth;
+}
+
+#endif
+
+HEZDGIF ezd_gif_open_sink( t_ezd_write x_pf, void *x_pUser, int x_nLoops )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	SGifData *g;
+
+	if ( !x_pf )
+		return _ERR( (HEZDGIF)0, "Invalid parameters" );
+
+	g = (SGifData*)EZD_calloc( 1, sizeof( SGifData ) );
+	if ( !g )
+		return 0;
+
+	g->pf = x_pf;
+	g->pUser = x_pUser;
+	g->nLoops = x_nLoops;
+
+	return (HEZDGIF)g;
+#endif
+}
+
+HEZDGIF ezd_gif_open( const char *x_pFile, int x_nLoops )
+{
+#if defined( EZD_NO_FILES ) || defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	FILE *fh;
+	SGifData *g;
+
+	if ( !x_pFile || !*x_pFile )
+		return _ERR( (HEZDGIF)0, "Invalid parameters" );
+
+	fh = fopen( x_pFile, "wb" );
+	if ( !fh )
+		return _ERR( (HEZDGIF)0, "Failed to open GIF file for writing" );
+
+	g = (SGifData*)ezd_gif_open_sink( ezd_fwrite, fh, x_nLoops );
+	if ( !g )
+	{	fclose( fh ); return 0; }
+
+	g->fh = fh;
+
+	return (HEZDGIF)g;
+#endif
+}
+
+int ezd_gif_frame( HEZDGIF x_hGif, HEZDIMAGE x_hDib, int x_nDelay )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int x, y, w, h, x0, y0, x1, y1, i, depth;
+	unsigned char hdr[ 32 ], pal[ 256 * 3 ];
+	SGifData *g = (SGifData*)x_hGif;
+	SImageData *p = (SImageData*)x_hDib;
+	int *t;
+
+	if ( !g || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage || 0 > x_nDelay )
+		return _ERR( 0, "Invalid parameters" );
+
+	if ( g->nError )
+		return _ERR( 0, "A previous write failed" );
+
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// The first frame sets the size
+	if ( !g->pBuf )
+	{	if ( !ezd_gif_start( g, w, h ) )
+			return 0;
+	} // end if
+
+	else if ( w != g->w || h != g->h )
+		return _ERR( 0, "Frames must all be the same size" );
+
+	for ( y = 0; y < h; y++ )
+	{	int *pRow = &g->pCur[ (long)y * w ];
+		if ( !ezd_get_row( x_hDib, 0, ( 0 > p->bih.biHeight ) ? y : h - 1 - y, w, pRow ) )
+			return 0;
+		for ( x = 0; x < w; x++ )
+			pRow[ x ] &= 0xffffff;
+	} // end for
+
+	// Only the box that changed, an unchanged frame still needs one
+	// pixel to carry its delay
+	if ( !g->nFrames )
+		x0 = 0, y0 = 0, x1 = w, y1 = h;
+	else if ( !ezd_gif_changes( g, &x0, &y0, &x1, &y1 ) )
+		x0 = 0, y0 = 0, x1 = 1, y1 = 1;
+
+	depth = ezd_gif_palette( g, x0, y0, x1, y1 );
+
+	// Graphic control extension, frames are drawn over the one before
+	hdr[ 0 ] = 0x21, hdr[ 1 ] = 0xf9, hdr[ 2 ] = 4, hdr[ 3 ] = 1 << 2;
+	ezd_put_le16( &hdr[ 4 ], ( 65535 < x_nDelay ) ? 65535 : x_nDelay );
+	hdr[ 6 ] = 0, hdr[ 7 ] = 0;
+
+	// Image descriptor with a local color table
+	hdr[ 8 ] = 0x2c;
+	ezd_put_le16( &hdr[ 9 ], x0 );
+	ezd_put_le16( &hdr[ 11 ], y0 );
+	ezd_put_le16( &hdr[ 13 ], x1 - x0 );
+	ezd_put_le16( &hdr[ 15 ], y1 - y0 );
+	hdr[ 17 ] = (unsigned char)( 0x80 | ( depth - 1 ) );
+	ezd_gif_put( g, hdr, 18 );
+
+	EZD_MEMSET( (char*)pal, 0, sizeof( pal ) );
+	for ( i = 0; i < g->m.nCols; i++ )
+		pal[ i * 3 ] = (unsigned char)( g->m.pal[ i ] >> 16 ),
+		pal[ i * 3 + 1 ] = (unsigned char)( g->m.pal[ i ] >> 8 ),
+		pal[ i * 3 + 2 ] = (unsigned char)g->m.pal[ i ];
+	ezd_gif_put( g, pal, 3 << depth );
+
+	// Minimum code size is two bits
+	hdr[ 0 ] = (unsigned char)( ( 2 > depth ) ? 2 : depth );
+	ezd_gif_put( g, hdr, 1 );
+	ezd_gif_lzw( g, g->pIdx, (long)( x1 - x0 ) * ( y1 - y0 ), hdr[ 0 ] );
+
+	// This frame is what the next one is compared with
+	t = g->pPrev, g->pPrev = g->pCur, g->pCur = t;
+	g->nFrames++;
+
+	return !g->nError;
+#endif
+}
+
+int ezd_gif_close( HEZDGIF x_hGif )
+{
+	int ok = 0;
+#if !defined( EZD_NO_ALLOCATION )
+	SGifData *g = (SGifData*)x_hGif;
+
+	if ( !g )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Trailer
+	if ( g->nFrames )
+		ezd_gif_put( g, "\x3b", 1 );
+	ezd_gif_flush( g );
+
+	if ( !g->nFrames )
+		ok = _ERR( 0, "No frames were written" );
+	else if ( g->nError )
+		ok = _ERR( 0, "Error writing GIF data" );
+	else
+		ok = g->nTotal;
+
+#if !defined( EZD_NO_FILES )
+	if ( g->fh && fclose( g->fh ) )
+		ok = _ERR( 0, "Error closing GIF file" );
+#endif
+
+	if ( g->pBuf )
+		EZD_free( g->pBuf );
+	EZD_free( g );
+#endif
+
+	return ok;
+}
+
+int ezd_save_gif_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser )
+{
+	int ok, n;
+	HEZDGIF hGif = ezd_gif_open_sink( x_pf, x_pUser, -1 );
+	if ( !hGif )
+		return 0;
+
+	ok = ezd_gif_frame( hGif, x_hDib, 0 );
+	n = ezd_gif_close( hGif );
+
+	return ok ? n : 0;
+}
+
+int ezd_save_gif( HEZDIMAGE x_hDib, const char *x_pFile )
+{
+	int ok;
+	HEZDGIF hGif = ezd_gif_open( x_pFile, -1 );
+	if ( !hGif )
+		return 0;
+
+	ok = ezd_gif_frame( hGif, x_hDib, 0 );
+
+	return ( ezd_gif_close( hGif ) && ok ) ? 1 : 0;
+}
+
+int ezd_fill( HEZDIMAGE x_hDib, int x_col )
+{
+	int w, h, sw, pw, x, y;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Check for user callback function
+	if ( p->pfSetPixel )
+	{
+		// Fill each pixel
+		for ( y = 0; y < h; y++ )
+			for( x = 0; x < w; x++ )
+				if ( !p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 ) )
+					return 0;
+
+		return 1;
+
+	} // end if
+
+	// Pixel and scan widths
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the first line
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			EZD_MEMSET( p->pImage, EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) ? 0xff : 0, sw );
+			break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+			unsigned char *pImg = p->pImage;
+
+			// Set the first line
+			for( x = 0; x < w; x++, pImg += pw )
+				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+
+		} break;
+
+		case 32 :
+		{
+			// Set the first line
+			int *pImg = (int*)p->pImage;
+			for( x = 0; x < w; x++, pImg++ )
+				*pImg = x_col;
+
+		} break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	// Copy remaining lines
+	for( y = 1; y < h; y++ )
+		EZD_MEMCPY( &p->pImage[ y * sw ], p->pImage, sw );
+
+	ezd_mark_dirty( p, 0, 0, w, h );
+
+	return 1;
+}
+
+int ezd_set_pixel( HEZDIMAGE x_hDib, int x, int y, int x_col )
+{
+	int w, h, sw, pw;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure pixel is within the image
+	if ( 0 > x || x >= w || 0 > y || y >= h )
+	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
+		return 0;
+	} // en dif
+
+	// Set the specified pixel
+	if ( p->pfSetPixel )
+		return p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 );
+
+	ezd_mark_dirty( p, x, y, x + 1, y + 1 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the first line
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			p->pImage[ y * sw + ( x >> 3 ) ] |= 0x80 >> ( x & 7 );
+			break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+			unsigned char *pImg = &p->pImage[ y * sw + x * pw ];
+
+			// Set the pixel color
+			pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+
+		} break;
+
+		case 32 :
+			*(unsigned int*)&p->pImage[ y * sw + x * pw ] = x_col;
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+int ezd_get_pixel( HEZDIMAGE x_hDib, int x, int y )
+{
+	int w, h, sw, pw;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure pixel is within the image
+	if ( 0 > x || x >= w || 0 > y || y >= h )
+	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
+		return 0;
+	} // en dif
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the first line
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			return p->colPalette[ ( p->pImage[ y * sw + ( x >> 3 ) ] & ( 0x80 >> ( x & 7 ) ) ) ? 1 : 0 ];
+
+		case 24 :
+		{
+			// Return the color of the specified pixel
+			unsigned char *pImg = &p->pImage[ y * sw + x * pw ];
+			return pImg[ 0 ] | ( pImg[ 1 ] << 8 ) | ( pImg[ 2 ] << 16 );
+
+		} break;
+
+		case 32 :
+			return *(unsigned int*)&p->pImage[ y * sw + x * pw ];
+
+	} // end switch
+
+	return 0;
+}
+
+/// Fills x1 to x2, exclusive, on row y, which must be inside the image
+static int ezd_fill_span( SImageData *p, int x1, int x2, int y, int x_col )
+{
+	int sw, pw;
+	unsigned char *pImg;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	if ( p->pfSetPixel )
+	{	for ( ; x1 < x2; x1++ )
+			if ( !p->pfSetPixel( p->pSetPixelUser, x1, y, x_col, 0 ) )
+				return 0;
+		return 1;
+	} // end if
+
+	ezd_mark_dirty( p, x1, y, x2, y + 1 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( p->bih.biWidth, p->bih.biBitCount, 4 );
+	pImg = &p->pImage[ y * sw ];
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			if ( EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) )
+				for ( ; x1 < x2; x1++ )
+					pImg[ x1 >> 3 ] |= xm[ x1 & 7 ];
+			else
+				for ( ; x1 < x2; x1++ )
+					pImg[ x1 >> 3 ] &= ~xm[ x1 & 7 ];
+			break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+
+			for ( pImg += x1 * pw; x1 < x2; x1++, pImg += pw )
+				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+
+		} break;
+
+		case 32 :
+		{	unsigned int *pPix = (unsigned int*)&pImg[ x1 * pw ];
+			for ( x2 -= x1; 0 < x2; x2-- )
+				*pPix++ = x_col;
+		} break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+/// Fills y1 to y2, exclusive, on column x, which must be inside the image
+static int ezd_fill_vspan( SImageData *p, int x, int y1, int y2, int x_col )
+{
+	int sw, pw;
+	unsigned char *pImg;
+
+	if ( p->pfSetPixel )
+	{	for ( ; y1 < y2; y1++ )
+			if ( !p->pfSetPixel( p->pSetPixelUser, x, y1, x_col, 0 ) )
+				return 0;
+		return 1;
+	} // end if
+
+	ezd_mark_dirty( p, x, y1, x + 1, y2 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( p->bih.biWidth, p->bih.biBitCount, 4 );
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+		{	unsigned char m = 0x80 >> ( x & 7 );
+			pImg = &p->pImage[ y1 * sw + ( x >> 3 ) ];
+			if ( EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) )
+				for ( ; y1 < y2; y1++, pImg += sw )
+					*pImg |= m;
+			else
+				for ( ; y1 < y2; y1++, pImg += sw )
+					*pImg &= ~m;
+		} break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+
+			for ( pImg = &p->pImage[ y1 * sw + x * pw ]; y1 < y2; y1++, pImg += sw )
+				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+
+		} break;
+
+		case 32 :
+			for ( pImg = &p->pImage[ y1 * sw + x * pw ]; y1 < y2; y1++, pImg += sw )
+				*(unsigned int*)pImg = x_col;
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+int ezd_set_pixels( HEZDIMAGE x_hDib, const int *pX, const int *pY, const int *pCol, int x_col, int n )
+{
+	int i, x, y, w, h, sw, pw, x1, y1, x2, y2;
+	unsigned char *pImg;
+	SImageData *p = (SImageData*)x_hDib;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pX || !pY || 0 > n )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	if ( p->pfSetPixel )
+	{	for ( i = 0; i < n; i++ )
+			if ( 0 <= pX[ i ] && pX[ i ] < w && 0 <= pY[ i ] && pY[ i ] < h )
+				if ( !p->pfSetPixel( p->pSetPixelUser, pX[ i ], pY[ i ], pCol ? pCol[ i ] : x_col, 0 ) )
+					return 0;
+		return 1;
+	} // end if
+
+	// One dirty rectangle around the points inside the image
+	for ( i = 0, x1 = w, y1 = h, x2 = 0, y2 = 0; i < n; i++ )
+		if ( 0 <= pX[ i ] && pX[ i ] < w && 0 <= pY[ i ] && pY[ i ] < h )
+		{	if ( pX[ i ] < x1 ) x1 = pX[ i ];
+			if ( pX[ i ] >= x2 ) x2 = pX[ i ] + 1;
+			if ( pY[ i ] < y1 ) y1 = pY[ i ];
+			if ( pY[ i ] >= y2 ) y2 = pY[ i ] + 1;
+		} // end if
+	ezd_mark_dirty( p, x1, y1, x2, y2 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+					continue;
+				if ( EZD_COMPARE_THRESHOLD( ( pCol ? pCol[ i ] : x_col ), p->colThreshold ) )
+					p->pImage[ y * sw + ( x >> 3 ) ] |= xm[ x & 7 ];
+				else
+					p->pImage[ y * sw + ( x >> 3 ) ] &= ~xm[ x & 7 ];
+			} // end for
+			break;
+
+		case 24 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+					continue;
+				if ( pCol )
+					x_col = pCol[ i ];
+				pImg = &p->pImage[ y * sw + x * pw ];
+				pImg[ 0 ] = x_col & 0xff, pImg[ 1 ] = ( x_col >> 8 ) & 0xff, pImg[ 2 ] = ( x_col >> 16 ) & 0xff;
+			} // end for
+			break;
+
+		case 32 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+					continue;
+				*(unsigned int*)&p->pImage[ y * sw + x * pw ] = pCol ? pCol[ i ] : x_col;
+			} // end for
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+int ezd_get_pixels( HEZDIMAGE x_hDib, const int *pX, const int *pY, int *pCol, int n )
+{
+	int i, x, y, w, h, sw, pw;
+	unsigned char *pImg;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage
+		 || !pX || !pY || !pCol || 0 > n )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+				{	pCol[ i ] = 0;
+					continue;
+				} // end if
+				pCol[ i ] = p->colPalette[ ( p->pImage[ y * sw + ( x >> 3 ) ] & ( 0x80 >> ( x & 7 ) ) ) ? 1 : 0 ];
+			} // end for
+			break;
+
+		case 24 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+				{	pCol[ i ] = 0;
+					continue;
+				} // end if
+				pImg = &p->pImage[ y * sw + x * pw ];
+				pCol[ i ] = pImg[ 0 ] | ( pImg[ 1 ] << 8 ) | ( pImg[ 2 ] << 16 );
+			} // end for
+			break;
+
+		case 32 :
+			for ( i = 0; i < n; i++ )
+			{	x = pX[ i ], y = pY[ i ];
+				if ( 0 > x || x >= w || 0 > y || y >= h )
+				{	pCol[ i ] = 0;
+					continue;
+				} // end if
+				pCol[ i ] = *(unsigned int*)&p->pImage[ y * sw + x * pw ];
+			} // end for
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+int ezd_get_row( HEZDIMAGE x_hDib, int x, int y, int n, int *pCol )
+{
+	int i, w, h, sw, pw;
+	unsigned char *pImg;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage || !pCol )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure the span is within the image
+	if ( 0 > x || 0 > n || x + n > w || 0 > y || y >= h )
+		return _ERR( 0, "Row out of range" );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	pImg = &p->pImage[ y * sw ];
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			for ( i = 0; i < n; i++, x++ )
+				pCol[ i ] = p->colPalette[ ( pImg[ x >> 3 ] & ( 0x80 >> ( x & 7 ) ) ) ? 1 : 0 ];
+			break;
+
+		case 24 :
+			for ( pImg += x * pw, i = 0; i < n; i++, pImg += pw )
+				pCol[ i ] = pImg[ 0 ] | ( pImg[ 1 ] << 8 ) | ( pImg[ 2 ] << 16 );
+			break;
+
+		case 32 :
+			EZD_MEMCPY( (char*)pCol, (const char*)&pImg[ x * pw ], n * pw );
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+int ezd_put_row( HEZDIMAGE x_hDib, int x, int y, int n, const int *pCol )
+{
+	int i, w, h, sw, pw;
+	unsigned char *pImg;
+	SImageData *p = (SImageData*)x_hDib;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pCol )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure the span is within the image
+	if ( 0 > x || 0 > n || x + n > w || 0 > y || y >= h )
+		return _ERR( 0, "Row out of range" );
+
+	if ( p->pfSetPixel )
+	{	for ( i = 0; i < n; i++ )
+			if ( !p->pfSetPixel( p->pSetPixelUser, x + i, y, pCol[ i ], 0 ) )
+				return 0;
+		return 1;
+	} // end if
+
+	ezd_mark_dirty( p, x, y, x + n, y + 1 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	pImg = &p->pImage[ y * sw ];
+
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+			for ( i = 0; i < n; i++, x++ )
+				if ( EZD_COMPARE_THRESHOLD( pCol[ i ], p->colThreshold ) )
+					pImg[ x >> 3 ] |= xm[ x & 7 ];
+				else
+					pImg[ x >> 3 ] &= ~xm[ x & 7 ];
+			break;
+
+		case 24 :
+			for ( pImg += x * pw, i = 0; i < n; i++, pImg += pw )
+				pImg[ 0 ] = pCol[ i ] & 0xff, pImg[ 1 ] = ( pCol[ i ] >> 8 ) & 0xff, pImg[ 2 ] = ( pCol[ i ] >> 16 ) & 0xff;
+			break;
+
+		case 32 :
+			EZD_MEMCPY( (char*)&pImg[ x * pw ], (const char*)pCol, n * pw );
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+/// Returns non zero if the dash pattern draws the next pixel, and moves on
+static int ezd_dash_step( SImageData *p )
+{
+	int on = ( p->uDash >> p->nDashPos ) & 1;
+	if ( ++p->nDashPos >= p->nDashLen )
+		p->nDashPos = 0;
+	return on;
+}
+
+/// Non zero if the next pixel of a line should be drawn
+#define EZD_DASH_ON( p ) ( !( p )->nDashLen || ezd_dash_step( p ) )
+
+/// Fills a run of dashed pixels, r0 and r1 are inclusive in either order
+static int ezd_dash_fill( SImageData *p, int r0, int r1, int c, int bVert, int x_col )
+{
+	if ( r0 > r1 )
+	{	int t = r0; r0 = r1; r1 = t; }
+
+	return bVert ? ezd_fill_vspan( p, c, r0, r1 + 1, x_col )
+				 : ezd_fill_span( p, r0, r1 + 1, c, x_col );
+}
+
+/// Draws pixels a to b, inclusive and in that order, along row or column c
+/// with the dash pattern, writing each dash as a span
+static int ezd_dash_span( SImageData *p, int a, int b, int c, int bVert, int x_col )
+{
+	int d = ( a <= b ) ? 1 : -1, n = ( b - a ) * d + 1, k = 0, r0 = 0, bRun = 0;
+	int lim = bVert ? EZD_ABS( p->bih.biHeight ) : EZD_ABS( p->bih.biWidth );
+
+	// Pixels before the image still use up the pattern
+	if ( 0 < d && 0 > a )
+		k = -a;
+	else if ( 0 > d && lim <= a )
+		k = a - lim + 1;
+	if ( k > n )
+		k = n;
+	p->nDashPos = ( p->nDashPos + k ) % p->nDashLen;
+
+	for ( a += k * d; k < n && 0 <= a && a < lim; k++, a += d )
+		if ( ezd_dash_step( p ) )
+		{	if ( !bRun )
+				r0 = a, bRun = 1;
+		} // end if
+
+		// End of a dash
+		else if ( bRun )
+		{	if ( !ezd_dash_fill( p, r0, a - d, c, bVert, x_col ) )
+				return 0;
+			bRun = 0;
+		} // end else if
+
+	if ( bRun && !ezd_dash_fill( p, r0, a - d, c, bVert, x_col ) )
+		return 0;
+
+	// So do pixels past it
+	p->nDashPos = ( p->nDashPos + n - k ) % p->nDashLen;
+
+	return 1;
+}
+
+/// Leave out the first pixel of a line
+#define EZD_SKIP_FIRST		1
+
+/// Leave out the last pixel of a line
+#define EZD_SKIP_LAST		2
+
+/// Draws a line on a valid image, nSkip is a combination of EZD_SKIP_* flags
+static int ezd_draw_line( SImageData *p, int x1, int y1, int x2, int y2, int x_col, int nSkip )
+{
+	int w, h, sw, pw, xd, yd, xl, yl, mx = 0, my = 0, done = 0;
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Nothing left to draw
+	if ( nSkip && x1 == x2 && y1 == y2 )
+		return 1;
+
+	// Entirely outside the image, the dash pattern still moves on
+	if ( ( 0 > x1 && 0 > x2 ) || ( w <= x1 && w <= x2 )
+		 || ( 0 > y1 && 0 > y2 ) || ( h <= y1 && h <= y2 ) )
+	{
+		if ( p->nDashLen )
+		{	xl = ( x1 < x2 ) ? ( x2 - x1 ) : ( x1 - x2 );
+			yl = ( y1 < y2 ) ? ( y2 - y1 ) : ( y1 - y2 );
+			xl = ( xl > yl ? xl : yl ) + 1
+				 - ( ( nSkip & EZD_SKIP_FIRST ) ? 1 : 0 ) - ( ( nSkip & EZD_SKIP_LAST ) ? 1 : 0 );
+			if ( 0 < xl )
+				p->nDashPos = ( p->nDashPos + xl ) % p->nDashLen;
+		} // end if
+
+		return 1;
+
+	} // end if
+
+	// Horizontal lines are a single span, callbacks still get the pixels in order
+	if ( y1 == y2 && !p->pfSetPixel )
+	{
+		xd = ( x1 < x2 ) ? 1 : -1;
+		if ( nSkip & EZD_SKIP_FIRST )
+			x1 += xd;
+		if ( nSkip & EZD_SKIP_LAST )
+			x2 -= xd;
+		if ( 0 > ( x2 - x1 ) * xd )
+			return 1;
+		if ( p->nDashLen )
+			return ezd_dash_span( p, x1, x2, y1, 0, x_col );
+		if ( x1 > x2 )
+			xd = x1, x1 = x2, x2 = xd;
+		if ( 0 > x1 )
+			x1 = 0;
+		if ( w <= x2 )
+			x2 = w - 1;
+		return ezd_fill_span( p, x1, x2 + 1, y1, x_col );
+
+	} // end if
+
+	// So are vertical lines
+	if ( x1 == x2 && !p->pfSetPixel )
+	{
+		yd = ( y1 < y2 ) ? 1 : -1;
+		if ( nSkip & EZD_SKIP_FIRST )
+			y1 += yd;
+		if ( nSkip & EZD_SKIP_LAST )
+			y2 -= yd;
+		if ( 0 > ( y2 - y1 ) * yd )
+			return 1;
+		if ( p->nDashLen )
+			return ezd_dash_span( p, y1, y2, x1, 1, x_col );
+		if ( y1 > y2 )
+			yd = y1, y1 = y2, y2 = yd;
+		if ( 0 > y1 )
+			y1 = 0;
+		if ( h <= y2 )
+			y2 = h - 1;
+		return ezd_fill_vspan( p, x1, y1, y2 + 1, x_col );
+
+	} // end if
+
+	// Determine direction and distance
+	xd = ( x1 < x2 ) ? 1 : -1;
+	yd = ( y1 < y2 ) ? 1 : -1;
+	xl = ( x1 < x2 ) ? ( x2 - x1 ) : ( x1 - x2 );
+	yl = ( y1 < y2 ) ? ( y2 - y1 ) : ( y1 - y2 );
+
+	// Diagonals would stay on the first pixel for one step
+	if ( xl == yl )
+		mx = xl, my = yl;
+
+	// Step off the pixel shared with the previous segment
+	if ( nSkip & EZD_SKIP_FIRST )
+	{	int sx = x1, sy = y1;
+		while ( x1 == sx && y1 == sy )
+		{
+			mx += xl;
+			if ( x1 != x2 && mx > yl )
+				x1 += xd, mx -= yl;
+
+			my += yl;
+			if ( y1 != y2 && my > xl )
+				y1 += yd, my -= xl;
+
+		} // end while
+	} // end if
+
+	// Check for user callback function
+	if ( p->pfSetPixel )
+	{
+		// Draw the line
+		while ( !done )
+		{
+			if ( x1 == x2 && y1 == y2 )
+			{	if ( nSkip & EZD_SKIP_LAST )
+					break;
+				done = 1;
+			} // end if
+
+			// Plot pixel
+			if ( EZD_DASH_ON( p ) && 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
+				if ( !p->pfSetPixel( p->pSetPixelUser, x1, y1, x_col, 0 ) )
+					return 0;
+
+			mx += xl;
+			if ( x1 != x2 && mx > yl )
+				x1 += xd, mx -= yl;
+
+			my += yl;
+			if ( y1 != y2 && my > xl )
+				y1 += yd, my -= xl;
+
+		} // end while
+
+		return 1;
+
+	} // end if
+
+	ezd_mark_dirty( p, ( x1 < x2 ) ? x1 : x2, ( y1 < y2 ) ? y1 : y2,
+					( x1 < x2 ) ? x2 + 1 : x1 + 1, ( y1 < y2 ) ? y2 + 1 : y1 + 1 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the first line
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+		{
+			int c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
+			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+			// Draw the line
+			while ( !done )
+			{
+				if ( x1 == x2 && y1 == y2 )
+				{	if ( nSkip & EZD_SKIP_LAST )
+						break;
+					done = 1;
+				} // end if
+
+				// Plot pixel
+				if ( EZD_DASH_ON( p ) && 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
+				{
+					if ( c )
+						p->pImage[ y1 * sw + ( x1 >> 3 ) ] |= xm[ x1 & 7 ];
+					else
+						p->pImage[ y1 * sw + ( x1 >> 3 ) ] &= ~xm[ x1 & 7 ];
+
+				} // end if
+
+				mx += xl;
+				if ( x1 != x2 && mx > yl )
+					x1 += xd, mx -= yl;
+
+				my += yl;
+				if ( y1 != y2 && my > xl )
+					y1 += yd, my -= xl;
+
+			} // end while
+
+		} break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+			unsigned char *pImg;
+
+			while ( !done )
+			{
+				if ( x1 == x2 && y1 == y2 )
+				{	if ( nSkip & EZD_SKIP_LAST )
+						break;
+					done = 1;
+				} // end if
+
+				// Plot pixel
+				if ( EZD_DASH_ON( p ) && 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
+				{	pImg = &p->pImage[ y1 * sw + x1 * pw ];
+					pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+				} // end if
+
+				mx += xl;
+				if ( x1 != x2 && mx > yl )
+					x1 += xd, mx -= yl;
+
+				my += yl;
+				if ( y1 != y2 && my > xl )
+					y1 += yd, my -= xl;
+
+			} // end while
+
+		} break;
+
+		case 32 :
+		{
+			// Draw the line
+			while ( !done )
+			{
+				if ( x1 == x2 && y1 == y2 )
+				{	if ( nSkip & EZD_SKIP_LAST )
+						break;
+					done = 1;
+				} // end if
+
+				// Plot pixel
+				if ( EZD_DASH_ON( p ) && 0 <= x1 && x1 < w && 0 <= y1 && y1 < h )
+					*(unsigned int*)&p->pImage[ y1 * sw + x1 * pw ] = x_col;
+
+				mx += xl;
+				if ( x1 != x2 && mx > yl )
+					x1 += xd, mx -= yl;
+
+				my += yl;
+				if ( y1 != y2 && my > xl )
+					y1 += yd, my -= xl;
+
+			} // end while
+
+		} break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+}
+
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Convex piece of a wide line, a polygon or a circle
+typedef struct _SPenShape
+{
+	/// Number of points, zero for a circle
+	int						n;
+
+	/// Points, or the center and radius of a circle
+	double					x[ 4 ], y[ 4 ];
+
+	/// Rows covered, y2 is exclusive
+	int						y1, y2;
+
+} SPenShape;
+
+static double ezd_sqrt( double v )
+{
+#if !defined( EZD_NO_MATH )
+	return sqrt( v );
+#else
+	int i;
+	double r = ( 1 < v ) ? v : 1;
+
+	if ( 0 >= v )
+		return 0;
+
+	for ( i = 0; i < 32; i++ )
+		r = ( r + v / r ) / 2;
+
+	return r;
+#endif
+}
+
+/// Smallest integer not less than v
+static int ezd_ceil( double v )
+{
+	int i = (int)v;
+	return ( (double)i < v ) ? i + 1 : i;
+}
+
+static SPenShape* ezd_pen_poly( SPenShape *s, int n, const double *x, const double *y )
+{
+	int i;
+	double y1 = y[ 0 ], y2 = y[ 0 ];
+
+	s->n = n;
+	for ( i = 0; i < n; i++ )
+	{	s->x[ i ] = x[ i ], s->y[ i ] = y[ i ];
+		if ( y[ i ] < y1 )
+			y1 = y[ i ];
+		else if ( y[ i ] > y2 )
+			y2 = y[ i ];
+	} // end for
+
+	s->y1 = ezd_ceil( y1 );
+	s->y2 = ezd_ceil( y2 );
+
+	return s + 1;
+}
+
+static SPenShape* ezd_pen_circle( SPenShape *s, double x, double y, double r )
+{
+	s->n = 0;
+	s->x[ 0 ] = x, s->y[ 0 ] = y, s->x[ 1 ] = r;
+	s->y1 = ezd_ceil( y - r );
+	s->y2 = ezd_ceil( y + r );
+
+	return s + 1;
+}
+
+/// Gets the columns covered by a shape on row y, x2 is exclusive
+static int ezd_pen_span( const SPenShape *s, int y, int *x1, int *x2 )
+{
+	int i, j;
+	double a, b, t;
+
+	if ( !s->n )
+	{	t = s->x[ 1 ] * s->x[ 1 ] - ( y - s->y[ 0 ] ) * ( y - s->y[ 0 ] );
+		if ( 0 > t )
+			return 0;
+		t = ezd_sqrt( t );
+		a = s->x[ 0 ] - t, b = s->x[ 0 ] + t;
+	} // end if
+
+	else
+	{
+		a = 0, b = -1;
+		for ( i = 0, j = s->n - 1; i < s->n; j = i++ )
+		{
+			// Does this edge cross the row?
+			if ( ( s->y[ i ] > y && s->y[ j ] > y ) || ( s->y[ i ] < y && s->y[ j ] < y ) )
+				continue;
+
+			t = ( s->y[ i ] == s->y[ j ] )
+				? s->x[ i ]
+				: s->x[ i ] + ( y - s->y[ i ] ) * ( s->x[ j ] - s->x[ i ] ) / ( s->y[ j ] - s->y[ i ] );
+
+			if ( a > b )
+				a = b = t;
+			else if ( t < a )
+				a = t;
+			else if ( t > b )
+				b = t;
+
+			// Both ends of a flat edge
+			if ( s->y[ i ] == s->y[ j ] )
+			{	if ( s->x[ j ] < a )
+					a = s->x[ j ];
+				else if ( s->x[ j ] > b )
+					b = s->x[ j ];
+			} // end if
+
+		} // end for
+
+		if ( a > b )
+			return 0;
+
+	} // end else
+
+	*x1 = ezd_ceil( a );
+	*x2 = ezd_ceil( b );
+
+	return *x1 < *x2;
+}
+
+/// Fills the union of the shapes, each pixel is written once
+static int ezd_pen_fill( SImageData *p, const SPenShape *s, int n, int x_col )
+{
+	int i, j, k, g, t, w, h, y, y1, y2, x1, x2, na = 0, ns, ok = 1;
+	int *pOrder, *pActive, *pSpan;
+
+	if ( 0 >= n )
+		return 1;
+
+	pOrder = (int*)EZD_malloc( n * 4 * sizeof( int ) );
+	if ( !pOrder )
+		return _ERR( 0, "Out of memory" );
+	pActive = &pOrder[ n ];
+	pSpan = &pOrder[ n * 2 ];
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Shell sort the shapes by their first row
+	for ( i = 0; i < n; i++ )
+		pOrder[ i ] = i;
+	for ( g = n >> 1; 0 < g; g >>= 1 )
+		for ( i = g; i < n; i++ )
+			for ( j = i - g; 0 <= j && s[ pOrder[ j ] ].y1 > s[ pOrder[ j + g ] ].y1; j -= g )
+				t = pOrder[ j ], pOrder[ j ] = pOrder[ j + g ], pOrder[ j + g ] = t;
+
+	// Rows to draw
+	y1 = s[ pOrder[ 0 ] ].y1, y2 = y1;
+	for ( i = 0; i < n; i++ )
+		if ( s[ i ].y2 > y2 )
+			y2 = s[ i ].y2;
+	if ( 0 > y1 )
+		y1 = 0;
+	if ( h < y2 )
+		y2 = h;
+
+	for ( y = y1, k = 0; ok && y < y2; y++ )
+	{
+		// Add shapes starting on this row
+		for ( ; k < n && s[ pOrder[ k ] ].y1 <= y; k++ )
+			pActive[ na++ ] = pOrder[ k ];
+
+		// Collect the spans, dropping finished shapes
+		for ( i = 0, ns = 0; i < na; )
+		{
+			if ( s[ pActive[ i ] ].y2 <= y )
+			{	pActive[ i ] = pActive[ --na ];
+				continue;
+			} // end if
+
+			if ( ezd_pen_span( &s[ pActive[ i ] ], y, &x1, &x2 ) )
+				pSpan[ ns * 2 ] = x1, pSpan[ ns * 2 + 1 ] = x2, ns++;
+
+			i++;
+
+		} // end for
+
+		// Sort the spans
+		for ( g = ns >> 1; 0 < g; g >>= 1 )
+			for ( i = g; i < ns; i++ )
+				for ( j = i - g; 0 <= j && pSpan[ j * 2 ] > pSpan[ ( j + g ) * 2 ]; j -= g )
+					t = pSpan[ j * 2 ], pSpan[ j * 2 ] = pSpan[ ( j + g ) * 2 ], pSpan[ ( j + g ) * 2 ] = t,
+					t = pSpan[ j * 2 + 1 ], pSpan[ j * 2 + 1 ] = pSpan[ ( j + g ) * 2 + 1 ], pSpan[ ( j + g ) * 2 + 1 ] = t;
+
+		// Merge overlapping spans and draw them
+		for ( i = 0; ok && i < ns; i = j )
+		{
+			x1 = pSpan[ i * 2 ], x2 = pSpan[ i * 2 + 1 ];
+			for ( j = i + 1; j < ns && pSpan[ j * 2 ] <= x2; j++ )
+				if ( pSpan[ j * 2 + 1 ] > x2 )
+					x2 = pSpan[ j * 2 + 1 ];
+
+			if ( 0 > x1 )
+				x1 = 0;
+			if ( w < x2 )
+				x2 = w;
+			if ( x1 < x2 )
+				ok = ezd_fill_span( p, x1, x2, y, x_col );
+
+		} // end for
+
+	} // end for
+
+	EZD_free( pOrder );
+
+	return ok;
+}
+
+/// Adds the join between two segments meeting at x, y
+static SPenShape* ezd_pen_join( SPenShape *s, int nJoin, double x, double y, double hw,
+								double dx1, double dy1, double dx2, double dy2 )
+{
+	double c, d, px[ 4 ], py[ 4 ];
+
+	// Turning toward the normal puts the outside on the other side
+	d = dx1 * dy2 - dy1 * dx2;
+	if ( 0 < d )
+		hw = -hw;
+
+	// Straight on, nothing to fill
+	if ( ( 0 <= d ? d : -d ) < 1e-9 && 0 < dx1 * dx2 + dy1 * dy2 )
+		return s;
+
+	if ( EZD_JOIN_ROUND == nJoin )
+		return ezd_pen_circle( s, x, y, 0 > hw ? -hw : hw );
+
+	// Outside corners of the two segments
+	px[ 0 ] = x, py[ 0 ] = y;
+	px[ 1 ] = x - dy1 * hw, py[ 1 ] = y + dx1 * hw;
+	px[ 3 ] = x - dy2 * hw, py[ 3 ] = y + dx2 * hw;
+
+	// Miter point, unless it is too far out
+	c = dx1 * dx2 + dy1 * dy2;
+	if ( EZD_JOIN_MITER == nJoin && 1 + c >= (double)1 / 8 )
+	{	px[ 2 ] = x + ( -dy1 - dy2 ) * hw / ( 1 + c );
+		py[ 2 ] = y + ( dx1 + dx2 ) * hw / ( 1 + c );
+		return ezd_pen_poly( s, 4, px, py );
+	} // end if
+
+	px[ 2 ] = px[ 3 ], py[ 2 ] = py[ 3 ];
+	return ezd_pen_poly( s, 3, px, py );
+}
+
+/// Draws a wide line through the points with the pen of the image
+static int ezd_draw_wide( SImageData *p, const double *pX, const double *pY, int n, int bClose, int x_col )
+{
+	int i, j, m, ok, nCap, nJoin;
+	double hw, len, dx, dy, ex1, ey1, ex2, ey2, px[ 4 ], py[ 4 ];
+	double *vx, *vy, *dir;
+	SPenShape *s, *e;
+
+	if ( 0 >= n )
+		return 1;
+
+	hw = (double)p->nPenWidth / 2;
+	nCap = p->nPenStyle & EZD_CAP_MASK;
+	nJoin = p->nPenStyle & EZD_JOIN_MASK;
+
+	// Points, segment directions, and up to two shapes per point plus caps
+	vx = (double*)EZD_malloc( n * 4 * sizeof( double ) + ( n * 2 + 2 ) * sizeof( SPenShape ) );
+	if ( !vx )
+		return _ERR( 0, "Out of memory" );
+	vy = &vx[ n ];
+	dir = &vx[ n * 2 ];
+	s = e = (SPenShape*)&vx[ n * 4 ];
+
+	// Drop repeated points
+	for ( i = 0, m = 0; i < n; i++ )
+		if ( !m || pX[ i ] != vx[ m - 1 ] || pY[ i ] != vy[ m - 1 ] )
+			vx[ m ] = pX[ i ], vy[ m++ ] = pY[ i ];
+	if ( bClose && 2 < m && vx[ 0 ] == vx[ m - 1 ] && vy[ 0 ] == vy[ m - 1 ] )
+		m--;
+	if ( 3 > m )
+		bClose = 0;
+
+	// A single point is a dot the size of the pen
+	if ( 1 == m )
+	{
+		if ( EZD_CAP_ROUND == nCap )
+			e = ezd_pen_circle( e, vx[ 0 ], vy[ 0 ], hw );
+		else
+		{	px[ 0 ] = px[ 3 ] = vx[ 0 ] - hw, px[ 1 ] = px[ 2 ] = vx[ 0 ] + hw;
+			py[ 0 ] = py[ 1 ] = vy[ 0 ] - hw, py[ 2 ] = py[ 3 ] = vy[ 0 ] + hw;
+			e = ezd_pen_poly( e, 4, px, py );
+		} // end else
+
+	} // end if
+
+	// Segments
+	for ( i = 0; i < m - 1 + bClose; i++ )
+	{
+		j = ( i + 1 ) % m;
+		dx = vx[ j ] - vx[ i ], dy = vy[ j ] - vy[ i ];
+		len = ezd_sqrt( dx * dx + dy * dy );
+		dx /= len, dy /= len;
+		dir[ i * 2 ] = dx, dir[ i * 2 + 1 ] = dy;
+
+		// Square caps extend the open ends
+		ex1 = ey1 = ex2 = ey2 = 0;
+		if ( EZD_CAP_SQUARE == nCap && !bClose && !i )
+			ex1 = dx * hw, ey1 = dy * hw;
+		if ( EZD_CAP_SQUARE == nCap && !bClose && i == m - 2 )
+			ex2 = dx * hw, ey2 = dy * hw;
+
+		px[ 0 ] = vx[ i ] - ex1 - dy * hw, py[ 0 ] = vy[ i ] - ey1 + dx * hw;
+		px[ 1 ] = vx[ j ] + ex2 - dy * hw, py[ 1 ] = vy[ j ] + ey2 + dx * hw;
+		px[ 2 ] = vx[ j ] + ex2 + dy * hw, py[ 2 ] = vy[ j ] + ey2 - dx * hw;
+		px[ 3 ] = vx[ i ] - ex1 + dy * hw, py[ 3 ] = vy[ i ] - ey1 - dx * hw;
+		e = ezd_pen_poly( e, 4, px, py );
+
+	} // end for
+
+	// Joins
+	for ( i = bClose ? 0 : 1; i < m - 1 + bClose; i++ )
+	{	j = ( i + m - 1 ) % m;
+		e = ezd_pen_join( e, nJoin, vx[ i ], vy[ i ], hw,
+						  dir[ j * 2 ], dir[ j * 2 + 1 ], dir[ i * 2 ], dir[ i * 2 + 1 ] );
+	} // end for
+
+	// Round caps
+	if ( 1 < m && !bClose && EZD_CAP_ROUND == nCap )
+	{	e = ezd_pen_circle( e, vx[ 0 ], vy[ 0 ], hw );
+		e = ezd_pen_circle( e, vx[ m - 1 ], vy[ m - 1 ], hw );
+	} // end if
+
+	ok = ezd_pen_fill( p, s, (int)( e - s ), x_col );
+
+	EZD_free( vx );
+
+	return ok;
+}
+
+/// Draws a wide line through integer points
+static int ezd_draw_wide_int( SImageData *p, const int *pX, const int *pY, int n, int bClose, int x_col )
+{
+	int i, ok;
+	double *pD;
+
+	if ( 0 >= n )
+		return 1;
+
+	pD = (double*)EZD_malloc( n * 2 * sizeof( double ) );
+	if ( !pD )
+		return _ERR( 0, "Out of memory" );
+
+	for ( i = 0; i < n; i++ )
+		pD[ i ] = pX[ i ], pD[ n + i ] = pY[ i ];
+
+	ok = ezd_draw_wide( p, pD, &pD[ n ], n, bClose, x_col );
+
+	EZD_free( pD );
+
+	return ok;
+}
+
+#endif
+
+int ezd_line( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
+{
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Start the dash pattern
+	p->nDashPos = 0;
+
+#if !defined( EZD_NO_ALLOCATION )
+	if ( 1 < p->nPenWidth )
+	{	int x[ 2 ], y[ 2 ];
+		x[ 0 ] = x1, y[ 0 ] = y1, x[ 1 ] = x2, y[ 1 ] = y2;
+		return ezd_draw_wide_int( p, x, y, 2, 0, x_col );
+	} // end if
+#endif
+
+	return ezd_draw_line( p, x1, y1, x2, y2, x_col, 0 );
+}
+
+/// Draws connected segments, drawing each shared pixel once, bContinue
+/// leaves out the first point, which an earlier call already drew
+static int ezd_draw_path( SImageData *p, const int *pX, const int *pY, int n, int bClose, int bContinue, int x_col )
+{
+	int i, lx, ly, nSkip = bContinue ? EZD_SKIP_FIRST : 0;
+
+	if ( 0 >= n )
+		return 1;
+
+#if !defined( EZD_NO_ALLOCATION )
+	if ( 1 < p->nPenWidth )
+		return ezd_draw_wide_int( p, pX, pY, n, bClose, x_col );
+#endif
+
+	lx = pX[ 0 ], ly = pY[ 0 ];
+
+	// A closed path ends on the first vertex
+	for ( i = 1; i < n || ( bClose && i == n ); i++ )
+	{
+		int x = pX[ i % n ], y = pY[ i % n ];
+
+		// Skip repeated vertices
+		if ( x == lx && y == ly )
+			continue;
+
+		// The first vertex was already drawn by the first segment
+		if ( !ezd_draw_line( p, lx, ly, x, y, x_col,
+							 nSkip | ( ( nSkip && bClose && x == pX[ 0 ] && y == pY[ 0 ] ) ? EZD_SKIP_LAST : 0 ) ) )
+			return 0;
+
+		lx = x, ly = y, nSkip = EZD_SKIP_FIRST;
+
+	} // end for
+
+	// All vertices are the same point
+	if ( !nSkip )
+		return ezd_draw_line( p, lx, ly, lx, ly, x_col, 0 );
+
+	return 1;
+}
+
+int ezd_polyline( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col )
+{
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pX || !pY || 0 > n )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Start the dash pattern
+	p->nDashPos = 0;
+
+	return ezd_draw_path( p, pX, pY, n, 0, 0, x_col );
+}
+
+int ezd_polygon( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col )
+{
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pX || !pY || 0 > n )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Start the dash pattern
+	p->nDashPos = 0;
+
+	return ezd_draw_path( p, pX, pY, n, 1, 0, x_col );
+}
+
+/// Points buffered by the curve functions before drawing
+#define EZD_CURVE_POINTS	256
+
+/// Most times a curve segment is split in half
+#define EZD_CURVE_DEPTH		10
+
+/// Curve flatness tolerance, half a pixel in 24.8 fixed point
+#define EZD_CURVE_FLAT		128
+
+/// Collects the points of a flattened curve
+typedef struct _SCurveSink
+{
+	/// Image and color
+	SImageData				*p;
+	int						x_col;
+
+	/// Point buffer, zero when only counting points
+	int						*pX, *pY;
+
+	/// Number of points and buffer size
+	int						nPoints, nMax;
+
+	/// Non zero once part of the curve has been drawn
+	int						bDrawn;
+
+	/// Cleared on error
+	int						ok;
+
+} SCurveSink;
+
+/// Adds a point in 24.8 fixed point
+static void ezd_curve_point( SCurveSink *c, int x, int y )
+{
+	if ( !c->ok )
+		return;
+
+	if ( c->pX )
+	{
+		// Buffer full, draw it and carry on from the last point
+		if ( c->nPoints >= c->nMax )
+		{	c->ok = ezd_draw_path( c->p, c->pX, c->pY, c->nPoints, 0, c->bDrawn, c->x_col );
+			c->pX[ 0 ] = c->pX[ c->nPoints - 1 ], c->pY[ 0 ] = c->pY[ c->nPoints - 1 ];
+			c->nPoints = 1, c->bDrawn = 1;
+		} // end if
+
+		c->pX[ c->nPoints ] = ( x + 128 ) >> 8;
+		c->pY[ c->nPoints ] = ( y + 128 ) >> 8;
+
+	} // end if
+
+	c->nPoints++;
+}
+
+/// Flattens a cubic Bezier in 24.8 fixed point, adding all but the first point
+static void ezd_curve_cubic( SCurveSink *c, int x0, int y0, int x1, int y1,
+							 int x2, int y2, int x3, int y3, int nDepth )
+{
+	long long ux, uy, vx, vy;
+	int ax, ay, bx, by, cx, cy, dx, dy, ex, ey, mx, my;
+
+	// How far the control points are from the chord
+	ux = 3 * (long long)x1 - 2 * (long long)x0 - x3; ux *= ux;
+	uy = 3 * (long long)y1 - 2 * (long long)y0 - y3; uy *= uy;
+	vx = 3 * (long long)x2 - x0 - 2 * (long long)x3; vx *= vx;
+	vy = 3 * (long long)y2 - y0 - 2 * (long long)y3; vy *= vy;
+
+	if ( EZD_CURVE_DEPTH <= nDepth
+		 || ( ux > vx ? ux : vx ) + ( uy > vy ? uy : vy )
+			<= 16 * (long long)EZD_CURVE_FLAT * EZD_CURVE_FLAT )
+	{	ezd_curve_point( c, x3, y3 );
+		return;
+	} // end if
+
+	// Split in half
+	ax = ( x0 + x1 ) / 2, ay = ( y0 + y1 ) / 2;
+	bx = ( x1 + x2 ) / 2, by = ( y1 + y2 ) / 2;
+	cx = ( x2 + x3 ) / 2, cy = ( y2 + y3 ) / 2;
+	dx = ( ax + bx ) / 2, dy = ( ay + by ) / 2;
+	ex = ( bx + cx ) / 2, ey = ( by + cy ) / 2;
+	mx = ( dx + ex ) / 2, my = ( dy + ey ) / 2;
+
+	ezd_curve_cubic( c, x0, y0, ax, ay, dx, dy, mx, my, nDepth + 1 );
+	ezd_curve_cubic( c, mx, my, ex, ey, cx, cy, x3, y3, nDepth + 1 );
+}
+
+/// Curve types for ezd_draw_curve()
+#define EZD_CURVE_QUAD		0
+#define EZD_CURVE_CUBIC		1
+#define EZD_CURVE_SPLINE	2
+
+/// Adds the points of a curve to the sink
+static void ezd_curve_emit( SCurveSink *c, const int *pX, const int *pY, int n, int nType )
+{
+	int i, a, b, d;
+
+	ezd_curve_point( c, pX[ 0 ] * 256, pY[ 0 ] * 256 );
+
+	switch( nType )
+	{
+		// Same curve as a cubic with control points two thirds of the way
+		case EZD_CURVE_QUAD :
+			ezd_curve_cubic( c, pX[ 0 ] * 256, pY[ 0 ] * 256,
+							 ( pX[ 0 ] * 256 ) + ( ( pX[ 1 ] - pX[ 0 ] ) * 512 ) / 3,
+							 ( pY[ 0 ] * 256 ) + ( ( pY[ 1 ] - pY[ 0 ] ) * 512 ) / 3,
+							 ( pX[ 2 ] * 256 ) + ( ( pX[ 1 ] - pX[ 2 ] ) * 512 ) / 3,
+							 ( pY[ 2 ] * 256 ) + ( ( pY[ 1 ] - pY[ 2 ] ) * 512 ) / 3,
+							 pX[ 2 ] * 256, pY[ 2 ] * 256, 0 );
+			break;
+
+		case EZD_CURVE_CUBIC :
+			ezd_curve_cubic( c, pX[ 0 ] * 256, pY[ 0 ] * 256, pX[ 1 ] * 256, pY[ 1 ] * 256,
+							 pX[ 2 ] * 256, pY[ 2 ] * 256, pX[ 3 ] * 256, pY[ 3 ] * 256, 0 );
+			break;
+
+		// Catmull-Rom, the end points are repeated
+		case EZD_CURVE_SPLINE :
+			for ( i = 0; i < n - 1; i++ )
+			{	a = i ? i - 1 : 0, b = i + 1, d = ( i + 2 < n ) ? i + 2 : n - 1;
+				ezd_curve_cubic( c, pX[ i ] * 256, pY[ i ] * 256,
+								 ( pX[ i ] * 256 ) + ( ( pX[ b ] - pX[ a ] ) * 256 ) / 6,
+								 ( pY[ i ] * 256 ) + ( ( pY[ b ] - pY[ a ] ) * 256 ) / 6,
+								 ( pX[ b ] * 256 ) - ( ( pX[ d ] - pX[ i ] ) * 256 ) / 6,
+								 ( pY[ b ] * 256 ) - ( ( pY[ d ] - pY[ i ] ) * 256 ) / 6,
+								 pX[ b ] * 256, pY[ b ] * 256, 0 );
+			} // end for
+			break;
+
+	} // end switch
+}
+
+/// Flattens a curve into a polyline and draws it
+static int ezd_draw_curve( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int nType, int x_col )
+{
+	int buf[ EZD_CURVE_POINTS * 2 ];
+	SCurveSink c;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pX || !pY || 0 >= n )
+		return _ERR( 0, "Invalid parameters" );
+
+	c.p = p, c.x_col = x_col, c.nPoints = 0, c.bDrawn = 0, c.ok = 1;
+	p->nDashPos = 0;
+
+#if !defined( EZD_NO_ALLOCATION )
+
+	// Wide lines need all the points at once for the joins
+	if ( 1 < p->nPenWidth )
+	{
+		// Count the points first
+		c.pX = c.pY = 0;
+		ezd_curve_emit( &c, pX, pY, n, nType );
+
+		c.nMax = c.nPoints, c.nPoints = 0;
+		c.pX = (int*)EZD_malloc( c.nMax * 2 * sizeof( int ) );
+		if ( !c.pX )
+			return _ERR( 0, "Out of memory" );
+		c.pY = &c.pX[ c.nMax ];
+
+		ezd_curve_emit( &c, pX, pY, n, nType );
+		c.ok = ezd_draw_wide_int( p, c.pX, c.pY, c.nPoints, 0, x_col );
+
+		EZD_free( c.pX );
+
+		return c.ok;
+
+	} // end if
+
+#endif
+
+	c.pX = buf, c.pY = &buf[ EZD_CURVE_POINTS ], c.nMax = EZD_CURVE_POINTS;
+	ezd_curve_emit( &c, pX, pY, n, nType );
+
+	if ( c.ok )
+		c.ok = ezd_draw_path( p, c.pX, c.pY, c.nPoints, 0, c.bDrawn, x_col );
+
+	return c.ok;
+}
+
+int ezd_quad_bezier( HEZDIMAGE x_hDib, int x1, int y1, int cx, int cy, int x2, int y2, int x_col )
+{
+	int x[ 3 ], y[ 3 ];
+
+	x[ 0 ] = x1, y[ 0 ] = y1;
+	x[ 1 ] = cx, y[ 1 ] = cy;
+	x[ 2 ] = x2, y[ 2 ] = y2;
+
+	return ezd_draw_curve( x_hDib, x, y, 3, EZD_CURVE_QUAD, x_col );
+}
+
+int ezd_cubic_bezier( HEZDIMAGE x_hDib, int x1, int y1, int cx1, int cy1,
+					  int cx2, int cy2, int x2, int y2, int x_col )
+{
+	int x[ 4 ], y[ 4 ];
+
+	x[ 0 ] = x1, y[ 0 ] = y1;
+	x[ 1 ] = cx1, y[ 1 ] = cy1;
+	x[ 2 ] = cx2, y[ 2 ] = cy2;
+	x[ 3 ] = x2, y[ 3 ] = y2;
+
+	return ezd_draw_curve( x_hDib, x, y, 4, EZD_CURVE_CUBIC, x_col );
+}
+
+int ezd_spline( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col )
+{
+	return ezd_draw_curve( x_hDib, pX, pY, n, EZD_CURVE_SPLINE, x_col );
+}
+
+int ezd_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
+{
+	int x[ 4 ], y[ 4 ];
+
+	// Draw rectangle, each corner once
+	x[ 0 ] = x1, y[ 0 ] = y1;
+	x[ 1 ] = x2, y[ 1 ] = y1;
+	x[ 2 ] = x2, y[ 2 ] = y2;
+	x[ 3 ] = x1, y[ 3 ] = y2;
+
+	return ezd_polygon( x_hDib, x, y, 4, x_col );
+}
+
+#define EZD_PI		( (double)3.141592654 )
+#define EZD_PI2		( EZD_PI * (double)2 )
+#define EZD_PI4		( EZD_PI * (double)4 )
+
+int ezd_arc( HEZDIMAGE x_hDib, int x, int y, int x_rad, double x_dStart, double x_dEnd, int x_col )
+{
+#if defined( EZD_NO_MATH )
+	return 0;
+#else
+	double arc;
+	int i, w, h, sw, pw, px, py;
+	int res = (int)( (double)x_rad * EZD_PI4 ), resdraw;
+	unsigned char *pImg;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Dont' draw null arc
+	if ( x_dStart == x_dEnd )
+		return 1;
+
+	// Ensure correct order
+	else if ( x_dStart > x_dEnd )
+	{	double t = x_dStart;
+		x_dStart = x_dEnd;
+		x_dEnd = t;
+	} // end if
+
+	// Get arc size
+	arc = x_dEnd - x_dStart;
+
+	// How many points to draw
+	resdraw = ( EZD_PI2 <= arc ) ? res : (int)( arc * (double)res / EZD_PI2 );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure pixel is within the image
+	if ( 0 > x || x >= w || 0 > y || y >= h )
+	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
+		return 0;
+	} // en dif
+
+	// Start the dash pattern
+	p->nDashPos = 0;
+
+#if !defined( EZD_NO_ALLOCATION )
+	// Wide arcs are drawn as a line through points every couple of pixels
+	if ( 1 < p->nPenWidth )
+	{
+		int n, ok, bClose = EZD_PI2 <= arc;
+		double *pD;
+
+		if ( bClose )
+			arc = EZD_PI2;
+
+		n = (int)( arc * (double)x_rad / 2 ) + 4;
+		pD = (double*)EZD_malloc( ( n + 1 ) * 2 * sizeof( double ) );
+		if ( !pD )
+			return _ERR( 0, "Out of memory" );
+
+		for ( i = 0; i <= n; i++ )
+			pD[ i ] = (double)x + (double)x_rad * cos( x_dStart + arc * (double)i / (double)n ),
+			pD[ n + 1 + i ] = (double)y + (double)x_rad * sin( x_dStart + arc * (double)i / (double)n );
+
+		// The last point of a circle is the first
+		ok = ezd_draw_wide( p, pD, &pD[ n + 1 ], bClose ? n : n + 1, bClose, x_col );
+
+		EZD_free( pD );
+
+		return ok;
+
+	} // end if
+#endif
+
+	// Check for user callback function
+	if ( p->pfSetPixel )
+	{
+		// Draw the circle
+		for ( i = 0; i < resdraw; i++ )
+		{
+			// Offset for this pixel
+			px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+			py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+
+			// Plot pixel
+			if ( EZD_DASH_ON( p ) && 0 <= px && px < w && 0 <= py && py < h )
+				if ( !p->pfSetPixel( p->pSetPixelUser, px, py, x_col, 0 ) )
+					return 0;
+
+		} // end while
+
+		return 1;
+
+	} // end if
+
+	ezd_mark_dirty( p, x - x_rad, y - x_rad, x + x_rad + 1, y + x_rad + 1 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	switch( p->bih.biBitCount )
+	{
+		case 1:
+		{
+			int c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
+			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+			// Draw the circle
+			for ( i = 0; i < resdraw; i++ )
+			{
+				// Offset for this pixel
+				px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+				py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+
+				// Plot pixel
+				if ( EZD_DASH_ON( p ) && 0 <= px && px < w && 0 <= py && py < h )
+				{
+					if ( c )
+						p->pImage[ py * sw + ( px >> 3 ) ] |= xm[ px & 7 ];
+					else
+						p->pImage[ py * sw + ( px >> 3 ) ] &= ~xm[ px & 7 ];
+
+				} // end if
+
+			} // end while
+
+		} break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+			for ( i = 0; i < resdraw; i++ )
+			{
+				// Offset for this pixel
+				px = x + (int)( (double)x_rad * cos( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+				py = y + (int)( (double)x_rad * sin( x_dStart + (double)i * EZD_PI2 / (double)res ) );
+
+				// If it falls on the image
+				if ( EZD_DASH_ON( p ) && 0 <= px && px < w && 0 <= py && py < h )
+				{	pImg = &p->pImage[ py * sw + px * pw ];
+					pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+				} // end if
+
+			} // end for
+
+		} break;
+
+		case 32 :
+			for ( i = 0; i < resdraw; i++ )
+			{
+				// Offset for this pixel
+				px = x + (int)( (double)x_rad * sin( (double)i * EZD_PI2 / (double)res ) );
+				py = y + (int)( (double)x_rad * cos( (double)i * EZD_PI2 / (double)res ) );
+
+				// If it falls on the image
+				if ( EZD_DASH_ON( p ) && 0 <= px && px < w && 0 <= py && py < h )
+					*(unsigned int*)&p->pImage[ py * sw + px * pw ] = x_col;
+
+			} // end for
+
+			break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	return 1;
+#endif
+}
+
+
+int ezd_circle( HEZDIMAGE x_hDib, int x, int y, int x_rad, int x_col )
+{
+	return ezd_arc( x_hDib, x, y, x_rad, 0, EZD_PI2, x_col );
+}
+
+int ezd_fill_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col )
+{
+	int w, h, x, y, sw, pw, fw, fh;
+	unsigned char *pStart, *pPos;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Swap coords if needed
+	if ( x1 > x2 ) { int t = x1; x1 = x2; x2 = t; }
+	if ( y1 > y2 ) { int t = y1; y1 = y2; y2 = t; }
+
+	// Clip
+	if ( 0 > x1 ) x1 = 0; else if ( x1 >= w ) x1 = w - 1;
+	if ( 0 > y1 ) y1 = 0; else if ( y1 >= h ) y1 = h - 1;
+	if ( 0 > x2 ) x2 = 0; else if ( x2 >= w ) x2 = w - 1;
+	if ( 0 > y2 ) y2 = 0; else if ( y2 >= h ) y2 = h - 1;
+
+	// Fill width and height
+	fw = x2 - x1;
+	fh = y2 - y1;
+
+	// Are we left with a valid region
+	if ( 0 > fw || 0 > fh )
+	{	_SHOW( "Invalid fill rect : %d,%d -> %d,%d : %dx%d ",
+			   x1, y1, x2, y2, w, h );
+		return 0;
+	} // en dif
+
+	// Check for user callback function
+	if ( p->pfSetPixel )
+	{
+		// Fill each pixel
+		for ( y = y1; y < y2; y++ )
+			for( x = x1; x < x2; x++ )
+				if ( 0 <= x && x < w && 0 <= y && y < h )
+					if ( !p->pfSetPixel( p->pSetPixelUser, x, y, x_col, 0 ) )
+						return 0;
+
+		return 1;
+
+	} // end if
+
+	ezd_mark_dirty( p, x1, y1, x2, y2 );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the first line
+	switch( p->bih.biBitCount )
+	{
+		case 1 :
+		{
+			int c = EZD_COMPARE_THRESHOLD( x_col, p->colThreshold );
+			static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+			// Just fill it in pixel by pixel for 1 bit images
+			for ( y = y1; y < y2; y++ )
+				for( x = x1; x < x2; x++ )
+					if ( 0 <= x && x < w && 0 <= y && y < h )
+					{
+						if ( c )
+							p->pImage[ y * sw + ( x >> 3 ) ] |= xm[ x & 7 ];
+						else
+							p->pImage[ y * sw + ( x >> 3 ) ] &= ~xm[ x & 7 ];
+
+					} // end if
+
+			return 1;
+
+		} break;
+
+		case 24 :
+		{
+			// Color values
+			unsigned char r = x_col & 0xff;
+			unsigned char g = ( x_col >> 8 ) & 0xff;
+			unsigned char b = ( x_col >> 16 ) & 0xff;
+			pStart = pPos = &p->pImage[ y1 * sw + x1 * pw ];
+
+			// Set the first line
+			for( x = 0; x < fw; x++, pPos += pw )
+				pPos[ 0 ] = r, pPos[ 1 ] = g, pPos[ 2 ] = b;
+
+		} break;
+
+		case 32 :
+		{
+			// Set the first line
+			pStart = pPos = &p->pImage[ y1 * sw + x1 * pw ];
+			for( x = 0; x < fw; x++, pPos += pw )
+				*(unsigned int*)pPos = x_col;
+
+		} break;
+
+		default :
+			return 0;
+
+	} // end switch
+
+	// Copy remaining lines
+	pPos = pStart;
+	for( y = 1; y < fh; y++ )
+	{
+		// Skip to next line
+		pPos += sw;
+		EZD_MEMCPY( pPos, pStart, fw * pw );
+
+	} // end for
+
+	return 1;
+}
+
+/// Fills x1 to x2, exclusive, on row y, clipped to the image
+static int ezd_fill_span_clip( SImageData *p, int x1, int x2, int y, int x_col )
+{
+	int w = EZD_ABS( p->bih.biWidth ), h = EZD_ABS( p->bih.biHeight );
+
+	if ( 0 > y || y >= h )
+		return 1;
+
+	if ( 0 > x1 )
+		x1 = 0;
+	if ( w < x2 )
+		x2 = w;
+
+	return ( x1 < x2 ) ? ezd_fill_span( p, x1, x2, y, x_col ) : 1;
+}
+
+/// Steps x in to the edge of an ellipse on row dy from the center, a pixel
+/// is inside if its center is within the ellipse with half a pixel added to
+/// each radius.  Callers move dy out from the center, so x only decreases.
+static int ezd_ellipse_edge( int rx, int ry, int x, int dy )
+{
+	long long a = 2 * (long long)rx + 1, b = 2 * (long long)ry + 1;
+
+	if ( 0 > rx || 0 > ry || dy > ry )
+		return -1;
+
+	// Both sides stay below 2 * a * a * b * b, exact while that fits
+	if ( 0x40000000 > a * b )
+		while ( 0 <= x && 4 * (long long)x * x * b * b + 4 * (long long)dy * dy * a * a > a * a * b * b )
+			x--;
+
+	// Huge radii would overflow, compare in floating point
+	else
+		while ( 0 <= x && 4. * x * x * b * b + 4. * dy * dy * a * a > (double)a * a * b * b )
+			x--;
+
+	return x;
+}
+
+int ezd_fill_ellipse( HEZDIMAGE x_hDib, int x, int y, int rx, int ry, int x_col )
+{
+	int dy, ex;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || 0 > rx || 0 > ry )
+		return _ERR( 0, "Invalid parameters" );
+
+	for ( dy = 0, ex = rx; dy <= ry; dy++ )
+	{
+		ex = ezd_ellipse_edge( rx, ry, ex, dy );
+
+		if ( !ezd_fill_span_clip( p, x - ex, x + ex + 1, y - dy, x_col ) )
+			return 0;
+
+		if ( dy && !ezd_fill_span_clip( p, x - ex, x + ex + 1, y + dy, x_col ) )
+			return 0;
+
+	} // end for
+
+	return 1;
+}
+
+int ezd_fill_circle( HEZDIMAGE x_hDib, int x, int y, int x_rad, int x_col )
+{
+	return ezd_fill_ellipse( x_hDib, x, y, x_rad, x_rad, x_col );
+}
+
+int ezd_ellipse( HEZDIMAGE x_hDib, int x, int y, int rx, int ry, int x_col )
+{
+	int i, dy, ex, nx, ix, ox, orx, ory, irx, iry, a;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || 0 > rx || 0 > ry )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Wide pens fill the ring between two ellipses
+	if ( 1 < p->nPenWidth )
+	{
+		orx = rx + p->nPenWidth / 2, ory = ry + p->nPenWidth / 2;
+		irx = orx - p->nPenWidth, iry = ory - p->nPenWidth;
+
+		for ( dy = 0, ox = orx, ix = irx; dy <= ory; dy++ )
+		{
+			ox = ezd_ellipse_edge( orx, ory, ox, dy );
+			ix = ezd_ellipse_edge( irx, iry, ix, dy );
+
+			// A span each side of the inner ellipse, or one across it
+			for ( i = 0; i < ( dy ? 2 : 1 ); i++ )
+				if ( 0 > ix )
+				{	if ( !ezd_fill_span_clip( p, x - ox, x + ox + 1, i ? y + dy : y - dy, x_col ) )
+						return 0;
+				} // end if
+				else if ( !ezd_fill_span_clip( p, x - ox, x - ix, i ? y + dy : y - dy, x_col )
+						  || !ezd_fill_span_clip( p, x + ix + 1, x + ox + 1, i ? y + dy : y - dy, x_col ) )
+					return 0;
+
+		} // end for
+
+		return 1;
+
+	} // end if
+
+	for ( dy = 0, ex = rx, nx = rx; dy <= ry; dy++ )
+	{
+		// Edge on this row and the next one out
+		ex = ezd_ellipse_edge( rx, ry, nx, dy );
+		nx = ezd_ellipse_edge( rx, ry, ex, dy + 1 );
+
+		// Run from where the next row ends, so the outline has no gaps
+		a = ( nx < ex ) ? nx + 1 : ex;
+
+		for ( i = 0; i < ( dy ? 2 : 1 ); i++ )
+			if ( !a )
+			{	if ( !ezd_fill_span_clip( p, x - ex, x + ex + 1, i ? y + dy : y - dy, x_col ) )
+					return 0;
+			} // end if
+			else if ( !ezd_fill_span_clip( p, x - ex, x - a + 1, i ? y + dy : y - dy, x_col )
+					  || !ezd_fill_span_clip( p, x + a, x + ex + 1, i ? y + dy : y - dy, x_col ) )
+				return 0;
+
+	} // end for
+
+	return 1;
+}
+
+int ezd_fill_round_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_rad, int x_col )
+{
+	int y, dy, ex;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || 0 > x_rad )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Swap coords if needed
+	if ( x1 > x2 ) { int t = x1; x1 = x2; x2 = t; }
+	if ( y1 > y2 ) { int t = y1; y1 = y2; y2 = t; }
+
+	// Corners can't be bigger than the rectangle
+	if ( x_rad > ( x2 - x1 - 1 ) / 2 )
+		x_rad = ( x2 - x1 - 1 ) / 2;
+	if ( x_rad > ( y2 - y1 - 1 ) / 2 )
+		x_rad = ( y2 - y1 - 1 ) / 2;
+	if ( 0 > x_rad )
+		x_rad = 0;
+
+	// Rows between the corners
+	for ( y = y1 + x_rad; y < y2 - x_rad; y++ )
+		if ( !ezd_fill_span_clip( p, x1, x2, y, x_col ) )
+			return 0;
+
+	// Rows through the corners, working out from the corner centers
+	for ( dy = 1, ex = x_rad; dy <= x_rad; dy++ )
+	{
+		ex = ezd_ellipse_edge( x_rad, x_rad, ex, dy );
+
+		if ( !ezd_fill_span_clip( p, x1 + x_rad - ex, x2 - x_rad + ex, y1 + x_rad - dy, x_col )
+			 || !ezd_fill_span_clip( p, x1 + x_rad - ex, x2 - x_rad + ex, y2 - 1 - x_rad + dy, x_col ) )
+			return 0;
+
+	} // end for
+
+	return 1;
+}
+
+int ezd_flood_fill( HEZDIMAGE x_hDib, int x, int y, int x_bcol, int x_col )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int ok, n, i, ii, w, h, sw, pw, bc, fx1, fy1, fx2, fy2;
+	unsigned char r, g, b, br, bg, bb;
+	unsigned char *pImg, *map;
+	SImageData *p = (SImageData*)x_hDib;
+
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage )
+		return _ERR( 0, "Invalid parameters" );
+
+	// +++ Fix ezd_flood_fill() for 1 bpp
+	if ( 1 == p->bih.biBitCount )
+		return 0; // _ERR( 0, "Invalid pixel depth" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Ensure pixel is within the image
+	if ( 0 > x || x >= w || 0 > y || y >= h )
+	{	_SHOW( "Point out of range : %d,%d : %dx%d ", x, y, w, h );
+		return 0;
+	} // en dif
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Set the image pointer
+	pImg = p->pImage;
+
+	// Allocate space for fill map
+	map = (unsigned char*)EZD_calloc( w * h, 1 );
+	if ( !map )
+		return 0;
+
+	// Prepare 24 bit color components
+	r = x_col & 0xff; g = ( x_col >> 8 ) & 0xff; b = ( x_col >> 16 ) & 0xff;
+	br = x_bcol & 0xff; bg = ( x_bcol >> 8 ) & 0xff; bb = ( x_bcol >> 16 ) & 0xff;
+
+	// Initialize indexes
+	i = y * w + x;
+	ii = y * sw + x * pw;
+
+	// Save away bit count
+	bc = p->bih.biBitCount;
+
+	// Area filled
+	fx1 = fx2 = x, fy1 = fy2 = y;
+
+	// Crawl the map
+	while ( ( map[ i ] & 0x0f ) <= 3 )
+	{
+
+		if ( ( map[ i ] & 0x0f ) == 0 )
+		{
+			// In the name of simplicity
+			switch( bc )
+			{
+				case 24 :
+					pImg[ ii ] = r;
+					pImg[ ii + 1 ] = g;
+					pImg[ ii + 2 ] = b;
+					break;
+
+				case 32 :
+					*(unsigned int*)&p->pImage[ ii ] = x_col;
+					break;
+
+			} // end switch
+
+			if ( x < fx1 ) fx1 = x; else if ( x > fx2 ) fx2 = x;
+			if ( y < fy1 ) fy1 = y; else if ( y > fy2 ) fy2 = y;
+
+			// Point to next direction
+			map[ i ] &= 0xf0, map[ i ] |= 1;
+
+			// Can we go up?
+			if ( y < ( h - 1 ) )
+			{
+				n = ( y + 1 ) * sw + x * pw;
+				switch( bc )
+				{	case 24 :
+						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
+						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
+						break;
+					case 32 :
+						ok = *(unsigned int*)&pImg[ n ] != x_col;
+						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
+						break;
+				} // end switch
+
+				if ( ok )
+				{	y++;
+					i = y * w + x;
+					map[ i ] = 0x10;
+					ii = n;
+				} // end if
+
+			} // end if
+
+		} // end if
+
+		if ( ( map[ i ] & 0x0f ) == 1 )
+		{
+			// Point to next direction
+			map[ i ] &= 0xf0, map[ i ] |= 2;
+
+			// Can we go right?
+			if ( x < ( w - 1 ) )
+			{
+				n = y * sw + ( x + 1 ) * pw;
+				switch( bc )
+				{	case 24 :
+						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
+						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
+						break;
+					case 32 :
+						ok = *(unsigned int*)&pImg[ n ] != x_col;
+						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
+						break;
+				} // end switch
+
+				if ( ok )
+				{	x++;
+					i = y * w + x;
+					map[ i ] = 0x20;
+					ii = n;
+				} // end if
+
+			} // end if
+
+		} // end if
+
+		if ( ( map[ i ] & 0x0f ) == 2 )
+		{
+			// Point to next direction
+			map[ i ] &= 0xf0, map[ i ] |= 3;
+
+			// Can we go down?
+			if ( y > 0 )
+			{
+				n = ( y - 1 ) * sw + x * pw;
+				switch( bc )
+				{	case 24 :
+						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
+						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
+						break;
+					case 32 :
+						ok = *(unsigned int*)&pImg[ n ] != x_col;
+						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
+						break;
+				} // end switch
+
+				if ( ok )
+				{	y--;
+					i = y * w + x;
+					map[ i ] = 0x30;
+					ii = n;
+				} // end if
+
+			} // end if
+
+		} // end if
+
+		if ( ( map[ i ] & 0x0f ) == 3 )
+		{
+			// Point to next
+			map[ i ] &= 0xf0, map[ i ] |= 4;
+
+			// Can we go left
+			if ( x > 0 )
+			{
+				n = y * sw + ( x - 1 ) * pw;
+				switch( bc )
+				{	case 24 :
+						ok = pImg[ n ] != r || pImg[ n + 1 ] != g || pImg[ n + 2 ] != b;
+						if ( ok ) ok = pImg[ n ] != br || pImg[ n + 1 ] != bg || pImg[ n + 2 ] != bb;
+						break;
+					case 32 :
+						ok = *(unsigned int*)&pImg[ n ] != x_col;
+						if ( ok ) ok = *(unsigned int*)&pImg[ n ] != x_bcol;
+						break;
+				} // end switch
+
+				if ( ok )
+				{	x--;
+					i = y * w + x;
+					map[ i ] = 0x40;
+					ii = n;
+				} // end if
+
+			} // end if
+
+		} // end if
+
+		// Time to backup?
+		while ( ( map[ i ] & 0xf0 ) > 0 && ( map[ i ] & 0x0f ) > 3 )
+		{
+			// Go back
+			if ( ( map[ i ] & 0xf0 ) == 0x10 ) y--;
+			else if ( ( map[ i ] & 0xf0 ) == 0x20 ) x--;
+			else if ( ( map[ i ] & 0xf0 ) == 0x30 ) y++;
+			else if ( ( map[ i ] & 0xf0 ) == 0x40 ) x++;
+
+			// Set indexes
+			i = y * w + x;
+			ii = y * sw + x * pw;
+
+		} // end while
+
+	} // end if
+
+	EZD_free( map );
+
+	ezd_mark_dirty( p, fx1, fy1, fx2 + 1, fy2 + 1 );
+
+	return 1;
+#endif
+}
+
+// A small font map
+static const char font_map_small [] =
+{
+	// Default glyph
+	'.', 1, 6,	0x08,
+
+	// Tab width
+	'\t', 8, 0,
+
+	// Space
+	' ', 3, 0,
+
+	'!', 1, 6,	0xea,
+	'+', 3, 6,	0x0b, 0xa0, 0x00,
+	'-', 3, 6,	0x03, 0x80, 0x00,
+	'/', 3, 6,	0x25, 0x48, 0x00,
+	'*', 3, 6,	0xab, 0xaa, 0x00,
+	'@', 4, 6,	0x69, 0xbb, 0x87,
+	':', 1, 6,	0x52,
+	'=', 3, 6,	0x1c, 0x70, 0x00,
+	'?', 4, 6,	0x69, 0x24, 0x04,
+	'%', 3, 6,	0x85, 0x28, 0x40,
+	'^', 3, 6,	0x54, 0x00, 0x00,
+	'#', 5, 6,	0x57, 0xd5, 0xf5, 0x00,
+	'$', 5, 6,	0x23, 0xe8, 0xe2, 0xf8,
+	'~', 4, 6,	0x05, 0xa0, 0x00,
+
+	'0', 3, 6,	0x56, 0xd4, 0x31,
+	'1', 2, 6,	0xd5, 0x42,
+	'2', 4, 6,	0xe1, 0x68, 0xf0,
+	'3', 4, 6,	0xe1, 0x61, 0xe0,
+	'4', 4, 6,	0x89, 0xf1, 0x10,
+	'5', 4, 6,	0xf8, 0xe1, 0xe0,
+	'6', 4, 6,	0x78, 0xe9, 0x60,
+	'7', 4, 6,	0xf1, 0x24, 0x40,
+	'8', 4, 6,	0x69, 0x69, 0x60,
+	'9', 4, 6,	0x69, 0x71, 0x60,
+
+	'A', 4, 6,	0x69, 0xf9, 0x90,
+	'B', 4, 6,	0xe9, 0xe9, 0xe0,
+	'C', 4, 6,	0x78, 0x88, 0x70,
+	'D', 4, 6,	0xe9, 0x99, 0xe0,
+	'E', 4, 6,	0xf8, 0xe8, 0xf0,
+	'F', 4, 6,	0xf8, 0xe8, 0x80,
+	'G', 4, 6,	0x78, 0xb9, 0x70,
+	'H', 4, 6,	0x99, 0xf9, 0x90,
+	'I', 3, 6,	0xe9, 0x2e, 0x00,
+	'J', 4, 6,	0xf2, 0x2a, 0x40,
+	'K', 4, 6,	0x9a, 0xca, 0x90,
+	'L', 3, 6,	0x92, 0x4e, 0x00,
+	'M', 5, 6,	0x8e, 0xeb, 0x18, 0x80,
+	'N', 4, 6,	0x9d, 0xb9, 0x90,
+	'O', 4, 6,	0x69, 0x99, 0x60,
+	'P', 4, 6,	0xe9, 0xe8, 0x80,
+	'Q', 4, 6,	0x69, 0x9b, 0x70,
+	'R', 4, 6,	0xe9, 0xea, 0x90,
+	'S', 4, 6,	0x78, 0x61, 0xe0,
+	'T', 3, 6,	0xe9, 0x24, 0x00,
+	'U', 4, 6,	0x99, 0x99, 0x60,
+	'V', 4, 6,	0x99, 0x96, 0x60,
+	'W', 5, 6,	0x8c, 0x6b, 0x55, 0x00,
+	'X', 4, 6,	0x99, 0x69, 0x90,
+	'Y', 3, 6,	0xb5, 0x24, 0x00,
+	'Z', 4, 6,	0xf2, 0x48, 0xf0,
+
+	'a', 4, 6,	0x69, 0xf9, 0x90,
+	'b', 4, 6,	0xe9, 0xe9, 0xe0,
+	'c', 4, 6,	0x78, 0x88, 0x70,
+	'd', 4, 6,	0xe9, 0x99, 0xe0,
+	'e', 4, 6,	0xf8, 0xe8, 0xf0,
+	'f', 4, 6,	0xf8, 0xe8, 0x80,
+	'g', 4, 6,	0x78, 0xb9, 0x70,
+	'h', 4, 6,	0x99, 0xf9, 0x90,
+	'i', 3, 6,	0xe9, 0x2e, 0x00,
+	'j', 4, 6,	0xf2, 0x2a, 0x40,
+	'k', 4, 6,	0x9a, 0xca, 0x90,
+	'l', 3, 6,	0x92, 0x4e, 0x00,
+	'm', 5, 6,	0x8e, 0xeb, 0x18, 0x80,
+	'n', 4, 6,	0x9d, 0xb9, 0x90,
+	'o', 4, 6,	0x69, 0x99, 0x60,
+	'p', 4, 6,	0xe9, 0xe8, 0x80,
+	'q', 4, 6,	0x69, 0x9b, 0x70,
+	'r', 4, 6,	0xe9, 0xea, 0x90,
+	's', 4, 6,	0x78, 0x61, 0xe0,
+	't', 3, 6,	0xe9, 0x24, 0x00,
+	'u', 4, 6,	0x99, 0x99, 0x60,
+	'v', 4, 6,	0x99, 0x96, 0x60,
+	'w', 5, 6,	0x8c, 0x6b, 0x55, 0x00,
+	'x', 4, 6,	0x99, 0x69, 0x90,
+	'y', 3, 6,	0xb5, 0x24, 0x00,
+	'z', 4, 6,	0xf2, 0x48, 0xf0,
+
+	0,
+};
+
+// A medium font map
+static const char font_map_medium [] =
+{
+	// Default glyph
+	'.', 2, 10,	0x00, 0x3c, 0x00,
+
+	// Tab width
 	'\t', 10, 0,
 
-	// Space
-	' ', 2, 0,
+	// Space
+	' ', 2, 0,
+
+	'!', 1, 10,	0xf6, 0x00,
+	'(', 3, 10,	0x2a, 0x48, 0x88, 0x00,
+	')', 3, 10,	0x88, 0x92, 0xa0, 0x00,
+	',', 2, 10,	0x00, 0x16, 0x00,
+	'-', 3, 10,	0x00, 0x70, 0x00, 0x00,
+	'/', 3, 10,	0x25, 0x25, 0x20, 0x00,
+	'@', 6, 10,	0x7a, 0x19, 0x6b, 0x9a, 0x07, 0x80, 0x00, 0x00,
+	'$', 5, 10,	0x23, 0xab, 0x47, 0x16, 0xae, 0x20, 0x00,
+	'#', 6, 10,	0x49, 0x2f, 0xd2, 0xfd, 0x24, 0x80, 0x00, 0x00,
+	'%', 7, 10,	0x43, 0x49, 0x20, 0x82, 0x49, 0x61, 0x00, 0x00, 0x00,
+	':', 2, 10,	0x3c, 0xf0, 0x00,
+	'^', 3, 10,	0x54, 0x00, 0x00, 0x00,
+	'~', 5, 10,	0x00, 0x11, 0x51, 0x00, 0x00, 0x00, 0x00,
+
+	'0', 5, 10,	0x74, 0x73, 0x59, 0xc5, 0xc0, 0x00, 0x00,
+	'1', 3, 10,	0xc9, 0x24, 0xb8, 0x00,
+	'2', 5, 10,	0x74, 0x42, 0xe8, 0x43, 0xe0, 0x00, 0x00,
+	'3', 5, 10,	0x74, 0x42, 0xe0, 0xc5, 0xc0, 0x00, 0x00,
+	'4', 5, 10,	0x11, 0x95, 0x2f, 0x88, 0x40, 0x00, 0x00,
+	'5', 5, 10,	0xfc, 0x3c, 0x10, 0xc5, 0xc0, 0x00, 0x00,
+	'6', 5, 10,	0x74, 0x61, 0xe8, 0xc5, 0xc0, 0x00, 0x00,
+	'7', 5, 10,	0xfc, 0x44, 0x42, 0x10, 0x80, 0x00, 0x00,
+	'8', 5, 10,	0x74, 0x62, 0xe8, 0xc5, 0xc0, 0x00, 0x00,
+	'9', 5, 10,	0x74, 0x62, 0xf0, 0xc5, 0xc0, 0x00, 0x00,
+
+	'A', 6, 10,	0x31, 0x28, 0x7f, 0x86, 0x18, 0x40, 0x00, 0x00,
+	'B', 6, 10,	0xfa, 0x18, 0x7e, 0x86, 0x1f, 0x80, 0x00, 0x00,
+	'C', 6, 10,	0x7a, 0x18, 0x20, 0x82, 0x17, 0x80, 0x00, 0x00,
+	'D', 6, 10,	0xfa, 0x18, 0x61, 0x86, 0x1f, 0x80, 0x00, 0x00,
+	'E', 6, 10,	0xfe, 0x08, 0x3c, 0x82, 0x0f, 0xc0, 0x00, 0x00,
+	'F', 6, 10,	0xfe, 0x08, 0x3c, 0x82, 0x08, 0x00, 0x00, 0x00,
+	'G', 6, 10,	0x7a, 0x18, 0x27, 0x86, 0x17, 0xc0, 0x00, 0x00,
+	'H', 6, 10,	0x86, 0x18, 0x7f, 0x86, 0x18, 0x40, 0x00, 0x00,
+	'I', 3, 10,	0xe9, 0x24, 0xb8, 0x00,
+	'J', 6, 10,	0xfc, 0x41, 0x04, 0x12, 0x46, 0x00, 0x00, 0x00,
+	'K', 5, 10,	0x8c, 0xa9, 0x8a, 0x4a, 0x20, 0x00, 0x00,
+	'L', 4, 10,	0x88, 0x88, 0x88, 0xf0, 0x00,
+	'M', 6, 10,	0x87, 0x3b, 0x61, 0x86, 0x18, 0x40, 0x00, 0x00,
+	'N', 5, 10,	0x8e, 0x6b, 0x38, 0xc6, 0x20, 0x00, 0x00,
+	'O', 6, 10,	0x7a, 0x18, 0x61, 0x86, 0x17, 0x80, 0x00, 0x00,
+	'P', 5, 10,	0xf4, 0x63, 0xe8, 0x42, 0x00, 0x00, 0x00,
+	'Q', 6, 10,	0x7a, 0x18, 0x61, 0x86, 0x57, 0x81, 0x00, 0x00,
+	'R', 5, 10,	0xf4, 0x63, 0xe8, 0xc6, 0x20, 0x00, 0x00,
+	'S', 6, 10,	0x7a, 0x18, 0x1e, 0x06, 0x17, 0x80, 0x00, 0x00,
+	'T', 3, 10,	0xe9, 0x24, 0x90, 0x00,
+	'U', 6, 10,	0x86, 0x18, 0x61, 0x86, 0x17, 0x80, 0x00, 0x00,
+	'V', 6, 10,	0x86, 0x18, 0x61, 0x85, 0x23, 0x00, 0x00, 0x00,
+	'W', 7, 10,	0x83, 0x06, 0x4c, 0x99, 0x35, 0x51, 0x00, 0x00, 0x00,
+	'X', 5, 10,	0x8c, 0x54, 0x45, 0x46, 0x20, 0x00, 0x00,
+	'Y', 5, 10,	0x8c, 0x54, 0x42, 0x10, 0x80, 0x00, 0x00,
+	'Z', 6, 10,	0xfc, 0x10, 0x84, 0x21, 0x0f, 0xc0, 0x00, 0x00,
+
+	'a', 4, 10,	0x00, 0x61, 0x79, 0x70, 0x00,
+	'b', 4, 10,	0x88, 0xe9, 0x99, 0xe0, 0x00,
+	'c', 4, 10,	0x00, 0x78, 0x88, 0x70, 0x00,
+	'd', 4, 10,	0x11, 0x79, 0x99, 0x70, 0x00,
+	'e', 4, 10,	0x00, 0x69, 0xf8, 0x60, 0x00,
+	'f', 4, 10,	0x25, 0x4e, 0x44, 0x40, 0x00,
+	'g', 4, 10,	0x00, 0x79, 0x99, 0x71, 0x60,
+	'h', 4, 10,	0x88, 0xe9, 0x99, 0x90, 0x00,
+	'i', 1, 10,	0xbe, 0x00,
+	'j', 2, 10,	0x04, 0x55, 0x80,
+	'k', 4, 10,	0x89, 0xac, 0xca, 0x90, 0x00,
+	'l', 3, 10,	0xc9, 0x24, 0x98, 0x00,
+	'm', 5, 10,	0x00, 0x15, 0x5a, 0xd6, 0x20, 0x00, 0x00,
+	'n', 4, 10,	0x00, 0xe9, 0x99, 0x90, 0x00,
+	'o', 4, 10,	0x00, 0x69, 0x99, 0x60, 0x00,
+	'p', 4, 10,	0x00, 0xe9, 0x99, 0xe8, 0x80,
+	'q', 4, 10,	0x00, 0x79, 0x97, 0x11, 0x10,
+	'r', 3, 10,	0x02, 0xe9, 0x20, 0x00,
+	's', 4, 10,	0x00, 0x78, 0x61, 0xe0, 0x00,
+	't', 3, 10,	0x4b, 0xa4, 0x88, 0x00,
+	'u', 4, 10,	0x00, 0x99, 0x99, 0x70, 0x00,
+	'v', 4, 10,	0x00, 0x99, 0x99, 0x60, 0x00,
+	'w', 5, 10,	0x00, 0x23, 0x1a, 0xd5, 0x40, 0x00, 0x00,
+	'x', 5, 10,	0x00, 0x22, 0xa2, 0x2a, 0x20, 0x00, 0x00,
+	'y', 4, 10,	0x00, 0x99, 0x99, 0x71, 0x60,
+	'z', 4, 10,	0x00, 0xf1, 0x24, 0xf0, 0x00,
+
+	0,
+
+};
+
+const char* ezd_next_glyph( const char* pGlyph )
+{
+	int sz;
+
+	// Last glyph?
+	if ( !pGlyph || !*pGlyph )
+		return 0;
+
+	// Glyph size in bits
+	sz = pGlyph[ 1 ] * pGlyph[ 2 ];
+
+	// Return a pointer to the next glyph
+	return &pGlyph[ 3 + ( ( sz & 0x07 ) ? ( ( sz >> 3 ) + 1 ) : sz >> 3 ) ];
+}
+
+const char* ezd_find_glyph( HEZDFONT x_pFt, const char ch )
+{
+#if !defined( EZD_STATIC_FONTS )
+
+		SFontData *f = (SFontData*)x_pFt;
+
+		// Ensure valid font pointer
+		if ( !f )
+			return 0;
+
+		// Get a pointer to the glyph
+		return f->pIndex[ (unsigned int)ch & 0xff ];
+#else
+
+	const char* pGlyph = (const char*)x_pFt;
+
+	// Find the glyph
+	while ( pGlyph && *pGlyph )
+		if ( ch == *pGlyph )
+			return pGlyph;
+		else
+			pGlyph = ezd_next_glyph( pGlyph );
+
+	// First glyph is the default
+	return (const char*)x_pFt;
+
+#endif
+}
+
+
+HEZDFONT ezd_load_font( const void *x_pFt, int x_nFtSize, unsigned int x_uFlags )
+{
+#if !defined( EZD_STATIC_FONTS )
+
+	int i, sz;
+	SFontData *p;
+	const char *pGlyph, *pFt = (const char*)x_pFt;
+
+	// Font parameters
+	if ( !pFt )
+		return _ERR( (HEZDFONT)0, "Invalid parameters" );
+
+	// Check for built in small font
+	if ( (const char*)EZD_FONT_TYPE_SMALL == pFt )
+		pFt = font_map_small,  x_nFtSize = sizeof( font_map_small );
+
+	// Check for built in large font
+	else if ( (const char*)EZD_FONT_TYPE_MEDIUM == pFt )
+		pFt = font_map_medium, x_nFtSize = sizeof( font_map_medium );
+
+	// Check for built in large font
+	else if ( (const char*)EZD_FONT_TYPE_LARGE == pFt )
+		return 0;
+
+	/// Null terminated font buffer?
+	if ( 0 >= x_nFtSize )
+	{	x_nFtSize = 0;
+		while ( pFt[ x_nFtSize ] )
+		{	sz = pFt[ x_nFtSize + 1 ] * pFt[ x_nFtSize + 2 ];
+			x_nFtSize += 3 + ( ( sz & 0x07 ) ? ( ( sz >> 3 ) + 1 ) : sz >> 3 );
+		} // end while
+	} // end if
+
+	// Sanity check
+	if ( 0 >= x_nFtSize )
+		return _ERR( (HEZDFONT)0, "Empty font table" );
+
+	// Allocate space for font buffer
+	p = (SFontData*)EZD_malloc( sizeof( SFontData ) + x_nFtSize );
+	if ( !p )
+		return 0;
+
+	// Copy the font bitmaps
+	EZD_MEMCPY( p->pGlyph, pFt, x_nFtSize );
+
+	// Save font flags
+	p->uFlags = x_uFlags;
+
+	// Use the first character as the default glyph
+	for( i = 0; i < 256; i++ )
+		p->pIndex[ i ] = p->pGlyph;
+
+	// Index the glyphs
+	pGlyph = p->pGlyph;
+	while ( pGlyph && *pGlyph )
+		p->pIndex[ (unsigned int)*pGlyph & 0xff ] = pGlyph,
+		pGlyph = ezd_next_glyph( pGlyph );
+
+	// Return the font handle
+	return (HEZDFONT)p;
+
+#else
+
+	// Convert type
+	const unsigned char *pFt = (const unsigned char*)x_pFt;
+
+	// Font parameters
+	if ( !pFt )
+		return _ERR( (HEZDFONT)0, "Invalid parameters" );
+
+	// Check for built in small font
+	if ( EZD_FONT_TYPE_SMALL == pFt )
+		return (HEZDFONT)font_map_small;
+
+	// Check for built in large font
+	else if ( EZD_FONT_TYPE_MEDIUM == pFt )
+		return (HEZDFONT)font_map_medium;
+
+	// Check for built in large font
+	else if ( EZD_FONT_TYPE_LARGE == pFt )
+		return 0;
+
+	// Just use the users raw font table pointer
+	else
+		return (HEZDFONT)x_pFt;
+
+#endif
+}
+
+/// Releases the specified font
+void ezd_destroy_font( HEZDFONT x_hFont )
+{
+#if !defined( EZD_STATIC_FONTS )
+
+	if ( x_hFont )
+		EZD_free( (SFontData*)x_hFont );
+
+#endif
+}
+
+int ezd_text_size( HEZDFONT x_hFont, const char *x_pText, int x_nTextLen, int *pw, int *ph )
+{
+	int i, w, h, lw = 0, lh = 0;
+	const char *pGlyph;
+
+	// Sanity check
+	if ( !x_hFont || !pw || !ph )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Set all sizes to zero
+	*pw = *ph = 0;
+
+	// For each character in the string
+	for ( i = 0; i < x_nTextLen || ( 0 > x_nTextLen && x_pText[ i ] ); i++ )
+	{
+		// Get the specified glyph
+		pGlyph = ezd_find_glyph( x_hFont, x_pText[ i ] );
+
+		switch( x_pText[ i ] )
+		{
+			// CR
+			case '\r' :
+
+				// Reset width, and grab current height
+				w = 0; //h = lh;
+				i += ezd_text_size( x_hFont, &x_pText[ i + 1 ], x_nTextLen - i - 1, &w, &lh );
+
+				// Take the largest width / height
+				*pw = ( *pw > w ) ? *pw : w;
+				//lh = ( lh > h ) ? lh : h;
+
+				break;
+
+			// LF
+			case '\n' :
+
+				// New line
+				w = 0; h = 0;
+				i += ezd_text_size( x_hFont, &x_pText[ i + 1 ], x_nTextLen - i - 1, &w, &h );
+
+				// Take the longest width
+				*pw = ( *pw > w ) ? *pw : w;
+
+				// Add the height
+				*ph += h;
+
+				break;
+
+			// Regular character
+			default :
+
+				// Accumulate width / height
+				lw += !lw ? pGlyph[ 1 ] : ( 2 + pGlyph[ 1 ] ),
+				lh = ( ( pGlyph[ 2 ] > lh ) ? pGlyph[ 2 ] : lh );
+
+				break;
+
+		} // end switch
+
+	} // end for
+
+	// Take the longest width
+	*pw = ( *pw > lw ) ? *pw : lw;
+
+	// Add our line height
+	*ph += lh;
+
+	return i;
+}
+
+static void ezd_draw_bmp_cb( unsigned char *pImg, int x, int y, int sw, int pw,
+							 int inv, int bw, int bh, const char *pBmp,
+							 int col, int ch, t_ezd_set_pixel pf, void *pUser )
+{
+	int w, h, lx = x;
+	unsigned char m = 0x80;
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < bw; w++ )
+		{
+			// Next glyph byte?
+			if ( !m )
+				m = 0x80, pBmp++;
+
+			// Is this pixel on?
+			if ( *pBmp & m )
+				if ( !pf( pUser, lx, y, col, ch ) )
+					return;
+
+			// Next bmp bit
+			m >>= 1;
+
+			// Next x pixel
+			lx++;
+
+		} // end for
+
+		// Reset x
+		lx = x;
+
+		// Reset y
+		y++;
+
+	} // end for
+
+}
+
+static void ezd_draw_bmp_1( unsigned char *pImg, int x, int y, int sw, int pw,
+							int inv, int bw, int bh, const char *pBmp, int col )
+{
+	int w, h, lx = x;
+	unsigned char m = 0x80;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < bw; w++ )
+		{
+			// Next glyph byte?
+			if ( !m )
+				m = 0x80, pBmp++;
+
+			// Is this pixel on?
+			if ( *pBmp & m )
+			{
+				if ( col )
+					pImg[ y * sw + ( lx >> 3 ) ] |= xm[ lx & 7 ];
+				else
+					pImg[ y * sw + ( lx >> 3 ) ] &= ~xm[ lx & 7 ];
+
+			} // end if
+
+			// Next bmp bit
+			m >>= 1;
+
+			// Next x pixel
+			lx++;
+
+		} // end for
+
+		// Reset x
+		lx = x;
+
+		// Reset y
+		y++;
+
+	} // end for
+
+}
+
+static void ezd_draw_bmp_24( unsigned char *pImg, int sw, int pw, int inv,
+							 int bw, int bh, const char *pBmp, int col )
+{
+	int w, h;
+	unsigned char m = 0x80;
+	unsigned char r = col & 0xff;
+	unsigned char g = ( col >> 8 ) & 0xff;
+	unsigned char b = ( col >> 16 ) & 0xff;
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < bw; w++ )
+		{
+			// Next glyph byte?
+			if ( !m )
+				m = 0x80, pBmp++;
+
+			// Is this pixel on?
+			if ( *pBmp & m )
+				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+
+			// Next bmp bit
+			m >>= 1;
+
+			// Next pixel
+			pImg += pw;
+
+		} // end for
+
+		// Next image line
+		if ( 0 < inv )
+			pImg += sw - ( bw * pw );
+		else
+			pImg -= sw + ( bw * pw );
+
+	} // end for
+
+}
+
+static void ezd_draw_bmp_32( unsigned char *pImg, int sw, int pw, int inv,
+							 int bw, int bh, const char *pBmp, int col )
+{
+	int w, h;
+	unsigned char m = 0x80;
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < bw; w++ )
+		{
+			// Next glyph byte?
+			if ( !m )
+				m = 0x80, pBmp++;
+
+			// Is this pixel on?
+			if ( *pBmp & m )
+				*(unsigned int*)pImg = col;
+
+			// Next bmp bit
+			m >>= 1;
+
+			// Next pixel
+			pImg += pw;
+
+		} // end for
+
+		// Next image line
+		if ( 0 < inv )
+			pImg += sw - ( bw * pw );
+		else
+			pImg -= sw + ( bw * pw );
+
+	} // end for
+
+}
+
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Glyph rows decoded into bit masks, msb is the leftmost pixel
+typedef struct _SGlyphMasks
+{
+	/// Font the masks were decoded from
+	HEZDFONT				hFont;
+
+	/// Glyph each entry of nOffset was decoded from, zero if not decoded yet
+	const char				*pGlyph[ 256 ];
+
+	/// Offset of the first row mask for each glyph character, -1 if none
+	int						nOffset[ 256 ];
+
+	/// Row masks
+	unsigned int			*pMask;
+
+	/// Number of row masks used and allocated
+	int						nMask, nMaxMask;
+
+	/// Masks for the next font
+	struct _SGlyphMasks		*pNext;
+
+} SGlyphMasks;
+
+/// Releases a list of glyph masks
+static void ezd_free_glyph_masks( SGlyphMasks *gm )
+{
+	SGlyphMasks *pNext;
+
+	while ( gm )
+	{
+		pNext = gm->pNext;
+
+		if ( gm->pMask )
+			EZD_free( gm->pMask );
+		EZD_free( gm );
+
+		gm = pNext;
+
+	} // end while
+
+}
+
+/// Returns the masks for the specified font from the list, adding them if needed
+static SGlyphMasks* ezd_get_glyph_masks( SGlyphMasks **ppList, HEZDFONT x_hFont )
+{
+	int i;
+	SGlyphMasks *gm;
+
+	for ( gm = *ppList; gm; gm = gm->pNext )
+		if ( gm->hFont == x_hFont )
+			return gm;
+
+	gm = (SGlyphMasks*)EZD_malloc( sizeof( SGlyphMasks ) );
+	if ( !gm )
+		return 0;
+
+	// Glyphs are decoded as they are used
+	for ( i = 0; i < 256; i++ )
+		gm->pGlyph[ i ] = 0, gm->nOffset[ i ] = -1;
+
+	gm->hFont = x_hFont;
+	gm->pMask = 0;
+	gm->nMask = gm->nMaxMask = 0;
+	gm->pNext = *ppList;
+	*ppList = gm;
+
+	return gm;
+}
+
+/// Decodes the rows of a glyph into masks, returns non-zero if the glyph can use them
+static int ezd_decode_glyph_masks( SGlyphMasks *gm, const char *pGlyph )
+{
+	int w, h, n;
+	unsigned char m;
+	unsigned int *pMask;
+	const char *pBmp;
+
+	if ( 0 > pGlyph[ 1 ] || 32 < pGlyph[ 1 ] || 0 > pGlyph[ 2 ] )
+		return 0;
+
+	// Grow the mask buffer
+	if ( gm->nMask + pGlyph[ 2 ] > gm->nMaxMask )
+	{
+		n = gm->nMaxMask * 2;
+		if ( n < gm->nMask + pGlyph[ 2 ] )
+			n = gm->nMask + pGlyph[ 2 ] + 256;
+
+		pMask = (unsigned int*)EZD_malloc( n * sizeof( unsigned int ) );
+		if ( !pMask )
+			return 0;
+
+		if ( gm->pMask )
+			EZD_MEMCPY( (char*)pMask, (const char*)gm->pMask, gm->nMask * sizeof( unsigned int ) ),
+			EZD_free( gm->pMask );
+
+		gm->pMask = pMask;
+		gm->nMaxMask = n;
+
+	} // end if
+
+	n = gm->nMask;
+	m = 0x80; pBmp = &pGlyph[ 3 ];
+	for ( h = 0; h < pGlyph[ 2 ]; h++, n++ )
+		for ( gm->pMask[ n ] = 0, w = 0; w < pGlyph[ 1 ]; w++, m >>= 1 )
+		{	if ( !m )
+				m = 0x80, pBmp++;
+			if ( *pBmp & m )
+				gm->pMask[ n ] |= 0x80000000 >> w;
+		} // end for
+
+	gm->nOffset[ (unsigned int)*pGlyph & 0xff ] = gm->nMask;
+	gm->nMask = n;
+
+	return 1;
+}
+
+/// Returns the row masks for the specified glyph, decoding it on first use, or zero if not available
+static const unsigned int* ezd_find_glyph_masks( SGlyphMasks *gm, const char *pGlyph )
+{
+	int i = (unsigned int)*pGlyph & 0xff;
+
+	if ( !gm )
+		return 0;
+
+	// First use of this character
+	if ( !gm->pGlyph[ i ] )
+	{	gm->pGlyph[ i ] = pGlyph;
+		ezd_decode_glyph_masks( gm, pGlyph );
+	} // end if
+
+	// Font may contain duplicate characters
+	if ( gm->pGlyph[ i ] != pGlyph || 0 > gm->nOffset[ i ] )
+		return 0;
+
+	return &gm->pMask[ gm->nOffset[ i ] ];
+}
+
+static void ezd_draw_masks_24( unsigned char *pImg, int sw, int pw, int inv,
+							   int bh, const unsigned int *pMask, int col )
+{
+	int w, h;
+	unsigned int m;
+	unsigned char r = col & 0xff;
+	unsigned char g = ( col >> 8 ) & 0xff;
+	unsigned char b = ( col >> 16 ) & 0xff;
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++, pImg += inv * sw )
+		for( w = 0, m = pMask[ h ]; m; w++, m <<= 1 )
+			if ( m & 0x80000000 )
+				pImg[ w * pw ] = r, pImg[ w * pw + 1 ] = g, pImg[ w * pw + 2 ] = b;
+
+}
+
+static void ezd_draw_masks_32( unsigned char *pImg, int sw, int inv,
+							   int bh, const unsigned int *pMask, int col )
+{
+	int w, h;
+	unsigned int m;
+
+	// Draw the glyph
+	for( h = 0; h < bh; h++, pImg += inv * sw )
+		for( w = 0, m = pMask[ h ]; m; w++, m <<= 1 )
+			if ( m & 0x80000000 )
+				( (unsigned int*)pImg )[ w ] = col;
+
+}
+
+#else
+
+typedef struct _SGlyphMasks { int nUnused; } SGlyphMasks;
+
+#endif
+
+static int ezd_draw_text( SImageData *p, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen,
+						  int x, int y, int x_col, int w, int h, int sw, int pw, int inv,
+						  SGlyphMasks *gm )
+{
+	int i, mh = 0, lx = x, top, x1 = w, y1 = h, x2 = 0, y2 = 0;
+	const char *pGlyph;
+#if !defined( EZD_NO_ALLOCATION )
+	const unsigned int *pMask;
+#endif
+
+	// For each character in the string
+	for ( i = 0; i < x_nTextLen || ( 0 > x_nTextLen && x_pText[ i ] ); i++ )
+	{
+		// Get the specified glyph
+		pGlyph = ezd_find_glyph( x_hFont, x_pText[ i ] );
+
+		// CR, just go back to starting x pos
+		if ( '\r' == x_pText[ i ] )
+			lx = x;
+
+		// LF - Back to starting x and next line
+		else if ( '\n' == x_pText[ i ] )
+			lx = x, y += inv * ( 1 + mh ), mh = 0;
+
+		// Other characters
+		else
+		{
+			// Draw this glyph if it's completely on the screen,
+			// inverted glyphs are drawn upwards from y except at 1 bpp
+			if ( pGlyph[ 1 ] && pGlyph[ 2 ]
+				 && 0 <= lx && ( lx + pGlyph[ 1 ] ) < w
+				 && 0 <= y && ( y + pGlyph[ 2 ] ) < h
+				 && ( 0 < inv || 1 == p->bih.biBitCount || pGlyph[ 2 ] <= y + 1 ) )
+			{
+				// Check for user callback function
+				if ( p->pfSetPixel )
+					ezd_draw_bmp_cb( p->pImage, lx, y, sw, pw, inv,
+									 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ],
+									 x_col, x_pText[ i ], p->pfSetPixel, p->pSetPixelUser );
+
+				else switch( p->bih.biBitCount )
+				{
+					case 1 :
+						ezd_draw_bmp_1( p->pImage, lx, y, sw, pw, inv,
+										pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ],
+										EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) );
+						break;
+
+					case 24 :
+#if !defined( EZD_NO_ALLOCATION )
+						if ( 0 != ( pMask = ezd_find_glyph_masks( gm, pGlyph ) ) )
+							ezd_draw_masks_24( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
+											   pGlyph[ 2 ], pMask, x_col );
+						else
+#endif
+							ezd_draw_bmp_24( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
+											 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ], x_col );
+						break;
+
+					case 32 :
+#if !defined( EZD_NO_ALLOCATION )
+						if ( 0 != ( pMask = ezd_find_glyph_masks( gm, pGlyph ) ) )
+							ezd_draw_masks_32( &p->pImage[ y * sw + lx * pw ], sw, inv,
+											   pGlyph[ 2 ], pMask, x_col );
+						else
+#endif
+							ezd_draw_bmp_32( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
+											 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ], x_col );
+						break;
+				} // end switch
+
+				// Grow the dirty area, 1 bpp glyphs always draw downwards
+				top = ( 0 < inv || 1 == p->bih.biBitCount ) ? y : y - pGlyph[ 2 ] + 1;
+				if ( lx < x1 ) x1 = lx;
+				if ( top < y1 ) y1 = top;
+				if ( lx + pGlyph[ 1 ] > x2 ) x2 = lx + pGlyph[ 1 ];
+				if ( top + pGlyph[ 2 ] > y2 ) y2 = top + pGlyph[ 2 ];
+
+			} // end if
+
+			// Next character position
+			lx += 2 + pGlyph[ 1 ];
+
+			// Track max height
+			mh = ( pGlyph[ 2 ] > mh ) ? pGlyph[ 2 ] : mh;
+
+		} // end else
+
+	} // end for
+
+	ezd_mark_dirty( p, x1, y1, x2, y2 );
+
+	return 1;
+}
+
+/// Returns the text direction for the specified image and font
+static int ezd_text_inv( SImageData *p, HEZDFONT x_hFont )
+{
+	return ( ( 0 < p->bih.biHeight ? 1 : 0 )
+#if !defined( EZD_STATIC_FONTS )
+			 ^ ( ( ( (SFontData*)x_hFont )->uFlags & EZD_FONT_FLAG_INVERT ) ? 1 : 0 )
+#endif
+		   ) ? -1 : 1;
+}
+
+int ezd_text( HEZDIMAGE x_hDib, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen, int x, int y, int x_col )
+{
+	int w, h;
+	SImageData *p = (SImageData*)x_hDib;
+
+#if !defined( EZD_STATIC_FONTS )
+	if ( !x_hFont )
+		return _ERR( 0, "Invalid parameters" );
+#endif
+
+	// Sanity checks
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	return ezd_draw_text( p, x_hFont, x_pText, x_nTextLen, x, y, x_col, w, h,
+						  EZD_SCANWIDTH( w, p->bih.biBitCount, 4 ),
+						  EZD_FITTO( p->bih.biBitCount, 8 ),
+						  ezd_text_inv( p, x_hFont ), 0 );
+}
+
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Returns less than, equal to, or greater than zero to order text items by scanline
+static int ezd_compare_text_items( const SEZDTextItem *a, const SEZDTextItem *b )
+{
+	if ( a->y != b->y )
+		return ( a->y < b->y ) ? -1 : 1;
+
+	if ( a->hFont != b->hFont )
+		return ( (const char*)a->hFont < (const char*)b->hFont ) ? -1 : 1;
+
+	if ( a->col != b->col )
+		return ( a->col < b->col ) ? -1 : 1;
+
+	return 0;
+}
+
+/// Fills pOrder with the indexes of the items sorted by scanline
+static void ezd_sort_text_items( const SEZDTextItem *pItems, int nItems, int *pOrder )
+{
+	int i, n, g, t;
+
+	for ( i = 0; i < nItems; i++ )
+		pOrder[ i ] = i;
+
+	// Shell sort, avoids a dependency on qsort()
+	for ( g = nItems >> 1; 0 < g; g >>= 1 )
+		for ( i = g; i < nItems; i++ )
+			for ( n = i - g; 0 <= n
+				  && 0 < ezd_compare_text_items( &pItems[ pOrder[ n ] ], &pItems[ pOrder[ n + g ] ] );
+				  n -= g )
+				t = pOrder[ n ], pOrder[ n ] = pOrder[ n + g ], pOrder[ n + g ] = t;
+}
+
+#endif
+
+int ezd_text_batch( HEZDIMAGE x_hDib, const SEZDTextItem *x_pItems, int x_nItems )
+{
+	int w, h, sw, pw, i, tw, th;
+	int *pOrder = 0;
+	const SEZDTextItem *pItem;
+	SGlyphMasks *gm = 0;
+	SImageData *p = (SImageData*)x_hDib;
+#if !defined( EZD_NO_ALLOCATION )
+	SGlyphMasks *pMasks = 0;
+	int bMasks;
+#endif
+
+	// Sanity checks
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || ( !x_pItems && 0 < x_nItems ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+#if !defined( EZD_NO_ALLOCATION )
+
+	// Sort the labels by scanline, then font and color
+	pOrder = (int*)EZD_malloc( ( 0 < x_nItems ? x_nItems : 1 ) * sizeof( int ) );
+	if ( pOrder )
+		ezd_sort_text_items( x_pItems, x_nItems, pOrder );
+
+	// Glyph masks are only used for direct 24 and 32 bit drawing
+	bMasks = !p->pfSetPixel && ( 24 == p->bih.biBitCount || 32 == p->bih.biBitCount );
+
+#endif
+
+	for ( i = 0; i < x_nItems; i++ )
+	{
+		pItem = &x_pItems[ pOrder ? pOrder[ i ] : i ];
+
+		if ( !pItem->hFont || !pItem->pText )
+			continue;
+
+		// Skip labels that are completely outside the image
+		if ( !ezd_text_size( pItem->hFont, pItem->pText, pItem->nTextLen, &tw, &th )
+			 || pItem->x >= w || 0 > pItem->x + tw
+			 || pItem->y - th >= h || 0 > pItem->y + th )
+			continue;
+
+#if !defined( EZD_NO_ALLOCATION )
+		// Each font keeps its own masks for the whole batch
+		if ( bMasks )
+			gm = ezd_get_glyph_masks( &pMasks, pItem->hFont );
+#endif
+
+		ezd_draw_text( p, pItem->hFont, pItem->pText, pItem->nTextLen,
+					   pItem->x, pItem->y, pItem->col, w, h, sw, pw,
+					   ezd_text_inv( p, pItem->hFont ), gm );
+
+	} // end for
+
+#if !defined( EZD_NO_ALLOCATION )
+	ezd_free_glyph_masks( pMasks );
+	if ( pOrder )
+		EZD_free( pOrder );
+#endif
+
+	return 1;
+}
+
+static void ezd_draw_cell_cb( int x, int y, int inv, int bw, int bh, int cw, int chh,
+							  const char *pBmp, int col, int bg, int ch,
+							  t_ezd_set_pixel pf, void *pUser )
+{
+	int w, h, on;
+	unsigned char m = 0x80;
+
+	// Draw the cell
+	for( h = 0; h < chh; h++, y += inv )
+		for( w = 0; w < cw; w++ )
+		{
+			// Is this pixel on?
+			on = 0;
+			if ( h < bh && w < bw )
+			{	if ( !m )
+					m = 0x80, pBmp++;
+				on = ( *pBmp & m ) ? 1 : 0;
+				m >>= 1;
+			} // end if
+
+			if ( !pf( pUser, x + w, y, on ? col : bg, ch ) )
+				return;
+
+		} // end for
+
+}
+
+static void ezd_draw_cell_1( unsigned char *pImg, int x, int y, int sw, int inv,
+							 int bw, int bh, int cw, int chh, const char *pBmp, int col, int bg )
+{
+	int w, h, lx, on;
+	unsigned char m = 0x80;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	// Draw the cell
+	for( h = 0; h < chh; h++, y += inv )
+		for( w = 0, lx = x; w < cw; w++, lx++ )
+		{
+			// Is this pixel on?
+			on = 0;
+			if ( h < bh && w < bw )
+			{	if ( !m )
+					m = 0x80, pBmp++;
+				on = ( *pBmp & m ) ? 1 : 0;
+				m >>= 1;
+			} // end if
+
+			if ( on ? col : bg )
+				pImg[ y * sw + ( lx >> 3 ) ] |= xm[ lx & 7 ];
+			else
+				pImg[ y * sw + ( lx >> 3 ) ] &= ~xm[ lx & 7 ];
+
+		} // end for
+
+}
+
+static void ezd_draw_cell_24( unsigned char *pImg, int sw, int pw, int inv,
+							  int bw, int bh, int cw, int chh, const char *pBmp, int col, int bg )
+{
+	int w, h, on;
+	unsigned char m = 0x80;
+	unsigned char c[ 2 ][ 3 ];
+
+	// Background and foreground color values
+	c[ 0 ][ 0 ] = bg & 0xff; c[ 0 ][ 1 ] = ( bg >> 8 ) & 0xff; c[ 0 ][ 2 ] = ( bg >> 16 ) & 0xff;
+	c[ 1 ][ 0 ] = col & 0xff; c[ 1 ][ 1 ] = ( col >> 8 ) & 0xff; c[ 1 ][ 2 ] = ( col >> 16 ) & 0xff;
+
+	// Draw the cell
+	for( h = 0; h < chh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < cw; w++ )
+		{
+			// Is this pixel on?
+			on = 0;
+			if ( h < bh && w < bw )
+			{	if ( !m )
+					m = 0x80, pBmp++;
+				on = ( *pBmp & m ) ? 1 : 0;
+				m >>= 1;
+			} // end if
+
+			pImg[ 0 ] = c[ on ][ 0 ], pImg[ 1 ] = c[ on ][ 1 ], pImg[ 2 ] = c[ on ][ 2 ];
+
+			// Next pixel
+			pImg += pw;
+
+		} // end for
+
+		// Next image line
+		if ( 0 < inv )
+			pImg += sw - ( cw * pw );
+		else
+			pImg -= sw + ( cw * pw );
+
+	} // end for
+
+}
+
+static void ezd_draw_cell_32( unsigned char *pImg, int sw, int inv,
+							  int bw, int bh, int cw, int chh, const char *pBmp, int col, int bg )
+{
+	int w, h;
+	unsigned char m = 0x80;
+	unsigned int c[ 2 ];
+
+	// Background and foreground colors
+	c[ 0 ] = (unsigned int)bg;
+	c[ 1 ] = (unsigned int)col;
+
+	// Draw the cell
+	for( h = 0; h < chh; h++ )
+	{
+		// Draw horz line
+		for( w = 0; w < cw; w++ )
+		{
+			// Is this pixel on?
+			if ( h < bh && w < bw )
+			{	if ( !m )
+					m = 0x80, pBmp++;
+				( (unsigned int*)pImg )[ w ] = c[ ( *pBmp & m ) ? 1 : 0 ];
+				m >>= 1;
+			} // end if
+			else
+				( (unsigned int*)pImg )[ w ] = c[ 0 ];
+
+		} // end for
+
+		// Next image line
+		pImg += inv * sw;
+
+	} // end for
+
+}
+
+int ezd_text_opaque( HEZDIMAGE x_hDib, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen,
+					 int x, int y, int x_col, int x_bgcol, SEZDRect *x_pRect )
+{
+	int w, h, sw, pw, inv, i, n, mh, cw, chh, top, lx = x;
+	const char *pGlyph;
+	SEZDRect rc;
+	SImageData *p = (SImageData*)x_hDib;
+
+#if !defined( EZD_STATIC_FONTS )
+	if ( !x_hFont )
+		return _ERR( 0, "Invalid parameters" );
+#endif
+
+	// Sanity checks
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
+
+	// Invert font?
+	inv = ezd_text_inv( p, x_hFont );
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+
+	// Nothing drawn yet
+	rc.x1 = w; rc.y1 = h; rc.x2 = 0; rc.y2 = 0;
+
+	// For each line in the string
+	for ( i = 0, chh = -1; i < x_nTextLen || ( 0 > x_nTextLen && x_pText[ i ] ); i++ )
+	{
+		// Calculate the cell height for this line
+		if ( 0 > chh )
+		{
+			for ( n = i, mh = 0; ( n < x_nTextLen || ( 0 > x_nTextLen && x_pText[ n ] ) )
+								 && '\n' != x_pText[ n ]; n++ )
+				if ( '\r' != x_pText[ n ] )
+				{	pGlyph = ezd_find_glyph( x_hFont, x_pText[ n ] );
+					mh = ( pGlyph[ 2 ] > mh ) ? pGlyph[ 2 ] : mh;
+				} // end if
+
+			// Include the line spacing if another line follows
+			chh = mh + ( ( n < x_nTextLen || ( 0 > x_nTextLen && x_pText[ n ] ) ) ? 1 : 0 );
+
+		} // end if
+
+		// CR, just go back to starting x pos
+		if ( '\r' == x_pText[ i ] )
+			lx = x;
+
+		// LF - Back to starting x and next line
+		else if ( '\n' == x_pText[ i ] )
+			lx = x, y += inv * chh, chh = -1;
+
+		// Other characters
+		else
+		{
+			// Get the specified glyph
+			pGlyph = ezd_find_glyph( x_hFont, x_pText[ i ] );
+
+			// Cell includes the character spacing, clipped to the image
+			cw = 2 + pGlyph[ 1 ];
+			if ( lx + cw > w )
+				cw = w - lx;
 
-	'!', 1, 10,	0xf6, 0x00,
-	'(', 3, 10,	0x2a, 0x48, 0x88, 0x00,
-	')', 3, 10,	0x88, 0x92, 0xa0, 0x00,
-	',', 2, 10,	0x00, 0x16, 0x00,
-	'-', 3, 10,	0x00, 0x70, 0x00, 0x00,
-	'/', 3, 10,	0x25, 0x25, 0x20, 0x00,
-	'@', 6, 10,	0x7a, 0x19, 0x6b, 0x9a, 0x07, 0x80, 0x00, 0x00,
-	'$', 5, 10,	0x23, 0xab, 0x47, 0x16, 0xae, 0x20, 0x00,
-	'#', 6, 10,	0x49, 0x2f, 0xd2, 0xfd, 0x24, 0x80, 0x00, 0x00,
-	'%', 7, 10,	0x43, 0x49, 0x20, 0x82, 0x49, 0x61, 0x00, 0x00, 0x00,
-	':', 2, 10,	0x3c, 0xf0, 0x00,
-	'^', 3, 10,	0x54, 0x00, 0x00, 0x00,
-	'~', 5, 10,	0x00, 0x11, 0x51, 0x00, 0x00, 0x00, 0x00,
+			// Topmost image row touched by this cell
+			top = ( 0 < inv ) ? y : ( y - chh + 1 );
 
-	'0', 5, 10,	0x74, 0x73, 0x59, 0xc5, 0xc0, 0x00, 0x00,
-	'1', 3, 10,	0xc9, 0x24, 0xb8, 0x00,
-	'2', 5, 10,	0x74, 0x42, 0xe8, 0x43, 0xe0, 0x00, 0x00,
-	'3', 5, 10,	0x74, 0x42, 0xe0, 0xc5, 0xc0, 0x00, 0x00,
-	'4', 5, 10,	0x11, 0x95, 0x2f, 0x88, 0x40, 0x00, 0x00,
-	'5', 5, 10,	0xfc, 0x3c, 0x10, 0xc5, 0xc0, 0x00, 0x00,
-	'6', 5, 10,	0x74, 0x61, 0xe8, 0xc5, 0xc0, 0x00, 0x00,
-	'7', 5, 10,	0xfc, 0x44, 0x42, 0x10, 0x80, 0x00, 0x00,
-	'8', 5, 10,	0x74, 0x62, 0xe8, 0xc5, 0xc0, 0x00, 0x00,
-	'9', 5, 10,	0x74, 0x62, 0xf0, 0xc5, 0xc0, 0x00, 0x00,
+			// Draw this cell if the glyph is completely on the screen
+			if ( 0 < chh && cw >= pGlyph[ 1 ] && 0 < cw
+				 && 0 <= lx && 0 <= top && ( top + chh ) <= h )
+			{
+				// Check for user callback function
+				if ( p->pfSetPixel )
+					ezd_draw_cell_cb( lx, y, inv, pGlyph[ 1 ], pGlyph[ 2 ], cw, chh, &pGlyph[ 3 ],
+									  x_col, x_bgcol, x_pText[ i ], p->pfSetPixel, p->pSetPixelUser );
 
-	'A', 6, 10,	0x31, 0x28, 0x7f, 0x86, 0x18, 0x40, 0x00, 0x00,
-	'B', 6, 10,	0xfa, 0x18, 0x7e, 0x86, 0x1f, 0x80, 0x00, 0x00,
-	'C', 6, 10,	0x7a, 0x18, 0x20, 0x82, 0x17, 0x80, 0x00, 0x00,
-	'D', 6, 10,	0xfa, 0x18, 0x61, 0x86, 0x1f, 0x80, 0x00, 0x00,
-	'E', 6, 10,	0xfe, 0x08, 0x3c, 0x82, 0x0f, 0xc0, 0x00, 0x00,
-	'F', 6, 10,	0xfe, 0x08, 0x3c, 0x82, 0x08, 0x00, 0x00, 0x00,
-	'G', 6, 10,	0x7a, 0x18, 0x27, 0x86, 0x17, 0xc0, 0x00, 0x00,
-	'H', 6, 10,	0x86, 0x18, 0x7f, 0x86, 0x18, 0x40, 0x00, 0x00,
-	'I', 3, 10,	0xe9, 0x24, 0xb8, 0x00,
-	'J', 6, 10,	0xfc, 0x41, 0x04, 0x12, 0x46, 0x00, 0x00, 0x00,
-	'K', 5, 10,	0x8c, 0xa9, 0x8a, 0x4a, 0x20, 0x00, 0x00,
-	'L', 4, 10,	0x88, 0x88, 0x88, 0xf0, 0x00,
-	'M', 6, 10,	0x87, 0x3b, 0x61, 0x86, 0x18, 0x40, 0x00, 0x00,
-	'N', 5, 10,	0x8e, 0x6b, 0x38, 0xc6, 0x20, 0x00, 0x00,
-	'O', 6, 10,	0x7a, 0x18, 0x61, 0x86, 0x17, 0x80, 0x00, 0x00,
-	'P', 5, 10,	0xf4, 0x63, 0xe8, 0x42, 0x00, 0x00, 0x00,
-	'Q', 6, 10,	0x7a, 0x18, 0x61, 0x86, 0x57, 0x81, 0x00, 0x00,
-	'R', 5, 10,	0xf4, 0x63, 0xe8, 0xc6, 0x20, 0x00, 0x00,
-	'S', 6, 10,	0x7a, 0x18, 0x1e, 0x06, 0x17, 0x80, 0x00, 0x00,
-	'T', 3, 10,	0xe9, 0x24, 0x90, 0x00,
-	'U', 6, 10,	0x86, 0x18, 0x61, 0x86, 0x17, 0x80, 0x00, 0x00,
-	'V', 6, 10,	0x86, 0x18, 0x61, 0x85, 0x23, 0x00, 0x00, 0x00,
-	'W', 7, 10,	0x83, 0x06, 0x4c, 0x99, 0x35, 0x51, 0x00, 0x00, 0x00,
-	'X', 5, 10,	0x8c, 0x54, 0x45, 0x46, 0x20, 0x00, 0x00,
-	'Y', 5, 10,	0x8c, 0x54, 0x42, 0x10, 0x80, 0x00, 0x00,
-	'Z', 6, 10,	0xfc, 0x10, 0x84, 0x21, 0x0f, 0xc0, 0x00, 0x00,
+				else switch( p->bih.biBitCount )
+				{
+					case 1 :
+						ezd_draw_cell_1( p->pImage, lx, y, sw, inv,
+										 pGlyph[ 1 ], pGlyph[ 2 ], cw, chh, &pGlyph[ 3 ],
+										 EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ),
+										 EZD_COMPARE_THRESHOLD( x_bgcol, p->colThreshold ) );
+						break;
 
-	'a', 4, 10,	0x00, 0x61, 0x79, 0x70, 0x00,
-	'b', 4, 10,	0x88, 0xe9, 0x99, 0xe0, 0x00,
-	'c', 4, 10,	0x00, 0x78, 0x88, 0x70, 0x00,
-	'd', 4, 10,	0x11, 0x79, 0x99, 0x70, 0x00,
-	'e', 4, 10,	0x00, 0x69, 0xf8, 0x60, 0x00,
-	'f', 4, 10,	0x25, 0x4e, 0x44, 0x40, 0x00,
-	'g', 4, 10,	0x00, 0x79, 0x99, 0x71, 0x60,
-	'h', 4, 10,	0x88, 0xe9, 0x99, 0x90, 0x00,
-	'i', 1, 10,	0xbe, 0x00,
-	'j', 2, 10,	0x04, 0x55, 0x80,
-	'k', 4, 10,	0x89, 0xac, 0xca, 0x90, 0x00,
-	'l', 3, 10,	0xc9, 0x24, 0x98, 0x00,
-	'm', 5, 10,	0x00, 0x15, 0x5a, 0xd6, 0x20, 0x00, 0x00,
-	'n', 4, 10,	0x00, 0xe9, 0x99, 0x90, 0x00,
-	'o', 4, 10,	0x00, 0x69, 0x99, 0x60, 0x00,
-	'p', 4, 10,	0x00, 0xe9, 0x99, 0xe8, 0x80,
-	'q', 4, 10,	0x00, 0x79, 0x97, 0x11, 0x10,
-	'r', 3, 10,	0x02, 0xe9, 0x20, 0x00,
-	's', 4, 10,	0x00, 0x78, 0x61, 0xe0, 0x00,
-	't', 3, 10,	0x4b, 0xa4, 0x88, 0x00,
-	'u', 4, 10,	0x00, 0x99, 0x99, 0x70, 0x00,
-	'v', 4, 10,	0x00, 0x99, 0x99, 0x60, 0x00,
-	'w', 5, 10,	0x00, 0x23, 0x1a, 0xd5, 0x40, 0x00, 0x00,
-	'x', 5, 10,	0x00, 0x22, 0xa2, 0x2a, 0x20, 0x00, 0x00,
-	'y', 4, 10,	0x00, 0x99, 0x99, 0x71, 0x60,
-	'z', 4, 10,	0x00, 0xf1, 0x24, 0xf0, 0x00,
+					case 24 :
+						ezd_draw_cell_24( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
+										  pGlyph[ 1 ], pGlyph[ 2 ], cw, chh, &pGlyph[ 3 ], x_col, x_bgcol );
+						break;
 
-	0,
+					case 32 :
+						ezd_draw_cell_32( &p->pImage[ y * sw + lx * pw ], sw, inv,
+										  pGlyph[ 1 ], pGlyph[ 2 ], cw, chh, &pGlyph[ 3 ], x_col, x_bgcol );
+						break;
 
-};
+				} // end switch
 
-const char* ezd_next_glyph( const char* pGlyph )
+				// Grow the bounding box
+				if ( lx < rc.x1 ) rc.x1 = lx;
+				if ( top < rc.y1 ) rc.y1 = top;
+				if ( lx + cw > rc.x2 ) rc.x2 = lx + cw;
+				if ( top + chh > rc.y2 ) rc.y2 = top + chh;
+
+			} // end if
+
+			// Next character position
+			lx += 2 + pGlyph[ 1 ];
+
+		} // end else
+
+	} // end for
+
+	ezd_mark_dirty( p, rc.x1, rc.y1, rc.x2, rc.y2 );
+
+	// Return the bounding box
+	if ( x_pRect )
+	{	if ( rc.x1 >= rc.x2 || rc.y1 >= rc.y2 )
+			rc.x1 = rc.y1 = rc.x2 = rc.y2 = 0;
+		*x_pRect = rc;
+	} // end if
+
+	return 1;
+}
+
+/// Strips the flags that do not affect the element storage
+#define EZD_STORAGE_TYPE( t ) ( (t) & ~EZD_TYPE_MASK_ELEMENT )
+
+/// Returns non-zero if long double needs its own conversion
+#define EZD_IS_LONGDOUBLE( t ) ( EZD_TYPE_LONGDOUBLE == (t) && sizeof( long double ) != sizeof( double ) )
+
+#define EZD_CNVTYPE( t, c ) case EZD_TYPE_##t : return oDst + ( (double)( ((c*)pData)[ i ] ) - oSrc ) * rDst / rSrc;
+double ezd_scale_value( int i, int t, void *pData, double oSrc, double rSrc, double oDst, double rDst )
 {
-	int sz;
+	t = EZD_STORAGE_TYPE( t );
 
-	// Last glyph?
-	if ( !pGlyph || !*pGlyph )
+	// Same size as double on some compilers
+	if ( EZD_IS_LONGDOUBLE( t ) )
+		return oDst + ( (double)( ((long double*)pData)[ i ] ) - oSrc ) * rDst / rSrc;
+
+	switch( t )
+	{
+		EZD_CNVTYPE( INT8,	 		signed char );
+		EZD_CNVTYPE( UINT8,			unsigned char );
+		EZD_CNVTYPE( INT16, 		short );
+		EZD_CNVTYPE( UINT16,		unsigned short );
+		EZD_CNVTYPE( INT32, 		int );
+		EZD_CNVTYPE( UINT32, 		unsigned int );
+		EZD_CNVTYPE( INT64, 		long long );
+		EZD_CNVTYPE( UINT64,		unsigned long long );
+		EZD_CNVTYPE( FLOAT32, 		float );
+		EZD_CNVTYPE( FLOAT64, 		double );
+
+		default :
+			break;
+
+	} // end switch
+
+	return 0;
+}
+
+#define EZD_SCALEARRAY( t, c ) case EZD_TYPE_##t : \
+	for ( i = 0; i < nData; i++ ) \
+		pOut[ i ] = oDst + ( (double)( ((const c*)pData)[ i ] ) - oSrc ) * rDst / rSrc; \
+	return 1;
+int ezd_scale_array( int t, const void *pData, int nData, double oSrc, double rSrc, double oDst, double rDst, double *pOut )
+{
+	int i;
+
+	// Sanity checks
+	if ( !pData || !pOut || 0 > nData )
+		return _ERR( 0, "Invalid parameters" );
+
+	t = EZD_STORAGE_TYPE( t );
+
+	// Same size as double on some compilers
+	if ( EZD_IS_LONGDOUBLE( t ) )
+	{	for ( i = 0; i < nData; i++ )
+			pOut[ i ] = oDst + ( (double)( ((const long double*)pData)[ i ] ) - oSrc ) * rDst / rSrc;
+		return 1;
+	} // end if
+
+	// Each loop is simple enough for the compiler to vectorize
+	switch( t )
+	{
+		EZD_SCALEARRAY( INT8,	 	signed char );
+		EZD_SCALEARRAY( UINT8,		unsigned char );
+		EZD_SCALEARRAY( INT16, 		short );
+		EZD_SCALEARRAY( UINT16,		unsigned short );
+		EZD_SCALEARRAY( INT32, 		int );
+		EZD_SCALEARRAY( UINT32, 	unsigned int );
+		EZD_SCALEARRAY( INT64, 		long long );
+		EZD_SCALEARRAY( UINT64,		unsigned long long );
+		EZD_SCALEARRAY( FLOAT32, 	float );
+		EZD_SCALEARRAY( FLOAT64, 	double );
+
+		default :
+			break;
+
+	} // end switch
+
+	return _ERR( 0, "Unsupported element type" );
+}
+
+void ezd_range_init( SEZDRange *x_pRange )
+{
+	if ( !x_pRange )
+		return;
+
+	x_pRange->dMin = x_pRange->dMax = x_pRange->dTotal = 0;
+	x_pRange->nCount = 0;
+}
+
+/// Combines the range in pSrc with the range in pDst
+static void ezd_range_merge( SEZDRange *pDst, const SEZDRange *pSrc )
+{
+	if ( !pSrc->nCount )
+		return;
+
+	if ( !pDst->nCount )
+	{	*pDst = *pSrc;
+		return;
+	} // end if
+
+	if ( pSrc->dMin < pDst->dMin )
+		pDst->dMin = pSrc->dMin;
+
+	if ( pSrc->dMax > pDst->dMax )
+		pDst->dMax = pSrc->dMax;
+
+	pDst->dTotal += pSrc->dTotal;
+	pDst->nCount += pSrc->nCount;
+}
+
+/// Min / max in the native type and four running sums so the loop pipelines
+#define EZD_MINMAX( v ) lo = ( (v) < lo ) ? (v) : lo, hi = ( (v) > hi ) ? (v) : hi
+#define EZD_RANGELOOP( c ) \
+	{	const c *d = (const c*)pData; c lo = d[ 0 ], hi = d[ 0 ]; \
+		double s0 = 0, s1 = 0, s2 = 0, s3 = 0; \
+		for ( i = 0; i + 4 <= nData; i += 4 ) \
+			EZD_MINMAX( d[ i ] ), EZD_MINMAX( d[ i + 1 ] ), \
+			EZD_MINMAX( d[ i + 2 ] ), EZD_MINMAX( d[ i + 3 ] ), \
+			s0 += (double)d[ i ], s1 += (double)d[ i + 1 ], \
+			s2 += (double)d[ i + 2 ], s3 += (double)d[ i + 3 ]; \
+		for ( ; i < nData; i++ ) \
+			EZD_MINMAX( d[ i ] ), s0 += (double)d[ i ]; \
+		r->dMin = (double)lo, r->dMax = (double)hi, r->dTotal = ( s0 + s1 ) + ( s2 + s3 ); \
+	}
+#define EZD_RANGETYPE( t, c ) case EZD_TYPE_##t : EZD_RANGELOOP( c ) break;
+
+/// Calculates the range of a block of elements into r
+static int ezd_range_block( int t, const void *pData, int nData, SEZDRange *r )
+{
+	int i;
+
+	ezd_range_init( r );
+	if ( 0 >= nData )
+		return 1;
+
+	t = EZD_STORAGE_TYPE( t );
+
+	// Same size as double on some compilers
+	if ( EZD_IS_LONGDOUBLE( t ) )
+		EZD_RANGELOOP( long double )
+
+	else switch( t )
+	{
+		EZD_RANGETYPE( INT8,	 	signed char );
+		EZD_RANGETYPE( UINT8,		unsigned char );
+		EZD_RANGETYPE( INT16, 		short );
+		EZD_RANGETYPE( UINT16,		unsigned short );
+		EZD_RANGETYPE( INT32, 		int );
+		EZD_RANGETYPE( UINT32, 		unsigned int );
+		EZD_RANGETYPE( INT64, 		long long );
+		EZD_RANGETYPE( UINT64,		unsigned long long );
+		EZD_RANGETYPE( FLOAT32, 	float );
+		EZD_RANGETYPE( FLOAT64, 	double );
+
+		default :
+			return _ERR( 0, "Unsupported element type" );
+
+	} // end switch
+
+	r->nCount = nData;
+
+	return 1;
+}
+
+/// Shared state for splitting a range calculation across threads
+typedef struct _SRangeTask
+{
+	/// Element type
+	int						t;
+
+	/// Element data
+	const char				*pData;
+
+	/// Total number of elements
+	int						nData;
+
+	/// Number of tasks
+	int						nTasks;
+
+	/// Range of each task
+	SEZDRange				r[ EZD_MAX_THREADS ];
+
+	/// Result of each task
+	int						ok[ EZD_MAX_THREADS ];
+
+} SRangeTask;
+
+static void ezd_range_task( void *pUser, int i )
+{
+	SRangeTask *rt = (SRangeTask*)pUser;
+	int n = rt->nData / rt->nTasks, s = i * n;
+
+	// Last task takes the remainder
+	if ( i == rt->nTasks - 1 )
+		n = rt->nData - s;
+
+	rt->ok[ i ] = ezd_range_block( rt->t, rt->pData + (long long)s * ( rt->t & EZD_TYPE_MASK_SIZE ),
+								   n, &rt->r[ i ] );
+}
+
+int ezd_range_update( SEZDRange *x_pRange, int t, const void *pData, int nData )
+{
+	int i;
+	SRangeTask rt;
+
+	// Sanity checks
+	if ( !x_pRange || !pData || 0 > nData )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Split large arrays across threads
+	rt.t = t; rt.pData = (const char*)pData; rt.nData = nData;
+	rt.nTasks = ezd_task_count( nData );
+	ezd_run_tasks( &ezd_range_task, &rt, rt.nTasks );
+
+	// Combine the results
+	for ( i = 0; i < rt.nTasks; i++ )
+		if ( !rt.ok[ i ] )
+			return 0;
+		else
+			ezd_range_merge( x_pRange, &rt.r[ i ] );
+
+	return 1;
+}
+
+double ezd_calc_range( int t, void *pData, int nData, double *pMin, double *pMax, double *pTotal )
+{
+	SEZDRange r;
+
+	// Sanity checks
+	if ( !pData || 0 >= nData )
 		return 0;
 
-	// Glyph size in bits
-	sz = pGlyph[ 1 ] * pGlyph[ 2 ];
+	ezd_range_init( &r );
+	if ( !ezd_range_update( &r, t, pData, nData ) )
+		return 0;
 
-	// Return a pointer to the next glyph
-	return &pGlyph[ 3 + ( ( sz & 0x07 ) ? ( ( sz >> 3 ) + 1 ) : sz >> 3 ) ];
+	if ( pMin )
+		*pMin = r.dMin;
+
+	if ( pMax )
+		*pMax = r.dMax;
+
+	if ( pTotal )
+		*pTotal = r.dTotal;
+
+	return 1;
 }
 
-const char* ezd_find_glyph( HEZDFONT x_pFt, const char ch )
+int ezd_line_series( HEZDIMAGE x_hDib, int t, const void *pData, int nData,
+					 int x1, int y1, int x2, int y2, int x_col )
 {
-#if !defined( EZD_STATIC_FONTS )
+	int i, k, n, x, y, cx = 0, last = 0, lo = 0, hi = 0;
+	double dMin, dMax, v[ 256 ];
+	SImageData *p = (SImageData*)x_hDib;
 
-		SFontData *f = (SFontData*)x_pFt;
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pData || 0 >= nData )
+		return _ERR( 0, "Invalid parameters" );
 
-		// Ensure valid font pointer
-		if ( !f )
+	// Get the range of the data set
+	if ( !ezd_calc_range( t, (void*)pData, nData, &dMin, &dMax, 0 ) )
+		return 0;
+
+	// Flat series goes along the bottom
+	if ( dMax <= dMin )
+		dMax = dMin + 1;
+
+	for ( i = 0; i < nData; i += n )
+	{
+		// Scale the next block of values
+		n = ( nData - i < (int)( sizeof( v ) / sizeof( v[ 0 ] ) ) )
+			? nData - i : (int)( sizeof( v ) / sizeof( v[ 0 ] ) );
+		if ( !ezd_scale_array( t, (const char*)pData + (long long)i * ( EZD_STORAGE_TYPE( t ) & EZD_TYPE_MASK_SIZE ),
+							   n, dMin, dMax - dMin, 0, y2 - y1, v ) )
 			return 0;
 
-		// Get a pointer to the glyph
-		return f->pIndex[ (unsigned int)ch & 0xff ];
+		for ( k = 0; k < n; k++ )
+		{
+			// Map this sample into the plot area
+			x = x1 + ( ( 1 < nData ) ? (int)( (long long)( i + k ) * ( x2 - x1 ) / ( nData - 1 ) ) : 0 );
+			y = y2 - (int)v[ k ];
+
+			// First sample
+			if ( !i && !k )
+				cx = x, last = lo = hi = y;
+
+			// Same column, track the extents
+			else if ( x == cx )
+			{	last = y;
+				if ( y < lo ) lo = y;
+				if ( y > hi ) hi = y;
+			} // end else if
+
+			// Draw the finished column and connect it to this one
+			else
+			{	if ( !ezd_line( x_hDib, cx, lo, cx, hi, x_col )
+					 || !ezd_line( x_hDib, cx, last, x, y, x_col ) )
+					return 0;
+				cx = x, last = lo = hi = y;
+			} // end else
+
+		} // end for
+
+	} // end for
+
+	// Last column
+	return ezd_line( x_hDib, cx, lo, cx, hi, x_col );
+}
+
+/// Bar graph state
+typedef struct _SBarGraph
+{
+	/// Graph area
+	int						x1, y1, x2, y2;
+
+	/// Label font
+	HEZDFONT				hFont;
+
+	/// Background color
+	int						colBg;
+
+	/// Image the graph was last drawn into
+	HEZDIMAGE				hDib;
+
+	/// Data range when the graph was last drawn
+	double					dMin, dMax;
+
+	/// Label column width
+	int						tyw;
+
+	/// Bar width
+	int						bw;
+
+	/// Number of bars drawn, zero to redraw everything
+	int						nBars;
+
+	/// Top of each bar
+	int						*pTop;
+
+	/// Number of colors
+	int						nCols;
+
+	/// Graph colors
+	int						pCols[ 1 ];
+
+} SBarGraph;
+
+HEZDBARGRAPH ezd_bar_graph_create( int x1, int y1, int x2, int y2, HEZDFONT x_hFont,
+								   const int *pCols, int nCols, int x_bgcol )
+{
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
 #else
+	SBarGraph *g;
 
-	const char* pGlyph = (const char*)x_pFt;
+	// Sanity checks
+	if ( !pCols || 0 >= nCols || x1 >= x2 || y1 >= y2 )
+		return _ERR( (HEZDBARGRAPH)0, "Invalid parameters" );
 
-	// Find the glyph
-	while ( pGlyph && *pGlyph )
-		if ( ch == *pGlyph )
-			return pGlyph;
-		else
-			pGlyph = ezd_next_glyph( pGlyph );
+	g = (SBarGraph*)EZD_malloc( sizeof( SBarGraph ) + ( nCols - 1 ) * sizeof( int ) );
+	if ( !g )
+		return 0;
 
-	// First glyph is the default
-	return (const char*)x_pFt;
+	EZD_MEMSET( (char*)g, 0, sizeof( SBarGraph ) );
+	g->x1 = x1, g->y1 = y1, g->x2 = x2, g->y2 = y2;
+	g->hFont = x_hFont;
+	g->colBg = x_bgcol;
+	g->nCols = nCols;
+	EZD_MEMCPY( (char*)g->pCols, (const char*)pCols, nCols * sizeof( int ) );
 
+	return (HEZDBARGRAPH)g;
 #endif
 }
 
-
-HEZDFONT ezd_load_font( const void *x_pFt, int x_nFtSize, unsigned int x_uFlags )
+void ezd_bar_graph_destroy( HEZDBARGRAPH x_hGraph )
 {
-#if !defined( EZD_STATIC_FONTS )
+#if !defined( EZD_NO_ALLOCATION )
+	SBarGraph *g = (SBarGraph*)x_hGraph;
 
-	int i, sz;
-	SFontData *p;
-	const char *pGlyph, *pFt = (const char*)x_pFt;
+	if ( !g )
+		return;
 
-	// Font parameters
-	if ( !pFt )
-		return _ERR( (HEZDFONT)0, "Invalid parameters" );
+	if ( g->pTop )
+		EZD_free( g->pTop );
 
-	// Check for built in small font
-	if ( (const char*)EZD_FONT_TYPE_SMALL == pFt )
-		pFt = font_map_small,  x_nFtSize = sizeof( font_map_small );
+	EZD_free( g );
+#endif
+}
 
-	// Check for built in large font
-	else if ( (const char*)EZD_FONT_TYPE_MEDIUM == pFt )
-		pFt = font_map_medium, x_nFtSize = sizeof( font_map_medium );
+void ezd_bar_graph_invalidate( HEZDBARGRAPH x_hGraph )
+{
+	if ( x_hGraph )
+		( (SBarGraph*)x_hGraph )->nBars = 0;
+}
 
-	// Check for built in large font
-	else if ( (const char*)EZD_FONT_TYPE_LARGE == pFt )
-		return 0;
+#if !defined( EZD_NO_ALLOCATION )
 
-	/// Null terminated font buffer?
-	if ( 0 >= x_nFtSize )
-	{	x_nFtSize = 0;
-		while ( pFt[ x_nFtSize ] )
-		{	sz = pFt[ x_nFtSize + 1 ] * pFt[ x_nFtSize + 2 ];
-			x_nFtSize += 3 + ( ( sz & 0x07 ) ? ( ( sz >> 3 ) + 1 ) : sz >> 3 );
-		} // end while
-	} // end if
+/// Formats v with the specified number of decimals, returns the length
+static int ezd_format_double( char *pBuf, double v, int nDec )
+{
+	int i, n = 0;
+	long long m = 1, l;
+	char tmp[ 32 ];
+
+	for ( i = 0; i < nDec; i++ )
+		m *= 10;
+
+	// Round to the requested precision
+	l = (long long)( ( 0 > v ) ? ( v * m - 0.5 ) : ( v * m + 0.5 ) );
+	if ( 0 > l )
+		pBuf[ n++ ] = '-', l = -l;
+
+	// Digits in reverse order
+	for ( i = 0; i <= nDec || l; i++, l /= 10 )
+	{	if ( i == nDec && i )
+			tmp[ i++ ] = '.';
+		tmp[ i ] = '0' + (char)( l % 10 );
+	} // end for
 
-	// Sanity check
-	if ( 0 >= x_nFtSize )
-		return _ERR( (HEZDFONT)0, "Empty font table" );
+	while ( i )
+		pBuf[ n++ ] = tmp[ --i ];
 
-	// Allocate space for font buffer
-	p = (SFontData*)EZD_malloc( sizeof( SFontData ) + x_nFtSize );
-	if ( !p )
-		return 0;
+	pBuf[ n ] = 0;
 
-	// Copy the font bitmaps
-	EZD_MEMCPY( p->pGlyph, pFt, x_nFtSize );
+	return n;
+}
 
-	// Save font flags
-	p->uFlags = x_uFlags;
+/// Returns the x coord of the left side of bar i
+#define EZD_BAR_X( g, i ) ( (g)->x1 + (g)->tyw + (i) + ( ( (g)->bw + 1 ) * (i) ) )
 
-	// Use the first character as the default glyph
-	for( i = 0; i < 256; i++ )
-		p->pIndex[ i ] = p->pGlyph;
+/// Returns the fill color of bar i
+#define EZD_BAR_COL( g, i ) ( (g)->pCols[ ( 1 < (g)->nCols ) ? ( 1 + (i) % ( (g)->nCols - 1 ) ) : 0 ] )
 
-	// Index the glyphs
-	pGlyph = p->pGlyph;
-	while ( pGlyph && *pGlyph )
-		p->pIndex[ (unsigned int)*pGlyph & 0xff ] = pGlyph,
-		pGlyph = ezd_next_glyph( pGlyph );
+/// Draws the axis, labels, and all of the bars
+static int ezd_bar_graph_draw( SBarGraph *g, HEZDIMAGE x_hDib, double dMin, double dMax )
+{
+	int i, w, h, bottom = g->y2 - 2;
 
-	// Return the font handle
-	return (HEZDFONT)p;
+	// Clear the graph area
+	if ( !ezd_fill_rect( x_hDib, g->x1, g->y1, g->x2 + 1, g->y2 + 1, g->colBg ) )
+		return 0;
 
-#else
+	g->tyw = 0;
+	if ( g->hFont )
+	{
+		char num[ 64 ];
 
-	// Convert type
-	const unsigned char *pFt = (const unsigned char*)x_pFt;
+		// Calculate text width of smallest value
+		ezd_format_double( num, dMin, 2 );
+		ezd_text_size( g->hFont, num, -1, &g->tyw, &h );
+		ezd_text( x_hDib, g->hFont, num, -1, g->x1, g->y2 - ( h * 2 ), *g->pCols );
 
-	// Font parameters
-	if ( !pFt )
-		return _ERR( (HEZDFONT)0, "Invalid parameters" );
+		// Calculate text width of largest value
+		ezd_format_double( num, dMax, 2 );
+		ezd_text_size( g->hFont, num, -1, &w, &h );
+		ezd_text( x_hDib, g->hFont, num, -1, g->x1, g->y1 + h, *g->pCols );
+		if ( w > g->tyw )
+			g->tyw = w;
 
-	// Check for built in small font
-	if ( EZD_FONT_TYPE_SMALL == pFt )
-		return (HEZDFONT)font_map_small;
+		// Text width margin
+		g->tyw += 10;
 
-	// Check for built in large font
-	else if ( EZD_FONT_TYPE_MEDIUM == pFt )
-		return (HEZDFONT)font_map_medium;
+	} // end if
 
-	// Check for built in large font
-	else if ( EZD_FONT_TYPE_LARGE == pFt )
-		return 0;
+	// Draw margins
+	ezd_line( x_hDib, g->x1 + g->tyw - 2, g->y1, g->x1 + g->tyw - 2, g->y2, *g->pCols );
+	ezd_line( x_hDib, g->x1 + g->tyw - 2, g->y2, g->x2, g->y2, *g->pCols );
 
-	// Just use the users raw font table pointer
-	else
-		return (HEZDFONT)x_pFt;
+	// Calculate bar width
+	g->bw = ( g->x2 - g->x1 - g->tyw - g->nBars * 2 ) / g->nBars;
 
-#endif
+	// Draw the bars
+	for ( i = 0; i < g->nBars; i++ )
+	{
+		// Fill in the bar
+		ezd_fill_rect( x_hDib, EZD_BAR_X( g, i ), g->pTop[ i ],
+					   EZD_BAR_X( g, i ) + g->bw, bottom, EZD_BAR_COL( g, i ) );
+
+		// Outline the bar
+		ezd_rect( x_hDib, EZD_BAR_X( g, i ), g->pTop[ i ],
+				  EZD_BAR_X( g, i ) + g->bw, bottom, *g->pCols );
+
+	} // end for
+
+	return 1;
 }
 
-/// Releases the specified font
-void ezd_destroy_font( HEZDFONT x_hFont )
+/// Redraws bar i after its top moved from o to n
+static void ezd_bar_graph_draw_bar( SBarGraph *g, HEZDIMAGE x_hDib, int i, int o, int n )
 {
-#if !defined( EZD_STATIC_FONTS )
+	int bx1 = EZD_BAR_X( g, i ), bx2 = bx1 + g->bw;
+	int hi = ( o > n ) ? o : n, lo = ( o > n ) ? n : o;
 
-	if ( x_hFont )
-		EZD_free( (SFontData*)x_hFont );
+	// Erase the part of the bar that changed
+	ezd_fill_rect( x_hDib, bx1, lo, bx2 + 1, hi + 1, g->colBg );
 
-#endif
+	// Fill in the new part of the bar, if it grew
+	ezd_fill_rect( x_hDib, bx1, n, bx2, hi + 1, EZD_BAR_COL( g, i ) );
+
+	// Outline the sides and top
+	ezd_line( x_hDib, bx1, n, bx1, hi, *g->pCols );
+	ezd_line( x_hDib, bx2, n, bx2, hi, *g->pCols );
+	ezd_line( x_hDib, bx1, n, bx2, n, *g->pCols );
 }
 
-int ezd_text_size( HEZDFONT x_hFont, const char *x_pText, int x_nTextLen, int *pw, int *ph )
+#endif
+
+int ezd_bar_graph_update( HEZDBARGRAPH x_hGraph, HEZDIMAGE x_hDib, int t, void *pData, int nData )
 {
-	int i, w, h, lw = 0, lh = 0;
-	const char *pGlyph;
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int i, top;
+	double dMin, dMax, dRMin, dRMax;
+	SBarGraph *g = (SBarGraph*)x_hGraph;
 
-	// Sanity check
-	if ( !x_hFont || !pw || !ph )
+	// Sanity checks
+	if ( !g || !x_hDib || !pData || 0 >= nData )
 		return _ERR( 0, "Invalid parameters" );
 
-	// Set all sizes to zero
-	*pw = *ph = 0;
+	// Get the range of the data set
+	if ( !ezd_calc_range( t, pData, nData, &dMin, &dMax, 0 ) )
+		return 0;
 
-	// For each character in the string
-	for ( i = 0; i < x_nTextLen || ( 0 > x_nTextLen && x_pText[ i ] ); i++ )
+	// Anything that moves the bars means starting over
+	if ( g->nBars != nData || g->hDib != x_hDib || g->dMin != dMin || g->dMax != dMax )
 	{
-		// Get the specified glyph
-		pGlyph = ezd_find_glyph( x_hFont, x_pText[ i ] );
-
-		switch( x_pText[ i ] )
+		if ( g->nBars != nData )
 		{
-			// CR
-			case '\r' :
+			if ( g->pTop )
+				EZD_free( g->pTop );
 
-				// Reset width, and grab current height
-				w = 0; //h = lh;
-				i += ezd_text_size( x_hFont, &x_pText[ i + 1 ], x_nTextLen - i - 1, &w, &lh );
+			g->pTop = (int*)EZD_malloc( nData * sizeof( int ) );
+			if ( !g->pTop )
+			{	g->nBars = 0;
+				return 0;
+			} // end if
 
-				// Take the largest width / height
-				*pw = ( *pw > w ) ? *pw : w;
-				//lh = ( lh > h ) ? lh : h;
+		} // end if
 
-				break;
+		g->nBars = 0;
 
-			// LF
-			case '\n' :
+	} // end if
 
-				// New line
-				w = 0; h = 0;
-				i += ezd_text_size( x_hFont, &x_pText[ i + 1 ], x_nTextLen - i - 1, &w, &h );
+	// Add margin to range
+	dRMin = dMin - ( dMax - dMin ) / 10;
+	dRMax = dMax + ( dMax - dMin ) / 10;
+	if ( dRMax <= dRMin )
+		dRMax = dRMin + 1;
 
-				// Take the longest width
-				*pw = ( *pw > w ) ? *pw : w;
+	// Redraw everything
+	if ( !g->nBars )
+	{
+		for ( i = 0; i < nData; i++ )
+			g->pTop[ i ] = g->y2 - (int)ezd_scale_value( i, t, pData, dRMin, dRMax - dRMin, 0, g->y2 - g->y1 - 2 ) - 2;
 
-				// Add the height
-				*ph += h;
+		g->nBars = nData, g->hDib = x_hDib, g->dMin = dMin, g->dMax = dMax;
+		if ( !ezd_bar_graph_draw( g, x_hDib, dMin, dMax ) )
+		{	g->nBars = 0;
+			return 0;
+		} // end if
 
-				break;
+		return 1;
 
-			// Regular character
-			default :
+	} // end if
 
-				// Accumulate width / height
-				lw += !lw ? pGlyph[ 1 ] : ( 2 + pGlyph[ 1 ] ),
-				lh = ( ( pGlyph[ 2 ] > lh ) ? pGlyph[ 2 ] : lh );
+	// Redraw the bars that changed
+	for ( i = 0; i < nData; i++ )
+	{
+		top = g->y2 - (int)ezd_scale_value( i, t, pData, dRMin, dRMax - dRMin, 0, g->y2 - g->y1 - 2 ) - 2;
+		if ( top != g->pTop[ i ] )
+			ezd_bar_graph_draw_bar( g, x_hDib, i, g->pTop[ i ], top ),
+			g->pTop[ i ] = top;
 
-				break;
+	} // end for
 
-		} // end switch
+	return 1;
+#endif
+}
 
-	} // end for
+/// Scrolls the pixels in the specified rectangle left by n columns
+/**
+	The n columns uncovered on the right are left unchanged.
+*/
+static void ezd_scroll_left( SImageData *p, int x1, int y1, int x2, int y2, int n )
+{
+	int x, y, sw, pw;
+	unsigned char *pRow;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
 
-	// Take the longest width
-	*pw = ( *pw > lw ) ? *pw : lw;
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( EZD_ABS( p->bih.biWidth ), p->bih.biBitCount, 4 );
 
-	// Add our line height
-	*ph += lh;
+	ezd_mark_dirty( p, x1, y1, x2, y2 );
+
+	for ( y = y1; y < y2; y++ )
+	{
+		pRow = &p->pImage[ y * sw ];
+
+		// Whole bytes can be moved
+		if ( 1 != p->bih.biBitCount )
+			EZD_MEMMOVE( (char*)&pRow[ x1 * pw ], (const char*)&pRow[ ( x1 + n ) * pw ], ( x2 - x1 - n ) * pw );
+
+		// Move bits one at a time
+		else
+			for ( x = x1; x < x2 - n; x++ )
+				if ( pRow[ ( x + n ) >> 3 ] & xm[ ( x + n ) & 7 ] )
+					pRow[ x >> 3 ] |= xm[ x & 7 ];
+				else
+					pRow[ x >> 3 ] &= ~xm[ x & 7 ];
+
+	} // end for
 
-	return i;
 }
 
-static void ezd_draw_bmp_cb( unsigned char *pImg, int x, int y, int sw, int pw,
-							 int inv, int bw, int bh, const char *pBmp,
-							 int col, int ch, t_ezd_set_pixel pf, void *pUser )
+/// Strip chart state
+typedef struct _SStripChart
 {
-	int w, h, lx = x;
-	unsigned char m = 0x80;
+	/// Chart area, x2 and y2 are exclusive
+	int						x1, y1, x2, y2;
 
-	// Draw the glyph
-	for( h = 0; h < bh; h++ )
-	{
-		// Draw horz line
-		for( w = 0; w < bw; w++ )
-		{
-			// Next glyph byte?
-			if ( !m )
-				m = 0x80, pBmp++;
+	/// Value range
+	double					dMin, dMax;
 
-			// Is this pixel on?
-			if ( *pBmp & m )
-				if ( !pf( pUser, lx, y, col, ch ) )
-					return;
+	/// Line color
+	int						col;
 
-			// Next bmp bit
-			m >>= 1;
+	/// Background color
+	int						colBg;
 
-			// Next x pixel
-			lx++;
+	/// Image the chart was last drawn into
+	HEZDIMAGE				hDib;
 
-		} // end for
+	/// Y coord of the last sample, less than zero if there isn't one
+	int						nLast;
 
-		// Reset x
-		lx = x;
+} SStripChart;
 
-		// Reset y
-		y++;
+/// Fills the chart columns from x1 to the right edge with the background color
+static int ezd_strip_chart_clear( SStripChart *c, SImageData *p, int x1 )
+{
+	int y;
 
-	} // end for
+	// ezd_fill_rect() stops short of the last image column
+	for ( y = c->y1; y < c->y2; y++ )
+		if ( !ezd_fill_span_clip( p, x1, c->x2, y, c->colBg ) )
+			return 0;
 
+	return 1;
 }
 
-static void ezd_draw_bmp_1( unsigned char *pImg, int x, int y, int sw, int pw,
-							int inv, int bw, int bh, const char *pBmp, int col )
+HEZDSTRIPCHART ezd_strip_chart_create( int x1, int y1, int x2, int y2, double dMin, double dMax,
+									   int x_col, int x_bgcol )
 {
-	int w, h, lx = x;
-	unsigned char m = 0x80;
-	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	SStripChart *c;
 
-	// Draw the glyph
-	for( h = 0; h < bh; h++ )
-	{
-		// Draw horz line
-		for( w = 0; w < bw; w++ )
-		{
-			// Next glyph byte?
-			if ( !m )
-				m = 0x80, pBmp++;
+	// Sanity checks
+	if ( x1 >= x2 || y1 >= y2 || dMin >= dMax )
+		return _ERR( (HEZDSTRIPCHART)0, "Invalid parameters" );
 
-			// Is this pixel on?
-			if ( *pBmp & m )
-			{
-				if ( col )
-					pImg[ y * sw + ( lx >> 3 ) ] |= xm[ lx & 7 ];
-				else
-					pImg[ y * sw + ( lx >> 3 ) ] &= ~xm[ lx & 7 ];
+	c = (SStripChart*)EZD_malloc( sizeof( SStripChart ) );
+	if ( !c )
+		return 0;
+
+	c->x1 = x1, c->y1 = y1, c->x2 = x2, c->y2 = y2;
+	c->dMin = dMin, c->dMax = dMax;
+	c->col = x_col, c->colBg = x_bgcol;
+	c->hDib = 0;
+	c->nLast = -1;
+
+	return (HEZDSTRIPCHART)c;
+#endif
+}
+
+void ezd_strip_chart_destroy( HEZDSTRIPCHART x_hChart )
+{
+#if !defined( EZD_NO_ALLOCATION )
+	if ( x_hChart )
+		EZD_free( (SStripChart*)x_hChart );
+#endif
+}
+
+int ezd_strip_chart_add( HEZDSTRIPCHART x_hChart, HEZDIMAGE x_hDib, int t, const void *pData, int nData )
+{
+	int i, x, y, n, cw;
+	double v;
+	SStripChart *c = (SStripChart*)x_hChart;
+	SImageData *p = (SImageData*)x_hDib;
+
+	// Sanity checks
+	if ( !c || !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize || !p->pImage
+		 || !pData || 0 > nData )
+		return _ERR( 0, "Invalid parameters" );
 
-			} // end if
+	// Chart must fit in the image
+	if ( 0 > c->x1 || 0 > c->y1 || c->x2 > EZD_ABS( p->bih.biWidth ) || c->y2 > EZD_ABS( p->bih.biHeight ) )
+		return _ERR( 0, "Strip chart is outside the image" );
 
-			// Next bmp bit
-			m >>= 1;
+	// Chart width
+	cw = c->x2 - c->x1;
 
-			// Next x pixel
-			lx++;
+	// New image, start with an empty chart
+	if ( c->hDib != x_hDib )
+	{	if ( !ezd_strip_chart_clear( c, p, c->x1 ) )
+			return 0;
+		c->hDib = x_hDib;
+		c->nLast = -1;
+	} // end if
 
-		} // end for
+	// Only the last cw samples can be seen
+	i = ( nData > cw ) ? nData - cw : 0;
+	n = nData - i;
+	if ( !n )
+		return 1;
 
-		// Reset x
-		lx = x;
+	// Scroll the chart and clear the new columns
+	if ( n < cw )
+		ezd_scroll_left( p, c->x1, c->y1, c->x2, c->y2, n );
+	if ( !ezd_strip_chart_clear( c, p, c->x2 - n ) )
+		return 0;
 
-		// Reset y
-		y++;
+	// Draw the new samples
+	for ( x = c->x2 - n; i < nData; i++, x++ )
+	{
+		v = ezd_scale_value( i, t, (void*)pData, c->dMin, c->dMax - c->dMin, 0, c->y2 - 1 - c->y1 );
+
+		// Keep the sample inside the chart
+		y = ( 0 >= v ) ? c->y2 - 1 : ( v >= c->y2 - 1 - c->y1 ) ? c->y1 : c->y2 - 1 - (int)v;
+
+		// Step from the last sample to this one
+		ezd_line( x_hDib, x, ( 0 > c->nLast ) ? y : c->nLast, x, y, c->col );
+		c->nLast = y;
 
 	} // end for
 
+	return 1;
 }
 
-static void ezd_draw_bmp_24( unsigned char *pImg, int sw, int pw, int inv,
-							 int bw, int bh, const char *pBmp, int col )
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Shared state for drawing a heat map
+typedef struct _SHeatmapTask
 {
-	int w, h;
-	unsigned char m = 0x80;
-	unsigned char r = col & 0xff;
-	unsigned char g = ( col >> 8 ) & 0xff;
-	unsigned char b = ( col >> 16 ) & 0xff;
+	/// Image
+	SImageData				*p;
 
-	// Draw the glyph
-	for( h = 0; h < bh; h++ )
-	{
-		// Draw horz line
-		for( w = 0; w < bw; w++ )
-		{
-			// Next glyph byte?
-			if ( !m )
-				m = 0x80, pBmp++;
+	/// Element type and data
+	int						t;
+	const char				*pData;
 
-			// Is this pixel on?
-			if ( *pBmp & m )
-				pImg[ 0 ] = r, pImg[ 1 ] = g, pImg[ 2 ] = b;
+	/// Size of the data
+	int						nCols, nRows;
 
-			// Next bmp bit
-			m >>= 1;
+	/// Map area, before clipping
+	int						mx, my, mw, mh;
 
-			// Next pixel
-			pImg += pw;
+	/// Area to draw, clipped to the image
+	int						x1, y1, x2, y2;
 
-		} // end for
+	/// Value range
+	double					dMin, dMax;
 
-		// Next image line
-		if ( 0 < inv )
-			pImg += sw - ( bw * pw );
-		else
-			pImg -= sw + ( bw * pw );
+	/// Color lookup table
+	const int				*pLut;
+	int						nLut;
 
-	} // end for
+	/// Data column for each image column from x1
+	const int				*pColMap;
 
-}
+	/// Number of tasks
+	int						nTasks;
 
-static void ezd_draw_bmp_32( unsigned char *pImg, int sw, int pw, int inv,
-							 int bw, int bh, const char *pBmp, int col )
+	/// Result of each task
+	int						ok[ EZD_MAX_THREADS ];
+
+} SHeatmapTask;
+
+static void ezd_heatmap_task( void *pUser, int i )
 {
-	int w, h;
-	unsigned char m = 0x80;
+	SHeatmapTask *ht = (SHeatmapTask*)pUser;
+	SImageData *p = ht->p;
+	int x, y, r, c, n, sw, pw, lr = -1, esz, cb;
+	int ya = ht->y1 + (int)( (long long)( ht->y2 - ht->y1 ) * i / ht->nTasks );
+	int yb = ht->y1 + (int)( (long long)( ht->y2 - ht->y1 ) * ( i + 1 ) / ht->nTasks );
+	double *pV, v;
+	int *pC;
+	unsigned char *pRow, *pPrev = 0;
+	static unsigned char xm[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
 
-	// Draw the glyph
-	for( h = 0; h < bh; h++ )
+	ht->ok[ i ] = 0;
+
+	// Scratch space for one row of data
+	pV = (double*)EZD_malloc( ht->nCols * ( sizeof( double ) + sizeof( int ) ) );
+	if ( !pV )
+		return;
+	pC = (int*)&pV[ ht->nCols ];
+
+	// Pixel and scan width
+	pw = EZD_FITTO( p->bih.biBitCount, 8 );
+	sw = EZD_SCANWIDTH( p->bih.biWidth, p->bih.biBitCount, 4 );
+	esz = EZD_STORAGE_TYPE( ht->t ) & EZD_TYPE_MASK_SIZE;
+	n = ht->x2 - ht->x1;
+
+	for ( y = ya; y < yb; y++ )
 	{
-		// Draw horz line
-		for( w = 0; w < bw; w++ )
+		pRow = p->pImage ? &p->pImage[ y * sw ] : 0;
+
+		// Data row for this image row
+		r = (int)( (long long)( y - ht->my ) * ht->nRows / ht->mh );
+
+		// Same data row as the last image row, just copy it
+		if ( r == lr && pPrev && !p->pfSetPixel && 1 != p->bih.biBitCount )
+		{	EZD_MEMCPY( (char*)&pRow[ ht->x1 * pw ], (const char*)&pPrev[ ht->x1 * pw ], n * pw );
+			continue;
+		} // end if
+
+		// Look up the colors for this data row
+		if ( r != lr )
 		{
-			// Next glyph byte?
-			if ( !m )
-				m = 0x80, pBmp++;
+			if ( !ezd_scale_array( ht->t, ht->pData + (long long)r * ht->nCols * esz, ht->nCols,
+								   ht->dMin, ht->dMax - ht->dMin, 0, ht->nLut - 1, pV ) )
+			{	EZD_free( pV );
+				return;
+			} // end if
 
-			// Is this pixel on?
-			if ( *pBmp & m )
-				*(unsigned int*)pImg = col;
+			for ( c = 0; c < ht->nCols; c++ )
+				v = pV[ c ],
+				pC[ c ] = ht->pLut[ !( 0 < v ) ? 0 : ( v >= ht->nLut - 1 ) ? ht->nLut - 1 : (int)v ];
 
-			// Next bmp bit
-			m >>= 1;
+			lr = r;
 
-			// Next pixel
-			pImg += pw;
+		} // end if
 
-		} // end for
+		// Write the image row
+		if ( p->pfSetPixel )
+		{	for ( x = 0; x < n; x++ )
+				if ( !p->pfSetPixel( p->pSetPixelUser, ht->x1 + x, y, pC[ ht->pColMap[ x ] ], 0 ) )
+				{	EZD_free( pV );
+					return;
+				} // end if
+		} // end if
 
-		// Next image line
-		if ( 0 < inv )
-			pImg += sw - ( bw * pw );
-		else
-			pImg -= sw + ( bw * pw );
+		else switch( p->bih.biBitCount )
+		{
+			case 1 :
+				for ( x = ht->x1; x < ht->x2; x++ )
+				{	cb = pC[ ht->pColMap[ x - ht->x1 ] ];
+					if ( EZD_COMPARE_THRESHOLD( cb, p->colThreshold ) )
+						pRow[ x >> 3 ] |= xm[ x & 7 ];
+					else
+						pRow[ x >> 3 ] &= ~xm[ x & 7 ];
+				} // end for
+				break;
+
+			case 24 :
+			{	unsigned char *pPix = &pRow[ ht->x1 * pw ];
+				for ( x = 0; x < n; x++, pPix += 3 )
+					cb = pC[ ht->pColMap[ x ] ],
+					pPix[ 0 ] = cb & 0xff, pPix[ 1 ] = ( cb >> 8 ) & 0xff, pPix[ 2 ] = ( cb >> 16 ) & 0xff;
+			} break;
+
+			case 32 :
+			{	unsigned int *pPix = (unsigned int*)&pRow[ ht->x1 * pw ];
+				for ( x = 0; x < n; x++ )
+					pPix[ x ] = pC[ ht->pColMap[ x ] ];
+			} break;
+
+			default :
+				EZD_free( pV );
+				return;
+
+		} // end switch
+
+		pPrev = pRow;
 
 	} // end for
 
+	EZD_free( pV );
+
+	ht->ok[ i ] = 1;
 }
 
-int ezd_text( HEZDIMAGE x_hDib, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen, int x, int y, int x_col )
+#endif
+
+int ezd_heatmap( HEZDIMAGE x_hDib, int t, const void *pData, int nCols, int nRows,
+				 int x1, int y1, int x2, int y2, double dMin, double dMax,
+				 const int *pLut, int nLut )
 {
-	int w, h, sw, pw, inv, i, mh = 0, lx = x;
-	const char *pGlyph;
+#if defined( EZD_NO_ALLOCATION )
+	return 0;
+#else
+	int i, w, h;
+	int *pColMap;
+	SHeatmapTask ht;
 	SImageData *p = (SImageData*)x_hDib;
 
-#if !defined( EZD_STATIC_FONTS )
-	SFontData *f = (SFontData*)x_hFont;
-	if ( !f )
-		return _ERR( 0, "Invalid parameters" );
-#endif
-
 	// Sanity checks
 	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
-		 || ( !p->pImage && !p->pfSetPixel ) )
+		 || ( !p->pImage && !p->pfSetPixel ) || !pData || 0 >= nCols || 0 >= nRows
+		 || x1 >= x2 || y1 >= y2 || !pLut || 0 >= nLut )
 		return _ERR( 0, "Invalid parameters" );
 
+	// Calculate the range if needed
+	if ( dMin == dMax )
+		if ( !ezd_calc_range( t, (void*)pData, nCols * nRows, &dMin, &dMax, 0 ) )
+			return 0;
+
+	// Flat data uses the first color
+	if ( dMax <= dMin )
+		dMax = dMin + 1;
+
 	// Calculate image metrics
 	w = EZD_ABS( p->bih.biWidth );
 	h = EZD_ABS( p->bih.biHeight );
 
-	// Invert font?
-	inv = ( ( 0 < p->bih.biHeight ? 1 : 0 )
-#if !defined( EZD_STATIC_FONTS )
-		  ^ ( ( f->uFlags & EZD_FONT_FLAG_INVERT ) ? 1 : 0 )
-#endif
-		  ) ? -1 : 1;
+	ht.p = p; ht.t = t; ht.pData = (const char*)pData;
+	ht.nCols = nCols; ht.nRows = nRows;
+	ht.mx = x1; ht.my = y1; ht.mw = x2 - x1; ht.mh = y2 - y1;
+	ht.dMin = dMin; ht.dMax = dMax; ht.pLut = pLut; ht.nLut = nLut;
 
-	// Pixel and scan width
-	pw = EZD_FITTO( p->bih.biBitCount, 8 );
-	sw = EZD_SCANWIDTH( w, p->bih.biBitCount, 4 );
+	// Clip to the image
+	ht.x1 = ( 0 > x1 ) ? 0 : x1; ht.x2 = ( w < x2 ) ? w : x2;
+	ht.y1 = ( 0 > y1 ) ? 0 : y1; ht.y2 = ( h < y2 ) ? h : y2;
+	if ( ht.x1 >= ht.x2 || ht.y1 >= ht.y2 )
+		return 1;
 
-	// For each character in the string
-	for ( i = 0; i < x_nTextLen || ( 0 > x_nTextLen && x_pText[ i ] ); i++ )
-	{
-		// Get the specified glyph
-		pGlyph = ezd_find_glyph( x_hFont, x_pText[ i ] );
+	// Data column for each image column
+	pColMap = (int*)EZD_malloc( ( ht.x2 - ht.x1 ) * sizeof( int ) );
+	if ( !pColMap )
+		return 0;
+	for ( i = ht.x1; i < ht.x2; i++ )
+		pColMap[ i - ht.x1 ] = (int)( (long long)( i - x1 ) * nCols / ht.mw );
+	ht.pColMap = pColMap;
 
-		// CR, just go back to starting x pos
-		if ( '\r' == x_pText[ i ] )
-			lx = x;
+	// Tasks write the buffer directly, so mark it here
+	ezd_mark_dirty( p, ht.x1, ht.y1, ht.x2, ht.y2 );
 
-		// LF - Back to starting x and next line
-		else if ( '\n' == x_pText[ i ] )
-			lx = x, y += inv * ( 1 + mh ), mh = 0;
+	// Split into bands of rows, callbacks stay on this thread
+	ht.nTasks = p->pfSetPixel ? 1 : ezd_task_count( (long long)( ht.x2 - ht.x1 ) * ( ht.y2 - ht.y1 ) );
+	if ( ht.nTasks > ht.y2 - ht.y1 )
+		ht.nTasks = ht.y2 - ht.y1;
+	ezd_run_tasks( &ezd_heatmap_task, &ht, ht.nTasks );
 
-		// Other characters
-		else
-		{
-			// Draw this glyph if it's completely on the screen
-			if ( pGlyph[ 1 ] && pGlyph[ 2 ]
-				 && 0 <= lx && ( lx + pGlyph[ 1 ] ) < w
-				 && 0 <= y && ( y + pGlyph[ 2 ] ) < h )
-			{
-				// Check for user callback function
-				if ( p->pfSetPixel )
-					ezd_draw_bmp_cb( p->pImage, lx, y, sw, pw, inv,
-									 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ],
-									 x_col, x_pText[ i ], p->pfSetPixel, p->pSetPixelUser );
+	EZD_free( pColMap );
 
-				else switch( p->bih.biBitCount )
-				{
-					case 1 :
-						ezd_draw_bmp_1( p->pImage, lx, y, sw, pw, inv,
-										pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ],
-										EZD_COMPARE_THRESHOLD( x_col, p->colThreshold ) );
-						break;
+	for ( i = 0; i < ht.nTasks; i++ )
+		if ( !ht.ok[ i ] )
+			return 0;
 
-					case 24 :
-						ezd_draw_bmp_24( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
-										 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ], x_col );
-						break;
+	return 1;
+#endif
+}
 
-					case 32 :
-						ezd_draw_bmp_32( &p->pImage[ y * sw + lx * pw ], sw, pw, inv,
-										 pGlyph[ 1 ], pGlyph[ 2 ], &pGlyph[ 3 ], x_col );
-						break;
-				} // end switch
+/// One span of a rasterized marker
+typedef struct _SMarkerSpan
+{
+	/// Row offset from the center
+	int						y;
 
-			} // end if
+	/// Column offsets from the center, x2 is exclusive
+	int						x1, x2;
 
-			// Next character position
-			lx += 2 + pGlyph[ 1 ];
+} SMarkerSpan;
 
-			// Track max height
-			mh = ( pGlyph[ 2 ] > mh ) ? pGlyph[ 2 ] : mh;
+/// Rasterizes a marker into spans, returns the number of spans
+static int ezd_marker_spans( int nShape, int r, SMarkerSpan *s )
+{
+	int y, hw, n = 0;
 
-		} // end else
+	if ( EZD_MARKER_POINT == nShape || 0 >= r )
+	{	s[ 0 ].y = 0, s[ 0 ].x1 = 0, s[ 0 ].x2 = 1;
+		return 1;
+	} // end if
 
-	} // end for
+	for ( y = -r; y <= r; y++ )
+		switch( nShape )
+		{
+			case EZD_MARKER_SQUARE :
+				s[ n ].y = y, s[ n ].x1 = -r, s[ n++ ].x2 = r + 1;
+				break;
 
-	return 1;
+			case EZD_MARKER_CIRCLE :
+				for ( hw = 0; ( hw + 1 ) * ( hw + 1 ) + y * y <= r * r + r; hw++ )
+					;
+				s[ n ].y = y, s[ n ].x1 = -hw, s[ n++ ].x2 = hw + 1;
+				break;
+
+			case EZD_MARKER_PLUS :
+				if ( !y )
+					s[ n ].y = y, s[ n ].x1 = -r, s[ n++ ].x2 = r + 1;
+				else
+					s[ n ].y = y, s[ n ].x1 = 0, s[ n++ ].x2 = 1;
+				break;
+
+			case EZD_MARKER_CROSS :
+				s[ n ].y = y, s[ n ].x1 = y, s[ n++ ].x2 = y + 1;
+				if ( y )
+					s[ n ].y = y, s[ n ].x1 = -y, s[ n++ ].x2 = -y + 1;
+				break;
+
+			default :
+				return 0;
+
+		} // end switch
+
+	return n;
 }
 
-#define EZD_CNVTYPE( t, c ) case EZD_TYPE_##t : return oDst + ( (double)( ((c*)pData)[ i ] ) - oSrc ) * rDst / rSrc;
-double ezd_scale_value( int i, int t, void *pData, double oSrc, double rSrc, double oDst, double rDst )
+#if !defined( EZD_NO_ALLOCATION )
+
+/// Draws the pixels counted by ezd_scatter() with EZD_MARKER_DENSITY
+static int ezd_scatter_density( SImageData *p, const int *pCount, int x1, int y1, int x2, int y2, int x_col )
 {
-	switch( t )
+	int x, y, e, c, col, mx = 0, cw = x2 - x1;
+	const int *pRow;
+
+	for ( x = 0; x < cw * ( y2 - y1 ); x++ )
+		if ( pCount[ x ] > mx )
+			mx = pCount[ x ];
+
+	if ( !mx )
+		return 1;
+
+	for ( y = y1; y < y2; y++ )
 	{
-		EZD_CNVTYPE( CHAR,	 		char );
-		EZD_CNVTYPE( UCHAR,			unsigned char );
-		EZD_CNVTYPE( SHORT, 		short );
-		EZD_CNVTYPE( USHORT,		unsigned short );
-		EZD_CNVTYPE( INT, 			int );
-		EZD_CNVTYPE( UINT, 			unsigned int );
-		EZD_CNVTYPE( LONGLONG, 		long long );
-		EZD_CNVTYPE( ULONGLONG,		unsigned long long );
-		EZD_CNVTYPE( FLOAT, 		float );
-		EZD_CNVTYPE( DOUBLE, 		double );
-//		EZD_CNVTYPE( LONGDOUBLE,	long double );
+		pRow = &pCount[ ( y - y1 ) * cw ];
 
-		default :
-			break;
+		for ( x = 0; x < cw; x = e )
+		{
+			// Find the run of pixels with the same count
+			c = pRow[ x ];
+			for ( e = x + 1; e < cw && pRow[ e ] == c; e++ )
+				;
 
-	} // end switch
+			if ( !c )
+				continue;
 
-	return 0;
+			// Quarter brightness for one marker up to full for the most
+			col = (int)( ( ( x_col & 0xff ) * (long long)( mx + 3 * c ) ) / ( 4 * (long long)mx ) )
+				  | (int)( ( ( ( x_col >> 8 ) & 0xff ) * (long long)( mx + 3 * c ) ) / ( 4 * (long long)mx ) ) << 8
+				  | (int)( ( ( ( x_col >> 16 ) & 0xff ) * (long long)( mx + 3 * c ) ) / ( 4 * (long long)mx ) ) << 16;
+
+			if ( !ezd_fill_span( p, x1 + x, x1 + e, y, col ) )
+				return 0;
+
+		} // end for
+
+	} // end for
+
+	return 1;
 }
 
-double ezd_calc_range( int t, void *pData, int nData, double *pMin, double *pMax, double *pTotal )
+#endif
+
+/// Number of points scaled at a time by ezd_scatter()
+#define EZD_SCATTER_BLOCK 256
+
+int ezd_scatter( HEZDIMAGE x_hDib, int t, const void *pX, const void *pY, int nData,
+				 int x1, int y1, int x2, int y2, double dXMin, double dXMax,
+				 double dYMin, double dYMax, int nMarker, int nSize, int x_col )
 {
-	int i;
-	double v;
+	int i, j, k, n, w, h, esz, px, py, sx1, sx2, sy, cx1, cy1, cx2, cy2, nSpans, ok = 1;
+	int *pCount = 0;
+	double ax[ EZD_SCATTER_BLOCK ], ay[ EZD_SCATTER_BLOCK ];
+	SMarkerSpan spans[ ( 2 * EZD_MAX_MARKER_SIZE + 1 ) * 2 ];
+	SImageData *p = (SImageData*)x_hDib;
 
 	// Sanity checks
-	if ( !pData || 0 >= nData )
+	if ( !p || sizeof( SBitmapInfoHeader ) != p->bih.biSize
+		 || ( !p->pImage && !p->pfSetPixel ) || !pX || !pY || 0 > nData
+		 || x1 >= x2 || y1 >= y2 || 0 > nSize || EZD_MAX_MARKER_SIZE < nSize )
+		return _ERR( 0, "Invalid parameters" );
+
+	// Rasterize the marker once
+	nSpans = ezd_marker_spans( nMarker & EZD_MARKER_MASK_SHAPE, nSize, spans );
+	if ( !nSpans )
+		return _ERR( 0, "Invalid marker" );
+
+	if ( !nData )
+		return 1;
+
+	// Calculate the ranges if needed
+	if ( dXMin == dXMax && !ezd_calc_range( t, (void*)pX, nData, &dXMin, &dXMax, 0 ) )
+		return 0;
+	if ( dYMin == dYMax && !ezd_calc_range( t, (void*)pY, nData, &dYMin, &dYMax, 0 ) )
 		return 0;
 
-	// Starting point
-	v = ezd_scale_value( 0, t, pData, 0, 1, 0, 1 );
+	// All points at one value go to the left or bottom edge
+	if ( dXMax == dXMin )
+		dXMax = dXMin + 1;
+	if ( dYMax == dYMin )
+		dYMax = dYMin + 1;
 
-	if ( pMin )
-		*pMin = v;
+	// Calculate image metrics
+	w = EZD_ABS( p->bih.biWidth );
+	h = EZD_ABS( p->bih.biHeight );
 
-	if ( pMax )
-		*pMax = v;
+	// Clip to the image
+	cx1 = ( 0 > x1 ) ? 0 : x1; cx2 = ( w < x2 ) ? w : x2;
+	cy1 = ( 0 > y1 ) ? 0 : y1; cy2 = ( h < y2 ) ? h : y2;
+	if ( cx1 >= cx2 || cy1 >= cy2 )
+		return 1;
 
-	if ( pTotal )
-		*pTotal = 0;
+	// Count markers per pixel
+	if ( nMarker & EZD_MARKER_DENSITY )
+	{
+#if defined( EZD_NO_ALLOCATION )
+		return _ERR( 0, "EZD_MARKER_DENSITY requires allocation" );
+#else
+		pCount = (int*)EZD_calloc( ( cx2 - cx1 ) * ( cy2 - cy1 ), sizeof( int ) );
+		if ( !pCount )
+			return _ERR( 0, "Out of memory" );
+#endif
+	} // end if
+
+	esz = EZD_STORAGE_TYPE( t ) & EZD_TYPE_MASK_SIZE;
 
-	// Figure out the range
-	for ( i = 1; i < nData; i++ )
+	for ( i = 0; ok && i < nData; i += n )
 	{
-		// Get element value
-		v = ezd_scale_value( i, t, pData, 0, 1, 0, 1 );
+		n = ( nData - i < EZD_SCATTER_BLOCK ) ? nData - i : EZD_SCATTER_BLOCK;
+
+		// Scale a block of points to image coords, Y is up
+		if ( !ezd_scale_array( t, (const char*)pX + (long long)i * esz, n,
+							   dXMin, dXMax - dXMin, x1, x2 - 1 - x1, ax )
+			 || !ezd_scale_array( t, (const char*)pY + (long long)i * esz, n,
+								  dYMin, dYMax - dYMin, y2 - 1, y1 - ( y2 - 1 ), ay ) )
+		{	ok = 0;
+			break;
+		} // end if
+
+		for ( j = 0; ok && j < n; j++ )
+		{
+			// Skip points outside the range
+			if ( !( ax[ j ] >= x1 && ax[ j ] <= x2 - 1 && ay[ j ] >= y1 && ay[ j ] <= y2 - 1 ) )
+				continue;
+
+			px = x1 + (int)( ax[ j ] - x1 + 0.5 );
+			py = y1 + (int)( ay[ j ] - y1 + 0.5 );
+
+			// Stamp the marker
+			for ( k = 0; k < nSpans; k++ )
+			{
+				sy = py + spans[ k ].y;
+				if ( sy < cy1 || sy >= cy2 )
+					continue;
+
+				sx1 = px + spans[ k ].x1; sx2 = px + spans[ k ].x2;
+				if ( sx1 < cx1 )
+					sx1 = cx1;
+				if ( sx2 > cx2 )
+					sx2 = cx2;
+				if ( sx1 >= sx2 )
+					continue;
+
+				if ( pCount )
+				{	int *pc = &pCount[ ( sy - cy1 ) * ( cx2 - cx1 ) + sx1 - cx1 ];
+					for ( ; sx1 < sx2; sx1++ )
+						( *pc++ )++;
+				} // end if
 
-		// Track minimum
-		if ( pMin && v < *pMin )
-			*pMin = v;
+				else if ( !ezd_fill_span( p, sx1, sx2, sy, x_col ) )
+					ok = 0;
 
-		// Track maximum
-		if ( pMax && v > *pMax )
-			*pMax = v;
+			} // end for
 
-		// Accumulate total
-		if ( pTotal )
-			*pTotal += v;
+		} // end for
 
 	} // end for
 
-	return 1;
-}
+#if !defined( EZD_NO_ALLOCATION )
+	if ( pCount )
+	{	if ( ok )
+			ok = ezd_scatter_density( p, pCount, cx1, cy1, cx2, cy2, x_col );
+		EZD_free( pCount );
+	} // end if
+#endif
 
+	return ok;
+}
@@ -65,8 +65,28 @@ extern "C"
 	struct _HEZDIMAGE;
 	typedef struct _HEZDIMAGE *HEZDIMAGE;
 
-	/// Bytes required for image header
-#	define EZD_HEADER_SIZE				128
+	/// Rectangle, x2 and y2 are exclusive as with ezd_fill_rect()
+	typedef struct _SEZDRect
+	{
+		/// Left
+		int		x1;
+
+		/// Top
+		int		y1;
+
+		/// Right
+		int		x2;
+
+		/// Bottom
+		int		y2;
+
+	} SEZDRect;
+
+	/// Bytes required for image header, packed or not
+#	define EZD_HEADER_SIZE				320
+
+	/// Number of dirty rectangles tracked for each image, see ezd_get_dirty()
+#	define EZD_MAX_DIRTY				8
 	
 	/// Set this flag if you will supply your own image buffer using ezd_set_image_buffer()
 #	define EZD_FLAG_USER_IMAGE_BUFFER	0x0001
@@ -189,6 +209,457 @@ extern "C"
 	*/
 	int ezd_save( HEZDIMAGE x_hDib, const char *x_pFile );
 
+	/// Write function typedef used by ezd_save_sink()
+	/**
+		\param [in] pUser	- User data passed to ezd_save_sink()
+		\param [in] pData	- Data to write
+		\param [in] nData	- Number of bytes in pData
+
+		\return Return non-zero on success, zero to abort the save.
+	*/
+	typedef int (*t_ezd_write)( void *pUser, const void *pData, int nData );
+
+	/// Writes the DIB through a user supplied write function
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pf		- Write function, called once for each of
+								  the headers, the palette and the image data
+		\param [in] x_pUser		- Data passed to the write function
+
+		This works even if EZD_NO_FILES is defined.
+
+		\return The number of bytes written, or zero on failure
+	*/
+	int ezd_save_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser );
+
+	/// Encodes the DIB file into a memory buffer
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [out] x_pBuf		- Buffer that receives the file, may be NULL
+		\param [in] x_nBuf		- Size of the buffer in x_pBuf
+
+		If x_pBuf is NULL, the function returns the size of buffer
+		required without writing anything.
+
+		\return The size of the file in bytes, or zero on failure
+	*/
+	int ezd_save_mem( HEZDIMAGE x_hDib, void *x_pBuf, int x_nBuf );
+
+	/// Writes the DIB to an open file descriptor
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_fd		- File descriptor, a file, pipe or socket
+
+		The headers, palette and image data are written with a single
+		writev() call.  Not available if EZD_NO_FILES or EZD_NO_POSIX is
+		defined.
+
+		\return Non zero on success
+	*/
+	int ezd_save_fd( HEZDIMAGE x_hDib, int x_fd );
+
+	/// Background save handle
+	typedef struct _HEZDSAVE *HEZDSAVE;
+
+	/// Saves the DIB to a file on a background thread
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- New filename
+		\param [in] x_hReuse	- Handle from an earlier call to reuse,
+								  or zero for a new one
+
+		The file is encoded into a buffer owned by the handle, which
+		costs one copy of the image, and written by a worker thread, so
+		drawing can go on as soon as this returns.  Passing the previous
+		handle back in x_hReuse recycles its buffer, after waiting for
+		its save to finish, so a frame loop that saves every frame keeps
+		one copy in flight and does not allocate.  If EZD_NO_THREADS is
+		defined, or no thread can be started, the file is written before
+		this returns.
+
+		\return Save handle, or zero on failure.  If x_hReuse is given
+				it is released on failure.
+	*/
+	HEZDSAVE ezd_save_async( HEZDIMAGE x_hDib, const char *x_pFile, HEZDSAVE x_hReuse );
+
+	/// Returns non zero if a background save has finished
+	/**
+		\param [in] x_hSave		- Save handle
+	*/
+	int ezd_save_done( HEZDSAVE x_hSave );
+
+	/// Waits for a background save to finish
+	/**
+		\param [in] x_hSave		- Save handle
+
+		The handle stays valid, pass it to ezd_save_async() again or
+		release it with ezd_save_release().
+
+		\return Non zero if the file was written
+	*/
+	int ezd_save_wait( HEZDSAVE x_hSave );
+
+	/// Waits for a background save to finish and releases the handle
+	/**
+		\param [in] x_hSave		- Save handle
+
+		\return Non zero if the file was written
+	*/
+	int ezd_save_release( HEZDSAVE x_hSave );
+
+	/// Returns the areas drawn on since the dirty list was last cleared
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [out] x_pRects	- Receives the rectangles, may be NULL
+		\param [in] x_nMax		- Number of rectangles x_pRects can hold
+
+		Every drawing function adds the area it changed in the image
+		buffer to a list of at most EZD_MAX_DIRTY rectangles, in the
+		same coordinates the drawing functions use.  Overlapping and
+		touching areas are merged, and when the list is full the closest
+		pair is merged, so the list may cover more than was drawn but
+		never less.  Use it to update only part of a display, then call
+		ezd_clear_dirty().  Drawing through a set pixel callback is not
+		tracked.
+
+		\return The number of dirty rectangles
+	*/
+	int ezd_get_dirty( HEZDIMAGE x_hDib, SEZDRect *x_pRects, int x_nMax );
+
+	/// Empties the dirty list
+	/**
+		\param [in] x_hDib		- Handle to a dib
+
+		\return Non zero on success
+	*/
+	int ezd_clear_dirty( HEZDIMAGE x_hDib );
+
+	/// Updates a DIB file with the rows that changed
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- DIB filename
+
+		If x_pFile already holds a DIB with the same headers, only the
+		palette and the rows covered by the dirty list are written into
+		it with pwrite().  Otherwise, or if EZD_NO_POSIX is defined, the
+		whole file is saved as with ezd_save().  The dirty list is
+		cleared on success.
+
+		\return Non zero on success
+	*/
+	int ezd_save_incremental( HEZDIMAGE x_hDib, const char *x_pFile );
+
+	/// Loads a DIB file
+	/**
+		\param [in] x_pFile		- DIB filename
+
+		Supports uncompressed 1, 24 and 32 bit images, top-down or
+		bottom-up.  Where possible the file is mapped into memory with
+		a private mapping and the image points at the pixel data in
+		place, so pages are only read when they are touched.  Changes
+		made to the image are never written back to the file.
+
+		Release the image with ezd_destroy().
+
+		\return Handle to the new image, or zero on failure
+	*/
+	HEZDIMAGE ezd_load( const char *x_pFile );
+
+	/// Loads a DIB file from memory
+	/**
+		\param [in] x_pBuf		- DIB file data
+		\param [in] x_nBuf		- Size of the data in x_pBuf
+		\param [in] x_uFlags	- Flags
+
+		x_uFlags can be zero or
+
+			EZD_FLAG_USER_IMAGE_BUFFER	- Point the image at the pixel data
+										  in x_pBuf instead of copying it.
+										  x_pBuf must remain valid until the
+										  image is destroyed.  32 bit images
+										  with unaligned pixel data are
+										  always copied.
+
+		\return Handle to the new image, or zero on failure
+	*/
+	HEZDIMAGE ezd_load_mem( const void *x_pBuf, int x_nBuf, unsigned int x_uFlags );
+
+	/// Creates an image whose pixel buffer is a DIB file
+	/**
+		\param [in] x_pFile		- DIB filename, created if it does not exist
+		\param [in] x_lWidth	- Image width
+		\param [in] x_lHeight	- Image height, negative for top-down
+		\param [in] x_lBpp		- Bits per pixel
+
+		The file is sized to hold the image, the DIB headers are written
+		at the start and the pixel area is mapped into memory, so drawing
+		writes straight into the file.  Use ezd_sync() instead of
+		ezd_save().  Not available if EZD_NO_POSIX is defined.
+
+		Existing pixel data is kept if the file already holds an image
+		with the same dimensions, otherwise the image starts out zeroed.
+
+		\return Handle to the new image, or zero on failure
+	*/
+	HEZDIMAGE ezd_create_mapped( const char *x_pFile, int x_lWidth, int x_lHeight, int x_lBpp );
+
+	/// Flushes an image created by ezd_create_mapped() to its file
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_bWait		- Non zero to wait for the data to reach
+								  the disk, otherwise the write is only
+								  scheduled
+
+		The headers and palette are updated before flushing.
+
+		\return Non zero on success
+	*/
+	int ezd_sync( HEZDIMAGE x_hDib, int x_bWait );
+
+	/// Streaming DIB writer handle
+	typedef struct _HEZDSTREAM *HEZDSTREAM;
+
+	/// Opens a DIB file to be written a band of rows at a time
+	/**
+		\param [in] x_pFile		- DIB filename
+		\param [in] x_hBand		- Band image, the file gets its width,
+								  bits per pixel and palette
+		\param [in] x_lHeight	- Height of the whole image, negative
+								  for a top-down file
+
+		The headers are written immediately.  Render each band into
+		x_hBand, or any image of the same width and bit depth, and pass
+		it to ezd_stream_write().  Bands may be written in any order, and
+		bottom-up files are written in place, so only one band is ever
+		held in memory.
+
+		\return Stream handle, or zero on failure
+	*/
+	HEZDSTREAM ezd_stream_open( const char *x_pFile, HEZDIMAGE x_hBand, int x_lHeight );
+
+	/// Opens a streaming DIB writer on a user write function
+	/**
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+		\param [in] x_hBand		- Band image, the file gets its width,
+								  bits per pixel and palette
+		\param [in] x_lHeight	- Height of the whole image, negative
+								  for a top-down file
+
+		The output can't seek, so bands must be written in file order.
+		For a top-down file that is top to bottom, and for a bottom-up
+		file it is bottom to top.
+
+		\return Stream handle, or zero on failure
+	*/
+	HEZDSTREAM ezd_stream_open_sink( t_ezd_write x_pf, void *x_pUser, HEZDIMAGE x_hBand, int x_lHeight );
+
+	/// Writes a band of rows to a stream
+	/**
+		\param [in] x_hStream	- Stream handle
+		\param [in] x_hBand		- Image holding the rows, either orientation
+		\param [in] x_y			- Row of the full image, counted from the
+								  top, that the top of the band goes to
+
+		Rows of the band that fall outside the image are ignored.
+
+		\return Non zero on success
+	*/
+	int ezd_stream_write( HEZDSTREAM x_hStream, HEZDIMAGE x_hBand, int x_y );
+
+	/// Finishes a stream and releases it
+	/**
+		\param [in] x_hStream	- Stream handle
+
+		\return Non zero if every write succeeded, and for sink streams,
+				if every row was written
+	*/
+	int ezd_stream_close( HEZDSTREAM x_hStream );
+
+	/// Writes the DIB run length encoded with a palette
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- New image filename
+
+		A palette is built from the colors in the image.  Images with
+		16 colors or less are saved as 4 bit RLE4, those with up to
+		256 colors as 8 bit RLE8.  Images with more than 256 colors
+		can't be saved this way.
+
+		\return Non zero on success
+	*/
+	int ezd_save_rle( HEZDIMAGE x_hDib, const char *x_pFile );
+
+	/// Writes the DIB run length encoded through a user write function
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+
+		See ezd_save_rle().
+
+		\return The number of bytes written, or zero on failure
+	*/
+	int ezd_save_rle_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser );
+
+	/// Writes the image as a PNG file
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- New image filename
+
+		Images with 256 colors or less are written with a palette at
+		the smallest bit depth that holds it, others as 24 bit RGB with
+		a filter chosen for each row.  The deflate encoder is built in,
+		and large images are compressed in pieces on several threads
+		unless EZD_NO_THREADS is defined.
+
+		\return Non zero on success
+	*/
+	int ezd_save_png( HEZDIMAGE x_hDib, const char *x_pFile );
+
+	/// Writes the image as a PNG file through a user write function
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+
+		\return The number of bytes written, or zero on failure
+	*/
+	int ezd_save_png_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser );
+
+	/// Encodes the image as a PNG file in a memory buffer
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [out] x_pBuf		- Buffer that receives the file, may be NULL
+		\param [in] x_nBuf		- Size of the buffer in x_pBuf
+
+		If x_pBuf is NULL, the image is encoded only to find the size of
+		buffer required.
+
+		\return The size of the file in bytes, or zero on failure
+	*/
+	int ezd_save_png_mem( HEZDIMAGE x_hDib, void *x_pBuf, int x_nBuf );
+
+	/// Saves a 24 or 32 bit image as a QOI file
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- New filename
+
+		QOI is a simple lossless format that encodes in a single pass,
+		much faster than PNG and much smaller than a DIB for images with
+		large flat areas.  24 bit images are saved with three channels.
+		32 bit images are saved with four, the alpha being 255 minus the
+		high byte of each color, so colors without a high byte are opaque.
+
+		\return Non zero on success
+	*/
+	int ezd_save_qoi( HEZDIMAGE x_hDib, const char *x_pFile );
+
+	/// Writes the image as a QOI file through a user write function
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+
+		\return The number of bytes written, or zero on failure
+	*/
+	int ezd_save_qoi_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser );
+
+	/// Loads a QOI file
+	/**
+		\param [in] x_pFile		- QOI filename
+
+		Three channel files load as top-down 24 bit images, four channel
+		files as top-down 32 bit images.  See ezd_save_qoi() for how alpha
+		is stored.
+
+		\return Handle to the new image, or zero on failure
+	*/
+	HEZDIMAGE ezd_load_qoi( const char *x_pFile );
+
+	/// Loads a QOI file from memory
+	/**
+		\param [in] x_pBuf		- QOI file data
+		\param [in] x_nBuf		- Size of the data in x_pBuf
+
+		\return Handle to the new image, or zero on failure
+	*/
+	HEZDIMAGE ezd_load_qoi_mem( const void *x_pBuf, int x_nBuf );
+
+	/// GIF writer handle
+	typedef struct _HEZDGIF *HEZDGIF;
+
+	/// Opens a GIF file to be written one frame at a time
+	/**
+		\param [in] x_pFile		- GIF filename
+		\param [in] x_nLoops	- Number of times an animation repeats,
+								  zero to repeat forever, negative to play
+								  it once without a looping extension
+
+		Pass each frame to ezd_gif_frame().  The first frame sets the size
+		of the GIF and is stored whole, later frames store only the box
+		around the pixels that changed since the frame before, so the time
+		and space each one takes follows the amount of change.
+
+		\return GIF handle, or zero on failure
+	*/
+	HEZDGIF ezd_gif_open( const char *x_pFile, int x_nLoops );
+
+	/// Opens a GIF writer on a user write function
+	/**
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+		\param [in] x_nLoops	- Number of times an animation repeats,
+								  zero to repeat forever, negative to play
+								  it once without a looping extension
+
+		\return GIF handle, or zero on failure
+	*/
+	HEZDGIF ezd_gif_open_sink( t_ezd_write x_pf, void *x_pUser, int x_nLoops );
+
+	/// Adds a frame to a GIF
+	/**
+		\param [in] x_hGif		- GIF handle
+		\param [in] x_hDib		- Frame image, the same size as the first
+		\param [in] x_nDelay	- Time to show the frame, in hundredths
+								  of a second
+
+		The changed area gets its own palette.  If it has more than 256
+		colors, they are mapped to a fixed 6x7x6 color cube without
+		dithering.
+
+		\return Non zero on success
+	*/
+	int ezd_gif_frame( HEZDGIF x_hGif, HEZDIMAGE x_hDib, int x_nDelay );
+
+	/// Finishes a GIF and releases it
+	/**
+		\param [in] x_hGif		- GIF handle
+
+		\return The number of bytes written, or zero if no frames were
+				added or a write failed
+	*/
+	int ezd_gif_close( HEZDGIF x_hGif );
+
+	/// Saves the image as a single frame GIF file
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pFile		- New filename
+
+		\return Non zero on success
+	*/
+	int ezd_save_gif( HEZDIMAGE x_hDib, const char *x_pFile );
+
+	/// Writes the image as a single frame GIF through a user write function
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_pf		- Write function
+		\param [in] x_pUser		- Data passed to the write function
+
+		\return The number of bytes written, or zero on failure
+	*/
+	int ezd_save_gif_sink( HEZDIMAGE x_hDib, t_ezd_write x_pf, void *x_pUser );
+
 	/// Sets the threshold color for 1 bit images
 	/**
 		\param [in] x_hDib		- Handle to a dib
@@ -214,6 +685,63 @@ extern "C"
 	*/
 	int ezd_set_palette_color( HEZDIMAGE x_hDib, int x_idx, int x_col );
 
+	/// Sharp corners, beveled if the miter would be longer than twice the width
+#	define EZD_JOIN_MITER			0x0000
+
+	/// Rounded corners
+#	define EZD_JOIN_ROUND			0x0001
+
+	/// Corners cut off flat
+#	define EZD_JOIN_BEVEL			0x0002
+
+	/// Mask for the join style
+#	define EZD_JOIN_MASK			0x000f
+
+	/// Lines end flat at the end points
+#	define EZD_CAP_BUTT				0x0000
+
+	/// Rounded line ends
+#	define EZD_CAP_ROUND			0x0010
+
+	/// Line ends extended by half the width
+#	define EZD_CAP_SQUARE			0x0020
+
+	/// Mask for the cap style
+#	define EZD_CAP_MASK				0x00f0
+
+	/// Sets the pen used for lines, polylines, rectangles and arcs
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_nWidth	- Line width in pixels, zero or one for
+								  the default single pixel lines
+		\param [in] x_nStyle	- One EZD_JOIN_* and one EZD_CAP_* style
+
+		Lines wider than one pixel are built from convex pieces that
+		are merged on each row, so every pixel is written once.  Wide
+		lines need memory allocation.
+
+		\return Non zero on success
+	*/
+	int ezd_set_pen( HEZDIMAGE x_hDib, int x_nWidth, int x_nStyle );
+
+	/// Sets the dash pattern for lines, polylines, rectangles, curves and arcs
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x_uPattern	- One bit per pixel, bit zero first,
+								  set bits are drawn
+		\param [in] x_nLen		- Number of bits in the pattern, up to 32,
+								  zero for solid lines
+		\param [in] x_nPhase	- Pattern bit to start each line with
+
+		The pattern starts over with each call and continues around the
+		corners of polylines and rectangles.  Horizontal and vertical
+		dashes are written as spans.  Arcs step the pattern once per
+		point plotted, and wide lines and ellipses are always solid.
+
+		\return Non zero on success
+	*/
+	int ezd_set_dash( HEZDIMAGE x_hDib, unsigned int x_uPattern, int x_nLen, int x_nPhase );
+
 	/// Returns the specified color in the color palette
 	/**
 		\param [in] x_hDib		- Handle to a dib
@@ -278,6 +806,61 @@ extern "C"
 	*/
 	int ezd_get_pixel( HEZDIMAGE x_hDib, int x, int y );
 
+	/// Sets a list of pixels
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] pX			- X coords
+		\param [in] pY			- Y coords
+		\param [in] pCol		- Color of each pixel, or zero to use x_col
+		\param [in] x_col		- Color used if pCol is zero
+		\param [in] n			- Number of pixels
+
+		The image is validated once for the whole list, pixels outside
+		the image are skipped.  Monochrome images use the color threshold.
+
+		\return Non zero on success
+	*/
+	int ezd_set_pixels( HEZDIMAGE x_hDib, const int *pX, const int *pY, const int *pCol, int x_col, int n );
+
+	/// Reads a list of pixels
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] pX			- X coords
+		\param [in] pY			- Y coords
+		\param [out] pCol		- Receives the color of each pixel,
+								  zero for pixels outside the image
+		\param [in] n			- Number of pixels
+
+		\return Non zero on success
+	*/
+	int ezd_get_pixels( HEZDIMAGE x_hDib, const int *pX, const int *pY, int *pCol, int n );
+
+	/// Reads part of a row as packed 32 bit colors
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x			- X coord of the first pixel
+		\param [in] y			- Y coord of the row
+		\param [in] n			- Number of pixels, x + n must not
+								  be past the end of the row
+		\param [out] pCol		- Receives n colors
+
+		\return Non zero on success
+	*/
+	int ezd_get_row( HEZDIMAGE x_hDib, int x, int y, int n, int *pCol );
+
+	/// Writes part of a row from packed 32 bit colors
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x			- X coord of the first pixel
+		\param [in] y			- Y coord of the row
+		\param [in] n			- Number of pixels, x + n must not
+								  be past the end of the row
+		\param [in] pCol		- n colors
+
+		\return Non zero on success
+	*/
+	int ezd_put_row( HEZDIMAGE x_hDib, int x, int y, int n, const int *pCol );
+
 
 	/// Draws a line between the specified points
 	/**
@@ -292,6 +875,87 @@ extern "C"
 	*/
 	int ezd_line( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_col );
 
+	/// Draws lines connecting a list of points
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] pX			- X coords
+		\param [in] pY			- Y coords
+		\param [in] n			- Number of points
+		\param [in] x_col		- Line color
+
+		The image is validated once, each joint and repeated point is
+		drawn only once, and horizontal or vertical segments are drawn
+		as spans.
+
+		\return Non zero on success
+	*/
+	int ezd_polyline( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col );
+
+	/// Draws the outline of a polygon
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] pX			- X coords
+		\param [in] pY			- Y coords
+		\param [in] n			- Number of points
+		\param [in] x_col		- Line color
+
+		Same as ezd_polyline() with the last point connected to the first.
+
+		\return Non zero on success
+	*/
+	int ezd_polygon( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col );
+
+	/// Draws a quadratic Bezier curve
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x1			- Start X coord
+		\param [in] y1			- Start Y coord
+		\param [in] cx			- Control point X coord
+		\param [in] cy			- Control point Y coord
+		\param [in] x2			- End X coord
+		\param [in] y2			- End Y coord
+		\param [in] x_col		- Line color
+
+		Curves are split in half until each piece is within half a
+		pixel of a straight line, using fixed point math, and the
+		pieces are drawn as with ezd_polyline().
+
+		\return Non zero on success
+	*/
+	int ezd_quad_bezier( HEZDIMAGE x_hDib, int x1, int y1, int cx, int cy, int x2, int y2, int x_col );
+
+	/// Draws a cubic Bezier curve
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x1			- Start X coord
+		\param [in] y1			- Start Y coord
+		\param [in] cx1		- First control point X coord
+		\param [in] cy1		- First control point Y coord
+		\param [in] cx2		- Second control point X coord
+		\param [in] cy2		- Second control point Y coord
+		\param [in] x2			- End X coord
+		\param [in] y2			- End Y coord
+		\param [in] x_col		- Line color
+
+		\return Non zero on success
+	*/
+	int ezd_cubic_bezier( HEZDIMAGE x_hDib, int x1, int y1, int cx1, int cy1,
+						  int cx2, int cy2, int x2, int y2, int x_col );
+
+	/// Draws a smooth curve through a list of points
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] pX			- X coords
+		\param [in] pY			- Y coords
+		\param [in] n			- Number of points
+		\param [in] x_col		- Line color
+
+		Draws a Catmull-Rom spline, which passes through every point.
+
+		\return Non zero on success
+	*/
+	int ezd_spline( HEZDIMAGE x_hDib, const int *pX, const int *pY, int n, int x_col );
+
 	/// Fills the specified rectangle
 	/**
 		\param [in] x_hDib		- Handle to a dib
@@ -344,6 +1008,61 @@ extern "C"
 	*/
 	int ezd_circle( HEZDIMAGE x_hDib, int x, int y, int x_rad, int x_col );
 
+	/// Draw ellipse outline
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x			- Center X coord
+		\param [in] y			- Center Y coord
+		\param [in] rx			- Horizontal radius
+		\param [in] ry			- Vertical radius
+		\param [in] x_col		- Line color
+
+		The edge is found with integer math and drawn as row spans.
+		A wide pen draws the ring between two ellipses.
+
+		\return Non zero on success
+	*/
+	int ezd_ellipse( HEZDIMAGE x_hDib, int x, int y, int rx, int ry, int x_col );
+
+	/// Fills an ellipse
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x			- Center X coord
+		\param [in] y			- Center Y coord
+		\param [in] rx			- Horizontal radius
+		\param [in] ry			- Vertical radius
+		\param [in] x_col		- Fill color
+
+		\return Non zero on success
+	*/
+	int ezd_fill_ellipse( HEZDIMAGE x_hDib, int x, int y, int rx, int ry, int x_col );
+
+	/// Fills a circle
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x			- Center X coord
+		\param [in] y			- Center Y coord
+		\param [in] x_rad		- Radius
+		\param [in] x_col		- Fill color
+
+		\return Non zero on success
+	*/
+	int ezd_fill_circle( HEZDIMAGE x_hDib, int x, int y, int x_rad, int x_col );
+
+	/// Fills a rectangle with rounded corners
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] x1			- Top Left X coord
+		\param [in] y1			- Top Left Y coord
+		\param [in] x2			- Bottom Right X coord, exclusive
+		\param [in] y2			- Bottom Right Y coord, exclusive
+		\param [in] x_rad		- Corner radius
+		\param [in] x_col		- Fill color
+
+		\return Non zero on success
+	*/
+	int ezd_fill_round_rect( HEZDIMAGE x_hDib, int x1, int y1, int x2, int y2, int x_rad, int x_col );
+
 	/// Flood fill starting at the specified point
 	/**
 		\param [in] x_hDib		- Handle to a dib
@@ -419,6 +1138,72 @@ extern "C"
 	*/
 	int ezd_text( HEZDIMAGE x_hDib, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen, int x, int y, int x_col );
 
+	/// Draws the specified text string with an opaque background
+	/**
+		\param [in] x_hDib		- Image in which to draw the text
+		\param [in] x_hFont		- Font handle returned by ezd_load_font()
+		\param [in] x_pText		- Text string to draw
+		\param [in] x_nTextLen	- Length of the string in x_pText or -1
+								  for null terminated string.
+		\param [in] x			- The x coord to draw the text
+		\param [in] y			- The y coord to draw the text
+		\param [in] x_col		- Text color
+		\param [in] x_bgcol		- Background color
+		\param [out] x_pRect	- Optional, receives the bounding box of the
+								  pixels that were written
+
+		Each character cell, including the spacing between characters
+		and lines, is written in a single pass with either the text or
+		the background color.  Use this to update a changing label
+		without having to call ezd_fill_rect() first.
+
+		\return Returns non-zero on success
+	*/
+	int ezd_text_opaque( HEZDIMAGE x_hDib, HEZDFONT x_hFont, const char *x_pText, int x_nTextLen,
+						 int x, int y, int x_col, int x_bgcol, SEZDRect *x_pRect );
+
+	/// Describes one label for ezd_text_batch()
+	typedef struct _SEZDTextItem
+	{
+		/// Font handle returned by ezd_load_font()
+		HEZDFONT		hFont;
+
+		/// Text string to draw
+		const char		*pText;
+
+		/// Length of the string in pText, or -1 for null terminated
+		int				nTextLen;
+
+		/// The x coord to draw the text
+		int				x;
+
+		/// The y coord to draw the text
+		int				y;
+
+		/// Text color
+		int				col;
+
+	} SEZDTextItem;
+
+	/// Draws an array of text strings into the image
+	/**
+		\param [in] x_hDib		- Image in which to draw the text
+		\param [in] x_pItems	- Array of labels to draw
+		\param [in] x_nItems	- Number of labels in x_pItems
+
+		Produces the same output as calling ezd_text() for each label,
+		but the image is validated once, labels that fall completely
+		outside the image are skipped, and the remaining labels are
+		drawn in scanline order.  Glyphs are decoded once per font and
+		shared by all labels using that font.
+
+		Where labels overlap, the drawing order may differ from the
+		order of x_pItems.
+
+		\return Returns non-zero on success
+	*/
+	int ezd_text_batch( HEZDIMAGE x_hDib, const SEZDTextItem *x_pItems, int x_nItems );
+
 	/// Calculates the size of the specified text
 	/**
 		\param [in] x_hFont		- Font handle returned by ezd_load_font()
@@ -505,6 +1290,25 @@ extern "C"
 	*/
 	double ezd_scale_value( int i, int t, void *pData, double oSrc, double rSrc, double oDst, double rDst );
 
+	/// Scales an array of values
+	/**
+		\param [in] t		- Element type
+		\param [in]	pData	- Pointer to an array of type t
+		\param [in] nData	- Number of elements in pData
+		\param [in] oSrc	- Source scale offset
+		\param [in] rSrc	- Source scale range
+		\param [in] oDst	- Destination scale offset
+		\param [in] rDst	- Destination scale range
+		\param [out] pOut	- Receives nData scaled values
+
+		Each value in pOut is the same as ezd_scale_value() would
+		return for that element, but the array is converted with a
+		single loop for each element type.
+
+		\return Non zero on success
+	*/
+	int ezd_scale_array( int t, const void *pData, int nData, double oSrc, double rSrc, double oDst, double rDst, double *pOut );
+
 	/// Calculates the range of the specified values
 	/**
 		\param [in] t		- Element type
@@ -512,9 +1316,262 @@ extern "C"
 		\param [in] nData	- Number of elements in pData
 		\param [in] pMin	- Pointer to a variable that receives the minimum
 		\param [in] pMax	- Pointer to a variable that receives the maximum
+		\param [in] pTotal	- Pointer to a variable that receives the sum of all elements
+
+		Large arrays are split across threads unless EZD_NO_THREADS
+		is defined.
 	*/
 	double ezd_calc_range( int t, void *pData, int nData, double *pMin, double *pMax, double *pTotal );
 
+	/// Running range of a series of values
+	typedef struct _SEZDRange
+	{
+		/// Smallest value
+		double			dMin;
+
+		/// Largest value
+		double			dMax;
+
+		/// Sum of all values
+		double			dTotal;
+
+		/// Number of values seen
+		long long		nCount;
+
+	} SEZDRange;
+
+	/// Resets a running range
+	void ezd_range_init( SEZDRange *x_pRange );
+
+	/// Adds values to a running range
+	/**
+		\param [in] x_pRange	- Range to update
+		\param [in] t			- Element type
+		\param [in] pData		- Pointer to an array of type t
+		\param [in] nData		- Number of elements in pData
+
+		Use this to maintain the range of a series as samples arrive,
+		the result is the same as calling ezd_calc_range() on all the
+		samples at once.
+
+		\return Non zero on success
+	*/
+	int ezd_range_update( SEZDRange *x_pRange, int t, const void *pData, int nData );
+
+	/// Plots an array of values as a line graph
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] t			- Element type
+		\param [in] pData		- Pointer to an array of type t
+		\param [in] nData		- Number of elements in pData
+		\param [in] x1			- Top Left X coord of the plot area
+		\param [in] y1			- Top Left Y coord of the plot area
+		\param [in] x2			- Bottom Right X coord of the plot area
+		\param [in] y2			- Bottom Right Y coord of the plot area
+		\param [in] x_col		- Line color
+
+		The values are scaled to fill the plot area.  The result is the
+		same as mapping element i to x1 + i * ( x2 - x1 ) / ( nData - 1 ),
+		y2 - (int)ezd_scale_value( i, t, pData, min, max - min, 0, y2 - y1 )
+		and calling ezd_line() between each pair of neighbouring points.
+
+		Instead, the samples falling on each pixel column are reduced to
+		their first, last, minimum and maximum values in a single pass, so
+		the number of lines drawn depends on the plot width rather than
+		on nData.
+
+		\return Non zero on success
+	*/
+	int ezd_line_series( HEZDIMAGE x_hDib, int t, const void *pData, int nData,
+						 int x1, int y1, int x2, int y2, int x_col );
+
+	// Declare bar graph handle
+	struct _HEZDBARGRAPH;
+	typedef struct _HEZDBARGRAPH *HEZDBARGRAPH;
+
+	/// Creates a bar graph
+	/**
+		\param [in] x1			- Top Left X coord of the graph
+		\param [in] y1			- Top Left Y coord of the graph
+		\param [in] x2			- Bottom Right X coord of the graph
+		\param [in] y2			- Bottom Right Y coord of the graph
+		\param [in] x_hFont		- Optional font for the axis labels
+		\param [in] pCols		- Graph colors, the first is used for the
+								  axis, labels, and bar outlines, the rest
+								  are used in turn to fill the bars
+		\param [in] nCols		- Number of colors in pCols
+		\param [in] x_bgcol		- Background color
+
+		The graph remembers the geometry of each bar, so that
+		ezd_bar_graph_update() only has to redraw the bars that changed.
+
+		\return Bar graph handle or NULL if failure
+	*/
+	HEZDBARGRAPH ezd_bar_graph_create( int x1, int y1, int x2, int y2, HEZDFONT x_hFont,
+									   const int *pCols, int nCols, int x_bgcol );
+
+	/// Releases the bar graph handle
+	void ezd_bar_graph_destroy( HEZDBARGRAPH x_hGraph );
+
+	/// Draws the bar graph
+	/**
+		\param [in] x_hGraph	- Handle returned by ezd_bar_graph_create()
+		\param [in] x_hDib		- Image in which to draw the graph
+		\param [in] t			- Element type
+		\param [in] pData		- Pointer to an array of type t
+		\param [in] nData		- Number of elements in pData, one per bar
+
+		The first call draws the whole graph.  After that, the whole
+		graph is only redrawn if the range of the data, the number of
+		bars, or the image changes.  Otherwise only the bars whose
+		height changed are redrawn.
+
+		\return Non zero on success
+	*/
+	int ezd_bar_graph_update( HEZDBARGRAPH x_hGraph, HEZDIMAGE x_hDib, int t, void *pData, int nData );
+
+	/// Forces the next ezd_bar_graph_update() to redraw the whole graph
+	/**
+		Call this if something else has drawn over the graph area.
+	*/
+	void ezd_bar_graph_invalidate( HEZDBARGRAPH x_hGraph );
+
+	// Declare strip chart handle
+	struct _HEZDSTRIPCHART;
+	typedef struct _HEZDSTRIPCHART *HEZDSTRIPCHART;
+
+	/// Creates a scrolling strip chart
+	/**
+		\param [in] x1			- Top Left X coord of the chart
+		\param [in] y1			- Top Left Y coord of the chart
+		\param [in] x2			- Bottom Right X coord of the chart, exclusive
+		\param [in] y2			- Bottom Right Y coord of the chart, exclusive
+		\param [in] dMin		- Value shown at the bottom of the chart
+		\param [in] dMax		- Value shown at the top of the chart
+		\param [in] x_col		- Line color
+		\param [in] x_bgcol		- Background color
+
+		Each sample takes up one column, new samples appear on the right.
+
+		\return Strip chart handle or NULL if failure
+	*/
+	HEZDSTRIPCHART ezd_strip_chart_create( int x1, int y1, int x2, int y2, double dMin, double dMax,
+										   int x_col, int x_bgcol );
+
+	/// Releases the strip chart handle
+	void ezd_strip_chart_destroy( HEZDSTRIPCHART x_hChart );
+
+	/// Adds samples to the strip chart
+	/**
+		\param [in] x_hChart	- Handle returned by ezd_strip_chart_create()
+		\param [in] x_hDib		- Image in which to draw the chart
+		\param [in] t			- Element type
+		\param [in] pData		- Pointer to an array of type t
+		\param [in] nData		- Number of new samples in pData
+
+		The chart is scrolled left by nData columns in place, then only
+		the new columns are drawn.  The first call, or a call with a
+		different image, clears the chart area first.
+
+		The chart area must lie within the image, and the image must
+		have a buffer, user set pixel callbacks can not be scrolled.
+
+		\return Non zero on success
+	*/
+	int ezd_strip_chart_add( HEZDSTRIPCHART x_hChart, HEZDIMAGE x_hDib, int t, const void *pData, int nData );
+
+	/// Draws a two dimensional array as a heat map
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] t			- Element type
+		\param [in] pData		- Pointer to an array of type t, nRows rows
+								  of nCols elements each
+		\param [in] nCols		- Number of columns in pData
+		\param [in] nRows		- Number of rows in pData
+		\param [in] x1			- Top Left X coord of the map
+		\param [in] y1			- Top Left Y coord of the map
+		\param [in] x2			- Bottom Right X coord of the map, exclusive
+		\param [in] y2			- Bottom Right Y coord of the map, exclusive
+		\param [in] dMin		- Value mapped to the first color in pLut
+		\param [in] dMax		- Value mapped to the last color in pLut,
+								  if dMin and dMax are equal, the range
+								  is calculated from the data
+		\param [in] pLut		- Color lookup table, for example 256 or
+								  4096 entries
+		\param [in] nLut		- Number of colors in pLut
+
+		Each element is scaled as with ezd_scale_value() to an index in
+		pLut, values outside the range use the first or last color.
+		Cells are stretched to fill the map using the nearest element.
+		Each row of elements is converted once, and repeated image rows
+		are copied.  Large maps are split across threads by rows.
+
+		\return Non zero on success
+	*/
+	int ezd_heatmap( HEZDIMAGE x_hDib, int t, const void *pData, int nCols, int nRows,
+					 int x1, int y1, int x2, int y2, double dMin, double dMax,
+					 const int *pLut, int nLut );
+
+	/// Single pixel marker
+#	define EZD_MARKER_POINT			0
+
+	/// Filled square marker
+#	define EZD_MARKER_SQUARE		1
+
+	/// Filled circle marker
+#	define EZD_MARKER_CIRCLE		2
+
+	/// Plus shaped marker
+#	define EZD_MARKER_PLUS			3
+
+	/// X shaped marker
+#	define EZD_MARKER_CROSS			4
+
+	/// Mask for the marker shape
+#	define EZD_MARKER_MASK_SHAPE	0x00ff
+
+	/// Shade pixels by the number of markers covering them
+#	define EZD_MARKER_DENSITY		0x0100
+
+	/// Largest marker size supported by ezd_scatter()
+#	define EZD_MAX_MARKER_SIZE		32
+
+	/// Draws a scatter plot
+	/**
+		\param [in] x_hDib		- Handle to a dib
+		\param [in] t			- Element type of pX and pY
+		\param [in] pX			- Pointer to the X values
+		\param [in] pY			- Pointer to the Y values
+		\param [in] nData		- Number of points
+		\param [in] x1			- Top Left X coord of the plot
+		\param [in] y1			- Top Left Y coord of the plot
+		\param [in] x2			- Bottom Right X coord of the plot, exclusive
+		\param [in] y2			- Bottom Right Y coord of the plot, exclusive
+		\param [in] dXMin		- X value at the left edge
+		\param [in] dXMax		- X value at the right edge
+		\param [in] dYMin		- Y value at the bottom edge
+		\param [in] dYMax		- Y value at the top edge
+		\param [in] nMarker	- One of the EZD_MARKER_* shapes, optionally
+								  combined with EZD_MARKER_DENSITY
+		\param [in] nSize		- Marker radius in pixels, up to
+								  EZD_MAX_MARKER_SIZE
+		\param [in] x_col		- Marker color
+
+		If a min and max pair are equal, that range is calculated
+		from the data.  Points outside the range are skipped and
+		markers are clipped to the plot.
+
+		The marker is rasterized once into spans that are stamped at
+		each point.  With EZD_MARKER_DENSITY, the markers are counted
+		per pixel first and pixels covered less often are drawn darker,
+		down to a quarter of x_col.
+
+		\return Non zero on success
+	*/
+	int ezd_scatter( HEZDIMAGE x_hDib, int t, const void *pX, const void *pY, int nData,
+					 int x1, int y1, int x2, int y2, double dXMin, double dXMax,
+					 double dYMin, double dYMax, int nMarker, int nSize, int x_col );
+
 #if defined( __cplusplus )
 };
 #endif
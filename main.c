@@ -6,74 +6,6 @@
 
 #include "ezdib.h"
 
-int bar_graph( HEZDIMAGE x_hDib, HEZDFONT x_hFont, int x1, int y1, int x2, int y2,
-			   int nDataType, void *pData, int nDataSize, int *pCols, int nCols )
-{
-	int i, c, w, h;
-	int tyw = 0, bw = 0;
-	double v, dMin, dMax, dRMin, dRMax;
-
-	// Sanity checks
-	if ( !pData || 0 >= nDataSize || !pCols || !nCols )
-		return 0;
-
-	// Get the range of the data set
-	ezd_calc_range( nDataType, pData, nDataSize, &dMin, &dMax, 0 );
-
-	// Add margin to range
-	dRMin = dMin - ( dMax - dMin ) / 10;
-	dRMax = dMax + ( dMax - dMin ) / 10;
-
-	if ( x_hFont )
-	{	
-		char num[ 256 ] = { 0 };
-		
-		// Calculate text width of smallest value
-		sprintf( num, "%.2f", dMin );
-		ezd_text_size( x_hFont, num, -1, &tyw, &h );
-		ezd_text( x_hDib, x_hFont, num, -1, x1, y2 - ( h * 2 ), *pCols );
-
-		// Calculate text width of largest value
-		sprintf( num, "%.2f", dMax );
-		ezd_text_size( x_hFont, num, -1, &w, &h );
-		ezd_text( x_hDib, x_hFont, num, -1, x1, y1 + h, *pCols );
-		if ( w > tyw )
-			tyw	= w;
-			
-		// Text width margin
-		tyw += 10;
-	
-	} // end if
-
-	// Draw margins
-	ezd_line( x_hDib, x1 + tyw - 2, y1, x1 + tyw - 2, y2, *pCols );
-	ezd_line( x_hDib, x1 + tyw - 2, y2, x2, y2, *pCols );
-
-	// Calculate bar width
-	bw = ( x2 - x1 - tyw - nDataSize * 2 ) / nDataSize;
-
-	// Draw the bars
-	c = 0;
-	for ( i = 0; i < nDataSize; i++ )
-	{
-		if ( ++c >= nCols )
-			c = 1;
-
-		// Get the value for this element
-		v = ezd_scale_value( i, nDataType, pData, dRMin, dRMax - dRMin, 0, y2 - y1 - 2 );
-
-		// Fill in the bar
-		ezd_fill_rect( x_hDib, x1 + tyw + i + ( ( bw + 1 ) * i ), y2 - (int)v - 2,
-							   x1 + tyw + i + ( ( bw + 1 ) * i ) + bw, y2 - 2, pCols[ c ] );
-
-		// Outline the bar
-		ezd_rect( x_hDib, x1 + tyw + i + ( ( bw + 1 ) * i ), y2 - (int)v - 2,
-						  x1 + tyw + i + ( ( bw + 1 ) * i ) + bw, y2 - 2, *pCols );
-	} // end for
-
-	return 1;
-}
-
 #define PI		( (double)3.141592654 )
 #define PI2		( (double)2 * PI )
 
@@ -230,24 +162,53 @@ int main( int argc, char* argv[] )
 		if ( hFont )
 			ezd_text( hDib, hFont, "--- EZDIB Test ---", -1, 10, 10, 0xffffff );
 
+		// Opaque label, the background is drawn in the same pass
+		if ( hFont )
+			ezd_text_opaque( hDib, hFont, "Opaque label", -1, 10, 24, 0x000000, 0xc0c0c0, 0 );
+
 		// Draw random lines
 		for ( x = 20; x < 300; x += 10 )
 			ezd_line( hDib, x, ( x & 1 ) ? 50 : 100, x + 10, !( x & 1 ) ? 50 : 100, 0x00ff00 ),
 			ezd_line( hDib, x + 10, ( x & 1 ) ? 50 : 100, x, !( x & 1 ) ? 50 : 100, 0x0000ff );
 
+		// Wide zig zag with rounded corners
+		{
+			int zx[] = { 170, 200, 230, 260, 290 }, zy[] = { 140, 112, 140, 112, 140 };
+			ezd_set_pen( hDib, 5, EZD_JOIN_ROUND | EZD_CAP_ROUND );
+			ezd_polyline( hDib, zx, zy, 5, 0xff8000 );
+			ezd_set_pen( hDib, 1, 0 );
+		}
+
 		// Random red box
 		ezd_fill_rect( hDib, 200, 150, 400, 250, 0x900000 );
 
+		// Dashed outline for the red box
+		ezd_set_dash( hDib, 0x0f, 8, 0 );
+		ezd_rect( hDib, 196, 146, 404, 254, 0xffffff );
+		ezd_set_dash( hDib, 0, 0, 0 );
+
 		// Random yellow box
 		ezd_fill_rect( hDib, 300, 200, 350, 280, 0xffff00 );
 
 		// Dark outline for yellow box
 		ezd_rect( hDib, 300, 200, 350, 280, 0x000000 );
 
+		// Curve across the boxes
+		ezd_cubic_bezier( hDib, 210, 240, 260, 140, 340, 270, 390, 160, 0xffffff );
+
 		// Draw random dots
-		for ( y = 150; y < 250; y += 4 )
-			for ( x = 50; x < 150; x += 4 )
-				ezd_set_pixel( hDib, x, y, 0xffffff );
+		{
+			int n = 0, dx[ 625 ], dy[ 625 ];
+			for ( y = 150; y < 250; y += 4 )
+				for ( x = 50; x < 150; x += 4 )
+					dx[ n ] = x, dy[ n++ ] = y;
+			ezd_set_pixels( hDib, dx, dy, 0, 0xffffff, n );
+		}
+
+		// Rounded button with a status dot
+		ezd_fill_round_rect( hDib, 470, 8, 630, 40, 8, 0x2060a0 );
+		ezd_fill_circle( hDib, 490, 24, 6, 0x00ff00 );
+		ezd_ellipse( hDib, 560, 24, 50, 10, 0xffffff );
 
 		// Circles
 		for ( x = 0; x < 40; x++ )
@@ -261,11 +222,24 @@ int main( int argc, char* argv[] )
 			// Graph colors
 			int cols[] = { 0xffffff, 0x400000, 0x006000, 0x000080 };
 
+			// Bar graph handle
+			HEZDBARGRAPH hGraph;
+
 			// Draw bar graph
 			ezd_rect( hDib, 35, 295, 605, 445, cols[ 0 ] );
-			bar_graph( hDib, hFont, 40, 300, 600, 440, EZD_TYPE_INT,
-					   data, sizeof( data ) / sizeof( data[ 0 ] ),
-					   cols, sizeof( cols ) / sizeof( cols[ 0 ] ) );
+			hGraph = ezd_bar_graph_create( 40, 300, 600, 440, hFont, cols,
+										   sizeof( cols ) / sizeof( cols[ 0 ] ), 0x404040 );
+			if ( hGraph )
+			{
+				ezd_bar_graph_update( hGraph, hDib, EZD_TYPE_INT, data, sizeof( data ) / sizeof( data[ 0 ] ) );
+
+				// Only the changed bar is redrawn
+				data[ 2 ] = 45;
+				ezd_bar_graph_update( hGraph, hDib, EZD_TYPE_INT, data, sizeof( data ) / sizeof( data[ 0 ] ) );
+
+				ezd_bar_graph_destroy( hGraph );
+
+			} // end if
 
 			// Draw pie graph
 			ezd_circle( hDib, 525, 150, 84, cols[ 0 ] );
@@ -273,11 +247,44 @@ int main( int argc, char* argv[] )
 					   data, sizeof( data ) / sizeof( data[ 0 ] ),
 					   cols, sizeof( cols ) / sizeof( cols[ 0 ] ) );
 
+			// Draw line graph
+			{
+				double wave[ 4096 ];
+				for ( x = 0; x < 4096; x++ )
+					wave[ x ] = sin( (double)x / 64 ) + sin( (double)x / 7 ) / 4;
+				ezd_line_series( hDib, EZD_TYPE_DOUBLE, wave, 4096, 40, 450, 600, 475, cols[ 0 ] );
+			}
+
+			// Draw heat map
+			{
+				int lut[ 256 ];
+				float grid[ 8 ][ 24 ];
+				for ( x = 0; x < 256; x++ )
+					lut[ x ] = ( x << 16 ) | ( ( 255 - x ) );
+				for ( y = 0; y < 8; y++ )
+					for ( x = 0; x < 24; x++ )
+						grid[ y ][ x ] = (float)( sin( (double)x / 4 ) * cos( (double)y / 3 ) );
+				ezd_heatmap( hDib, EZD_TYPE_FLOAT, grid, 24, 8, 450, 245, 630, 290, 0, 0, lut, 256 );
+			}
+
+			// Draw scatter plot
+			{
+				float px[ 200 ], py[ 200 ];
+				for ( x = 0; x < 200; x++ )
+					px[ x ] = (float)x, py[ x ] = (float)( x % 37 ) * (float)( x % 11 );
+				ezd_scatter( hDib, EZD_TYPE_FLOAT, px, py, 200, 20, 255, 190, 290,
+							 0, 0, 0, 0, EZD_MARKER_CIRCLE | EZD_MARKER_DENSITY, 2, 0xffff00 );
+			}
+
 		}
 
 		// Save the test image
 		ezd_save( hDib, fname );
 
+		// And as a PNG
+		sprintf( fname, "test-%d.png", bpp[ b ] );
+		ezd_save_png( hDib, fname );
+
 		/// Releases the specified font
 		if ( hFont )
 			ezd_destroy_font( hFont );
@@ -373,9 +380,12 @@ int main( int argc, char* argv[] )
 			int cols[] = { 0xffffff, 0x400000, 0x006000, 0x000080 };
 
 			// Draw bar graph
-			bar_graph( hDib, 0, 2, 16, 100, 70, EZD_TYPE_INT,
-					   data, sizeof( data ) / sizeof( data[ 0 ] ),
-					   cols, sizeof( cols ) / sizeof( cols[ 0 ] ) );
+			HEZDBARGRAPH hGraph = ezd_bar_graph_create( 2, 16, 100, 70, 0, cols,
+														sizeof( cols ) / sizeof( cols[ 0 ] ), 0 );
+			if ( hGraph )
+			{	ezd_bar_graph_update( hGraph, hDib, EZD_TYPE_INT, data, sizeof( data ) / sizeof( data[ 0 ] ) );
+				ezd_bar_graph_destroy( hGraph );
+			} // end if
 
 		}
 